@@ -20,8 +20,8 @@
 //
 
 #include "basicmath.h"
+#include "randomgen.h"
 #include <algorithm>
-#include <random>
 #include <limits>
 #include <stdexcept>
 
@@ -169,21 +169,33 @@ std::vector<eis::DataPoint> eis::rescale(const std::vector<eis::DataPoint>& data
 	return output;
 }
 
-void eis::noise(std::vector<eis::DataPoint>& data, double amplitude, bool relative)
+static void applyNoise(std::vector<eis::DataPoint>& data, double amplitude, bool relative, rd::Stream& stream)
 {
-	std::random_device rd;
-	std::default_random_engine rande(rd());
+	std::vector<float> noise(data.size()*2);
+	stream.uniform(noise.data(), noise.size(), 0, amplitude);
 
-	for(eis::DataPoint& point : data)
+	for(size_t i = 0; i < data.size(); ++i)
 	{
-		double realNoise = (static_cast<double>(rande() >> 1) / (rande.max() >> 1))*amplitude;
+		eis::DataPoint& point = data[i];
+		double realNoise = noise[i*2];
 		point.im.real(relative ? point.im.real()+realNoise/point.im.real() : point.im.real()+realNoise);
 
-		double imgNoise = (static_cast<double>(rande() >> 1) / (rande.max() >> 1))*amplitude;
+		double imgNoise = noise[i*2+1];
 		point.im.imag(relative ? point.im.imag()+imgNoise/point.im.imag() : point.im.imag()+imgNoise);
 	}
 }
 
+void eis::noise(std::vector<eis::DataPoint>& data, double amplitude, bool relative)
+{
+	applyNoise(data, amplitude, relative, rd::threadStream());
+}
+
+void eis::noise(std::vector<eis::DataPoint>& data, double amplitude, bool relative, uint64_t seed, uint64_t stream)
+{
+	rd::Stream noiseStream(seed, stream);
+	applyNoise(data, amplitude, relative, noiseStream);
+}
+
 fvalue eis::pearsonCorrelation(const std::vector<eis::DataPoint>& data)
 {
 	std::complex<fvalue> meanValue = mean(data);
@@ -0,0 +1,188 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "canonical.h"
+
+#include <algorithm>
+
+#include "componant/paralellseriel.h"
+#include "componant/network.h"
+#include "componant/resistor.h"
+
+using namespace eis;
+
+static void setCanonicalStr(CanonicalNode& node)
+{
+	node.str.clear();
+	if(node.type == Parallel::staticGetComponantChar())
+	{
+		for(const CanonicalNode& child : node.children)
+		{
+			if(child.type == Serial::staticGetComponantChar())
+				node.str.append("(" + child.str + ")");
+			else
+				node.str.append(child.str);
+		}
+	}
+	else if(node.type == Serial::staticGetComponantChar())
+	{
+		for(const CanonicalNode& child : node.children)
+			node.str.append(child.str + "-");
+		node.str.pop_back();
+	}
+	else if(node.type == Network::staticGetComponantChar())
+	{
+		node.str.push_back(node.type);
+		node.str.push_back('[');
+		for(size_t i = 0; i < node.children.size(); ++i)
+		{
+			node.str.append(std::to_string(node.terminals[i].first) + "," + std::to_string(node.terminals[i].second) + ":");
+			node.str.append("(" + node.children[i].str + ");");
+		}
+		node.str.back() = ']';
+	}
+	else
+	{
+		node.str.push_back(node.type);
+	}
+}
+
+static CanonicalNode buildNode(Componant* componant, size_t& offset)
+{
+	CanonicalNode node;
+	node.type = componant->getComponantChar();
+
+	// the elements of a network are tied to their nodes, thus they are neither merged nor reordered
+	if(Network* network = dynamic_cast<Network*>(componant))
+	{
+		for(Componant* child : network->componants)
+			node.children.push_back(buildNode(child, offset));
+		node.terminals = network->terminals;
+		setCanonicalStr(node);
+		return node;
+	}
+
+	const std::vector<Componant*>* children = nullptr;
+	if(Parallel* parallel = dynamic_cast<Parallel*>(componant))
+		children = &parallel->componants;
+	else if(Serial* serial = dynamic_cast<Serial*>(componant))
+		children = &serial->componants;
+
+	if(!children)
+	{
+		node.componant = componant;
+		node.offsets.push_back(offset);
+		offset += componant->paramCount();
+		setCanonicalStr(node);
+		return node;
+	}
+
+	for(Componant* child : *children)
+	{
+		CanonicalNode childNode = buildNode(child, offset);
+		if(childNode.type == node.type)
+		{
+			for(CanonicalNode& grandChild : childNode.children)
+				node.children.push_back(std::move(grandChild));
+		}
+		else
+		{
+			node.children.push_back(std::move(childNode));
+		}
+	}
+
+	// resistors in series are equivalent to a single resistor of the sum of their resistances
+	if(node.type == Serial::staticGetComponantChar())
+	{
+		CanonicalNode* resistor = nullptr;
+		for(auto iter = node.children.begin(); iter != node.children.end();)
+		{
+			if(iter->type != Resistor::staticGetComponantChar())
+			{
+				++iter;
+			}
+			else if(!resistor)
+			{
+				resistor = &(*iter);
+				++iter;
+			}
+			else
+			{
+				// erasing only moves elements after the first resistor, thus resistor stays valid
+				resistor->offsets.insert(resistor->offsets.end(), iter->offsets.begin(), iter->offsets.end());
+				iter = node.children.erase(iter);
+			}
+		}
+	}
+
+	if(node.children.size() == 1)
+		return std::move(node.children[0]);
+
+	std::stable_sort(node.children.begin(), node.children.end(),
+		[](const CanonicalNode& a, const CanonicalNode& b){return a.str < b.str;});
+	setCanonicalStr(node);
+	return node;
+}
+
+CanonicalNode eis::canonicalize(Componant* model)
+{
+	size_t offset = 0;
+	return buildNode(model, offset);
+}
+
+std::vector<std::vector<size_t>> eis::getCanonicalParameterMap(const CanonicalNode& node)
+{
+	std::vector<std::vector<size_t>> out;
+	if(node.componant)
+	{
+		for(size_t i = 0; i < node.componant->paramCount(); ++i)
+		{
+			std::vector<size_t> sources;
+			for(size_t offset : node.offsets)
+				sources.push_back(offset + i);
+			out.push_back(sources);
+		}
+		return out;
+	}
+
+	for(const CanonicalNode& child : node.children)
+	{
+		std::vector<std::vector<size_t>> childMap = getCanonicalParameterMap(child);
+		out.insert(out.end(), childMap.begin(), childMap.end());
+	}
+	return out;
+}
+
+Componant* eis::createCanonicalComponant(const CanonicalNode& node)
+{
+	if(node.componant)
+		return Componant::copy(node.componant);
+
+	std::vector<Componant*> children;
+	for(const CanonicalNode& child : node.children)
+		children.push_back(createCanonicalComponant(child));
+
+	if(node.type == Network::staticGetComponantChar())
+		return new Network(children, node.terminals);
+	if(node.type == Parallel::staticGetComponantChar())
+		return new Parallel(children);
+	return new Serial(children);
+}
@@ -0,0 +1,63 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "componant/componant.h"
+
+namespace eis
+{
+
+/**
+* A node of the canonical form of a circuit.
+*
+* In canonical form nested Parallel and Serial nodes of the same type are flattened, resistors in series are merged
+* and the children of every node are sorted by their canonical string, so that circuits that differ only in
+* the order of commutative elements share the same canonical form. The elements of a Network keep their order,
+* terminals holds the pair of nodes every child of a Network node connects.
+*/
+struct CanonicalNode
+{
+	char type;
+	Componant* componant = nullptr;
+	std::vector<size_t> offsets;
+	std::vector<CanonicalNode> children;
+	std::vector<std::pair<size_t, size_t>> terminals;
+	std::string str;
+};
+
+CanonicalNode canonicalize(Componant* model);
+
+/**
+* Gets, for every parameter of the canonical circuit in canonical order, the indices of the parameters of the original circuit
+* in the order of Model::getFlatParameters that sum to it.
+*/
+std::vector<std::vector<size_t>> getCanonicalParameterMap(const CanonicalNode& node);
+
+/**
+* Creates a componant tree in canonical order from copies of the original componants.
+*/
+Componant* createCanonicalComponant(const CanonicalNode& node);
+
+}
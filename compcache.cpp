@@ -27,6 +27,9 @@
 #include <complex>
 #include <dlfcn.h>
 
+#include "kernelcatalog.h"
+#include "log.h"
+
 using namespace eis;
 
 std::string eis::getTempdir()
@@ -60,10 +63,65 @@ std::string eis::getTempdir()
 CompCache* CompCache::getInstance()
 {
 	if(!instance)
+	{
 		instance = new CompCache();
+		instance->loadDefaultCatalog();
+	}
 	return instance;
 }
 
+void CompCache::loadDefaultCatalog()
+{
+	char* catalogEnv = getenv("EISGENERATOR_KERNEL_CATALOG");
+	if(catalogEnv && std::string(catalogEnv).length() > 0)
+	{
+		if(loadCatalog(catalogEnv) == 0)
+			Log(Log::WARN)<<"No kernels could be loaded from the catalog "<<catalogEnv;
+		return;
+	}
+
+#ifdef _WIN32
+	loadCatalog("libeisgenerator_kernels.dll");
+#else
+	loadCatalog("libeisgenerator_kernels.so");
+#endif
+}
+
+size_t CompCache::loadCatalog(const std::string& path)
+{
+	// the catalog is never closed as its kernels stay in the cache for the lifetime of the process
+	void* handle = dlopen(path.c_str(), RTLD_NOW);
+	if(!handle)
+	{
+		Log(Log::DEBUG)<<"No kernel catalog at "<<path;
+		return 0;
+	}
+
+	const KernelCatalogEntry* entries = static_cast<const KernelCatalogEntry*>(dlsym(handle, KERNEL_CATALOG_SYMBOL));
+	const unsigned long long* size = static_cast<const unsigned long long*>(dlsym(handle, KERNEL_CATALOG_SIZE_SYMBOL));
+	if(!entries || !size)
+	{
+		Log(Log::WARN)<<path<<" is not a eisgenerator kernel catalog";
+		dlclose(handle);
+		return 0;
+	}
+
+	size_t added = 0;
+	for(unsigned long long i = 0; i < *size; ++i)
+	{
+		CompiledObject object;
+		object.objectCode = nullptr;
+		object.symbol =
+			reinterpret_cast<std::vector<std::complex<fvalue>>(*)(const std::vector<fvalue>&, const std::vector<fvalue>&)>
+				(entries[i].symbol);
+		catalogObjects.push_back({entries[i].uuid, object});
+		if(addObject(entries[i].uuid, object))
+			++added;
+	}
+	Log(Log::DEBUG)<<"Loaded "<<added<<" kernels from "<<path;
+	return added;
+}
+
 bool CompCache::addObject(size_t uuid, const CompiledObject& object)
 {
 	CompiledObject* foundobject = getObject(uuid);
@@ -87,9 +145,13 @@ void CompCache::dropAllObjects()
 {
 	for(std::pair<size_t, CompiledObject*> object : objects)
 	{
-		dlclose(object.second->objectCode);
+		if(object.second->objectCode)
+			dlclose(object.second->objectCode);
 		delete object.second;
 	}
 
 	objects.clear();
+
+	for(const std::pair<size_t, CompiledObject>& object : catalogObjects)
+		addObject(object.first, object.second);
 }
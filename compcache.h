@@ -43,7 +43,9 @@ private:
 
 	inline static CompCache* instance = nullptr;
 	std::map<size_t, CompiledObject*> objects;
+	std::vector<std::pair<size_t, CompiledObject>> catalogObjects;
 	CompCache() {};
+	void loadDefaultCatalog();
 
 public:
 
@@ -53,6 +55,18 @@ public:
 	bool addObject(size_t uuid, const CompiledObject& object);
 	CompiledObject* getObject(size_t uuid);
 	void dropAllObjects();
+
+	/**
+	* Loads a kernel catalog library built by eisgenerator_kernelgen and adds its kernels to the cache.
+	*
+	* The kernels of a catalog remain in the cache after dropAllObjects. The catalog named by the environment variable
+	* EISGENERATOR_KERNEL_CATALOG, or otherwise libeisgenerator_kernels in the library search path, is loaded when the
+	* cache is first used.
+	*
+	* @param path The path of the library, or its name to search for it in the library search path.
+	* @return The number of kernels added.
+	*/
+	size_t loadCatalog(const std::string& path);
 };
 
 }
@@ -68,7 +68,12 @@ int eis::compile_code(const std::string& code, const std::string& outputName)
 		close(childStdoutPipe[PIPE_WRITE]);
 		close(childStdoutPipe[PIPE_READ]);
 
+#if defined(__x86_64__) && defined(__linux__)
+		// kernels carry their own instruction set variants via EIS_KERNEL, see KERNEL_ATTRIBUTE_CODE
+		ret = execlp("g++", "gcc", "--shared", "-O2", "-ffast-math", "-ftree-vectorize", "-x", "c++", "-o", outputName.c_str(), "-", NULL);
+#else
 		ret = execlp("g++", "gcc", "--shared", "-O2", "-ffast-math", "-ftree-vectorize", "-march=native", "-x", "c++", "-o", outputName.c_str(), "-", NULL);
+#endif
 
 		exit(ret);
 	}
@@ -22,6 +22,23 @@
 namespace eis
 {
 
+/*
+* Prepended to generated kernels, kernels are marked with EIS_KERNEL so that they are built for several
+* instruction sets and the best one for the executing cpu is selected when the object is loaded.
+* This allows the same object to be used on every node of a cluster that shares its temporary directory.
+*/
+inline constexpr char KERNEL_ATTRIBUTE_CODE[] =
+"#ifndef EIS_KERNEL\n"
+"#if defined(__x86_64__) && defined(__linux__) && defined(__has_attribute)\n"
+"#if __has_attribute(target_clones)\n"
+"#define EIS_KERNEL __attribute__((target_clones(\"default\", \"sse4.2\", \"avx2\", \"avx512f\")))\n"
+"#endif\n"
+"#endif\n"
+"#ifndef EIS_KERNEL\n"
+"#define EIS_KERNEL\n"
+"#endif\n"
+"#endif\n\n";
+
 int compile_code(const std::string& code, const std::string& outputName);
 
 }
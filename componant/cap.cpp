@@ -19,11 +19,14 @@
 //
 
 #include "componant/cap.h"
+#include "componant/formulas.h"
 #include <cstdlib>
 #include <math.h>
 #include <cassert>
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -66,7 +69,40 @@ std::vector<eis::Range> Cap::getDefaultParameters(bool range) const
 std::complex<fvalue> Cap::execute(fvalue omega)
 {
 	assert(ranges.size() > 0);
-	return std::complex<fvalue>(0, 0.0-(1.0/(ranges[0][ranges[0].step]*omega)));
+	return formulas::capImpedance(omega, parameter(0));
+}
+
+void Cap::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() > 0);
+	// a division is as cheap as a table lookup here and keeps the result bit identical to execute(fvalue)
+	const std::vector<fvalue>& omega = plan.getOmega();
+	fvalue c = parameter(0);
+	for(size_t i = 0; i < omega.size(); ++i)
+		out[i] = formulas::capImpedance(omega[i], c);
+}
+
+std::complex<fvalue> Cap::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	assert(ranges.size() > 0);
+	fvalue c = parameter(0);
+	jacobian[0] = std::complex<fvalue>(0, 1.0/(c*c*omega));
+	return formulas::capImpedance(omega, c);
+}
+
+std::complex<fvalue> Cap::executeAdmittance(fvalue omega)
+{
+	assert(ranges.size() > 0);
+	return formulas::capAdmittance(omega, parameter(0));
+}
+
+void Cap::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() > 0);
+	const std::vector<fvalue>& omega = plan.getOmega();
+	fvalue c = parameter(0);
+	for(size_t i = 0; i < omega.size(); ++i)
+		out[i] = formulas::capAdmittance(omega[i], c);
 }
 
 char Cap::getComponantChar() const
@@ -89,6 +125,18 @@ std::string Cap::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Cap::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr c = graph.parameter(getUniqueName() + "_0");
+	return graph.complex(graph.constant(0), graph.neg(graph.div(graph.constant(1), graph.mul(c, graph.omega()))));
+}
+
+size_t Cap::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr c = graph.parameter(getUniqueName() + "_0");
+	return graph.complex(graph.constant(0), graph.mul(c, graph.omega()));
+}
+
 std::string Cap::getTorchScript(std::vector<std::string>& parameters)
 {
 	parameters.push_back(getUniqueName() + "_0");
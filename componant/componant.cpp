@@ -21,6 +21,8 @@
 #include "componant/componant.h"
 #include <assert.h>
 #include <sstream>
+#include <cmath>
+#include <limits>
 #include "componant/paralellseriel.h"
 #include "componant/resistor.h"
 #include "componant/cap.h"
@@ -31,20 +33,42 @@
 #include "componant/inductor.h"
 #include "componant/tro.h"
 #include "componant/trc.h"
+#include "componant/ladder.h"
+#include "componant/network.h"
 #include "randomgen.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
 void Componant::setParamRanges(const std::vector<eis::Range>& rangesIn)
 {
 	ranges = rangesIn;
+	resolved = false;
 }
 
 std::vector<eis::Range>& Componant::getParamRanges()
 {
+	// the caller may change the steps or the ranges themselves
+	resolved = false;
 	return ranges;
 }
 
+void Componant::setResolvedParameters(const std::vector<fvalue>& values)
+{
+	assert(values.size() == ranges.size());
+	resolvedValues = values;
+	resolved = true;
+}
+
+std::vector<fvalue> Componant::getParameterValues() const
+{
+	std::vector<fvalue> out(ranges.size());
+	for(size_t i = 0; i < ranges.size(); ++i)
+		out[i] = parameter(i);
+	return out;
+}
+
 std::vector<eis::Range> Componant::getParamRanges() const
 {
 	return ranges;
@@ -109,6 +133,69 @@ std::string Componant::getCode(std::vector<std::string>& parameters)
 	return std::string();
 }
 
+size_t Componant::getExpression(ExprGraph& graph)
+{
+	(void)graph;
+	return ExprGraph::INVALID;
+}
+
+size_t Componant::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr impedance = getExpression(graph);
+	if(impedance == ExprGraph::INVALID)
+		return ExprGraph::INVALID;
+	return graph.div(graph.constant(1), impedance);
+}
+
+void Componant::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	const std::vector<fvalue>& omega = plan.getOmega();
+	for(size_t i = 0; i < omega.size(); ++i)
+		out[i] = execute(omega[i]);
+}
+
+std::complex<fvalue> Componant::executeAdmittance(fvalue omega)
+{
+	return std::complex<fvalue>(1, 0)/execute(omega);
+}
+
+void Componant::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	execute(plan, out);
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(1, 0)/out[i];
+}
+
+std::complex<fvalue> Componant::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	const std::complex<fvalue> value = execute(omega);
+	if(paramCount() == 0)
+		return value;
+
+	const bool wasResolved = resolved;
+	const std::vector<fvalue> previous = resolvedValues;
+	const std::vector<fvalue> values = getParameterValues();
+	std::vector<fvalue> perturbed = values;
+	const fvalue relativeStep = std::cbrt(std::numeric_limits<fvalue>::epsilon());
+	for(size_t i = 0; i < values.size(); ++i)
+	{
+		const fvalue step = values[i] != 0 ? std::abs(values[i])*relativeStep : relativeStep;
+		perturbed[i] = values[i] + step;
+		setResolvedParameters(perturbed);
+		const std::complex<fvalue> upper = execute(omega);
+		const fvalue upperValue = perturbed[i];
+		perturbed[i] = values[i] - step;
+		setResolvedParameters(perturbed);
+		const std::complex<fvalue> lower = execute(omega);
+		jacobian[i] = (upper - lower)/(upperValue - perturbed[i]);
+		perturbed[i] = values[i];
+	}
+
+	resolvedValues = previous;
+	resolved = wasResolved;
+	return value;
+}
+
 std::string Componant::getTorchScript(std::vector<std::string>& parameters)
 {
 	(void)parameters;
@@ -133,10 +220,14 @@ Componant* Componant::copy(Componant* componant)
 			return new TransmissionLineOpen(*dynamic_cast<TransmissionLineOpen*>(componant));
 		case TransmissionLineClosed::staticGetComponantChar():
 			return new TransmissionLineClosed(*dynamic_cast<TransmissionLineClosed*>(componant));
+		case Ladder::staticGetComponantChar():
+			return new Ladder(*dynamic_cast<Ladder*>(componant));
 		case Parallel::staticGetComponantChar():
 			return new Parallel(*dynamic_cast<Parallel*>(componant));
 		case Serial::staticGetComponantChar():
 			return new Serial(*dynamic_cast<Serial*>(componant));
+		case Network::staticGetComponantChar():
+			return new Network(*dynamic_cast<Network*>(componant));
 		default:
 			Log(Log::ERROR)<<"unimplmented type copy for "<<componant->getComponantChar();
 			assert(0);
@@ -163,6 +254,8 @@ Componant* Componant::createNewComponant(char componant, std::string paramStr, s
 			return new TransmissionLineOpen(paramStr, count, defaultToRange);
 		case TransmissionLineClosed::staticGetComponantChar():
 			return new TransmissionLineClosed(paramStr, count, defaultToRange);
+		case Ladder::staticGetComponantChar():
+			return new Ladder(paramStr, count, defaultToRange);
 		default:
 			return nullptr;
 	}
@@ -179,6 +272,7 @@ bool Componant::isValidComponantChar(char componantCh)
 		case Warburg::staticGetComponantChar():
 		case TransmissionLineOpen::staticGetComponantChar():
 		case TransmissionLineClosed::staticGetComponantChar():
+		case Ladder::staticGetComponantChar():
 			return true;
 		default:
 			return false;
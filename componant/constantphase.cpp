@@ -19,6 +19,7 @@
 //
 
 #include "componant/constantphase.h"
+#include "componant/formulas.h"
 #include <cstdlib>
 #include <string>
 #define _USE_MATH_DEFINES
@@ -30,6 +31,8 @@
 #endif
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -90,9 +93,54 @@ std::vector<eis::Range> Cpe::getDefaultParameters(bool range) const
 std::complex<fvalue> Cpe::execute(fvalue omega)
 {
 	assert(ranges.size() == paramCount());
-	fvalue real = (1.0/(ranges[0][ranges[0].step]*std::pow(omega, ranges[1][ranges[1].step])))*std::cos((M_PI/2)*ranges[1][ranges[1].step]);
-	fvalue imag = 0-(1.0/(ranges[0][ranges[0].step]*std::pow(omega, ranges[1][ranges[1].step])))*std::sin((M_PI/2)*ranges[1][ranges[1].step]);
-	return std::complex<fvalue>(real, imag);
+	return formulas::cpeImpedance(omega, parameter(0), parameter(1));
+}
+
+void Cpe::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	fvalue q = parameter(0);
+	fvalue alpha = parameter(1);
+	fvalue real = std::cos((M_PI/2)*alpha)/q;
+	fvalue imag = 0-std::sin((M_PI/2)*alpha)/q;
+
+	// 1/omega^alpha is evaluated as one exponential of the logarithm table
+	for(size_t i = 0; i < plan.size(); ++i)
+	{
+		fvalue inversePow = plan.powAt(0-alpha, i);
+		out[i] = std::complex<fvalue>(real*inversePow, imag*inversePow);
+	}
+}
+
+std::complex<fvalue> Cpe::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	assert(ranges.size() == paramCount());
+	std::complex<fvalue> z = execute(omega);
+	// z = (j*omega)^-alpha/q thus dz/dalpha = -z*ln(j*omega)
+	jacobian[0] = -z/parameter(0);
+	jacobian[1] = -z*std::complex<fvalue>(std::log(omega), M_PI/2);
+	return z;
+}
+
+std::complex<fvalue> Cpe::executeAdmittance(fvalue omega)
+{
+	assert(ranges.size() == paramCount());
+	return formulas::cpeAdmittance(omega, parameter(0), parameter(1));
+}
+
+void Cpe::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	fvalue q = parameter(0);
+	fvalue alpha = parameter(1);
+	fvalue real = q*std::cos((M_PI/2)*alpha);
+	fvalue imag = q*std::sin((M_PI/2)*alpha);
+
+	for(size_t i = 0; i < plan.size(); ++i)
+	{
+		fvalue omegaPow = plan.powAt(alpha, i);
+		out[i] = std::complex<fvalue>(real*omegaPow, imag*omegaPow);
+	}
 }
 
 size_t Cpe::paramCount() const
@@ -117,6 +165,24 @@ std::string Cpe::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Cpe::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr q = graph.parameter(getUniqueName() + "_0");
+	ExprGraph::Expr p = graph.parameter(getUniqueName() + "_1");
+	ExprGraph::Expr magnitude = graph.div(graph.constant(1), graph.mul(q, graph.pow(graph.omega(), p)));
+	ExprGraph::Expr angle = graph.mul(graph.constant(M_PI/2), p);
+	return graph.complex(graph.mul(magnitude, graph.cos(angle)), graph.neg(graph.mul(magnitude, graph.sin(angle))));
+}
+
+size_t Cpe::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr q = graph.parameter(getUniqueName() + "_0");
+	ExprGraph::Expr p = graph.parameter(getUniqueName() + "_1");
+	ExprGraph::Expr magnitude = graph.mul(q, graph.pow(graph.omega(), p));
+	ExprGraph::Expr angle = graph.mul(graph.constant(M_PI/2), p);
+	return graph.complex(graph.mul(magnitude, graph.cos(angle)), graph.mul(magnitude, graph.sin(angle)));
+}
+
 std::string Cpe::getTorchScript(std::vector<std::string>& parameters)
 {
 	std::string hpi = std::to_string(M_PI/2);
@@ -19,11 +19,14 @@
 //
 
 #include "componant/inductor.h"
+#include "componant/formulas.h"
 #include <cstdlib>
 #include <math.h>
 #include <cassert>
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -66,7 +69,38 @@ std::vector<eis::Range> Inductor::getDefaultParameters(bool range) const
 std::complex<fvalue> Inductor::execute(fvalue omega)
 {
 	assert(ranges.size() == paramCount());
-	return std::complex<fvalue>(0, ranges[0][ranges[0].step]*omega);
+	return formulas::inductorImpedance(omega, parameter(0));
+}
+
+void Inductor::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	const std::vector<fvalue>& omega = plan.getOmega();
+	fvalue l = parameter(0);
+	for(size_t i = 0; i < omega.size(); ++i)
+		out[i] = formulas::inductorImpedance(omega[i], l);
+}
+
+std::complex<fvalue> Inductor::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	assert(ranges.size() == paramCount());
+	jacobian[0] = std::complex<fvalue>(0, omega);
+	return formulas::inductorImpedance(omega, parameter(0));
+}
+
+std::complex<fvalue> Inductor::executeAdmittance(fvalue omega)
+{
+	assert(ranges.size() == paramCount());
+	return formulas::inductorAdmittance(omega, parameter(0));
+}
+
+void Inductor::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	const std::vector<fvalue>& inverseOmega = plan.getInverseOmega();
+	fvalue inverseL = 1/parameter(0);
+	for(size_t i = 0; i < inverseOmega.size(); ++i)
+		out[i] = std::complex<fvalue>(0, 0-inverseL*inverseOmega[i]);
 }
 
 size_t Inductor::paramCount() const
@@ -87,6 +121,18 @@ std::string Inductor::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Inductor::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr l = graph.parameter(getUniqueName() + "_0");
+	return graph.complex(graph.constant(0), graph.mul(l, graph.omega()));
+}
+
+size_t Inductor::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr l = graph.parameter(getUniqueName() + "_0");
+	return graph.complex(graph.constant(0), graph.neg(graph.div(graph.constant(1), graph.mul(l, graph.omega()))));
+}
+
 std::string Inductor::getTorchScript(std::vector<std::string>& parameters)
 {
 	parameters.push_back(getUniqueName() + "_0");
@@ -0,0 +1,285 @@
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "componant/ladder.h"
+#include <cstdlib>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+#include "log.h"
+#include "frequencyplan.h"
+
+using namespace eis;
+
+// gradings set after construction, ie. by a fit, are clamped to this so that the stage values stay finite
+static constexpr fvalue MIN_GRADING = 0.01;
+
+Ladder::Ladder(fvalue r, fvalue c, fvalue n, fvalue g)
+{
+	ranges.clear();
+	ranges.push_back(Range(r, r, 1));
+	ranges.push_back(Range(c, c, 1));
+	ranges.push_back(Range(n, n, 1));
+	ranges.push_back(Range(g, g, 1));
+	checkGrading();
+}
+
+Ladder::Ladder(std::string paramStr, size_t count, bool defaultToRange)
+{
+	if(!paramStr.empty())
+		ranges = Range::rangesFromParamString(paramStr, count);
+
+	if(ranges.size() == paramCount()-1)
+		ranges.push_back(Range(1, 1, 1));
+
+	if(ranges.size() != paramCount())
+	{
+		ranges = getDefaultParameters(defaultToRange);
+		if(defaultToRange)
+		{
+			ranges[0].count = count;
+			ranges[1].count = count;
+		}
+		Log(Log::WARN)<<__func__<<" default range of "<<getComponantString(false)<<" will be used";
+	}
+	checkGrading();
+}
+
+std::vector<eis::Range> Ladder::getDefaultParameters(bool range) const
+{
+	std::vector<eis::Range> out;
+
+	if(range)
+	{
+		out.push_back(Range(1, 1e4, 2, true));
+		out.push_back(Range(1e-10, 1e-4, 2, true));
+	}
+	else
+	{
+		out.push_back(Range(100, 100, 1));
+		out.push_back(Range(1e-6, 1e-6, 1));
+	}
+	out.push_back(Range(10, 10, 1));
+	out.push_back(Range(1, 1, 1));
+
+	assert(out.size() == paramCount());
+	return out;
+}
+
+size_t Ladder::getStages() const
+{
+	long stages = std::lround(parameter(2));
+	return stages < 1 ? 1 : stages;
+}
+
+fvalue Ladder::getGrading() const
+{
+	return std::max(parameter(3), MIN_GRADING);
+}
+
+void Ladder::checkGrading() const
+{
+	if(ranges[3].start <= 0 || ranges[3].end <= 0)
+		throw parse_errror(getComponantString(false) + " requires a positive grading");
+}
+
+/*
+* Every stage consists of a series resistor followed by a capacitor to ground that shunts the remaining stages,
+* the last capacitor terminates the ladder. The total resistance r and capacitance c are distributed over the stages
+* so that the values of every stage are g times those of the previous one.
+*
+* The share of the largest stage is (1-h)/(1-h^n) with h = min(g, 1/g) <= 1 and every other stage is h times its
+* larger neighbour, so no power of g can overflow, stages that are negligible compared to the largest one
+* underflow to 0 instead.
+*/
+double Ladder::getLargestStage(double logRatio, size_t stages)
+{
+	return logRatio == 0 ? 1.0/stages : std::expm1(logRatio)/std::expm1(stages*logRatio);
+}
+
+double Ladder::getStageFraction(double g, double logRatio, double largest, size_t stages, size_t stage)
+{
+	size_t distance = g > 1 ? stages-1-stage : stage;
+	return largest*std::exp(logRatio*distance);
+}
+
+/*
+* The ladder is evaluated as an admittance from the terminating stage towards the input, every stage maps the
+* admittance y of the stages behind it to a/(1 + r_k*a) with a = y + j*omega*c_k. Unlike the impedance the admittance
+* stays finite for stages whose values underflow, and the real part of 1 + r_k*a is always at least 1.
+* The stages are the outer loop so that the inner loop over the frequencies vectorizes.
+*/
+void Ladder::admittance(const fvalue* omega, size_t count, fvalue r, fvalue c, fvalue g, size_t stages, double* re, double* im)
+{
+	for(size_t i = 0; i < count; ++i)
+	{
+		re[i] = 0;
+		im[i] = 0;
+	}
+
+	const double logRatio = 0-std::abs(std::log(static_cast<double>(g)));
+	const double largest = getLargestStage(logRatio, stages);
+	for(size_t k = stages; k-- > 0;)
+	{
+		const double fraction = getStageFraction(g, logRatio, largest, stages, k);
+		const double rk = r*fraction;
+		const double ck = c*fraction;
+		for(size_t i = 0; i < count; ++i)
+		{
+			const double aRe = re[i];
+			const double aIm = im[i] + omega[i]*ck;
+			const double dRe = 1 + rk*aRe;
+			const double dIm = rk*aIm;
+			const double norm = dRe*dRe + dIm*dIm;
+			re[i] = (aRe*dRe + aIm*dIm)/norm;
+			im[i] = (aIm*dRe - aRe*dIm)/norm;
+		}
+	}
+}
+
+std::complex<fvalue> Ladder::execute(fvalue omega)
+{
+	assert(ranges.size() == paramCount());
+	double re;
+	double im;
+	admittance(&omega, 1, parameter(0), parameter(1), getGrading(), getStages(), &re, &im);
+	return std::complex<fvalue>(1.0/std::complex<double>(re, im));
+}
+
+void Ladder::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	scratch.resize(plan.size()*2);
+	double* re = scratch.data();
+	double* im = scratch.data() + plan.size();
+	admittance(plan.getOmega().data(), plan.size(), parameter(0), parameter(1), getGrading(), getStages(), re, im);
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(1.0/std::complex<double>(re[i], im[i]));
+}
+
+/*
+* Forward mode differentiation of the admittance recurrence, with d/dp of y' = a/d being (da - y'*dd)/d.
+* The share f_k = g^k/sum(g^j) of stage k has df_k/dg = f_k*(k - m)/g, where m = sum(j*f_j) is the mean stage index.
+*/
+std::complex<fvalue> Ladder::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	assert(ranges.size() == paramCount());
+	const double r = parameter(0);
+	const double c = parameter(1);
+	const double g = getGrading();
+	const bool clamped = parameter(3) < MIN_GRADING;
+	const size_t stages = getStages();
+
+	const double logRatio = 0-std::abs(std::log(g));
+	const double largest = getLargestStage(logRatio, stages);
+	double meanStage = 0;
+	for(size_t k = 0; k < stages; ++k)
+		meanStage += k*getStageFraction(g, logRatio, largest, stages, k);
+
+	std::complex<double> y(0, 0);
+	std::complex<double> dy[3] = {};
+	for(size_t k = stages; k-- > 0;)
+	{
+		const double fraction = getStageFraction(g, logRatio, largest, stages, k);
+		const double dFraction = clamped ? 0 : fraction*(k - meanStage)/g;
+		const double rk = r*fraction;
+		// derivatives of r_k and c_k with respect to r, c and g
+		const double drk[3] = {fraction, 0, r*dFraction};
+		const double dck[3] = {0, fraction, c*dFraction};
+
+		const std::complex<double> a = y + std::complex<double>(0, omega*c*fraction);
+		const std::complex<double> d = 1.0 + rk*a;
+		y = a/d;
+		for(size_t p = 0; p < 3; ++p)
+		{
+			const std::complex<double> da = dy[p] + std::complex<double>(0, omega*dck[p]);
+			const std::complex<double> dd = drk[p]*a + rk*da;
+			dy[p] = (da - y*dd)/d;
+		}
+	}
+
+	const std::complex<double> z = 1.0/y;
+	jacobian[0] = std::complex<fvalue>(0.0-z*z*dy[0]);
+	jacobian[1] = std::complex<fvalue>(0.0-z*z*dy[1]);
+	jacobian[2] = std::complex<fvalue>(0, 0);
+	jacobian[3] = std::complex<fvalue>(0.0-z*z*dy[2]);
+	return std::complex<fvalue>(z);
+}
+
+size_t Ladder::paramCount() const
+{
+	return 4;
+}
+
+char Ladder::getComponantChar() const
+{
+	return staticGetComponantChar();
+}
+
+std::string Ladder::getCode(std::vector<std::string>& parameters)
+{
+	std::string r = getUniqueName() + "_0";
+	std::string c = getUniqueName() + "_1";
+	std::string n = getUniqueName() + "_2";
+	std::string g = getUniqueName() + "_3";
+	parameters.push_back(r);
+	parameters.push_back(c);
+	parameters.push_back(n);
+	parameters.push_back(g);
+
+	// the recurrence is emitted as an immediately invoked lambda so that it can be used in an expression
+	std::string out = "([&]() -> std::complex<fvalue> {";
+	out += "const long stagesIn = std::lround(" + n + "); const size_t stages = stagesIn < 1 ? 1 : stagesIn; ";
+	out += "const double grading = " + g + " < " + std::to_string(MIN_GRADING) + "f ? " + std::to_string(MIN_GRADING) + "f : " + g + "; ";
+	out += "const double logRatio = 0-std::abs(std::log(grading)); ";
+	out += "const double largest = logRatio == 0 ? 1.0/stages : std::expm1(logRatio)/std::expm1(stages*logRatio); ";
+	out += "std::complex<double> y(0, 0); ";
+	out += "for(size_t k = stages; k-- > 0;) {";
+	out += "const double fraction = largest*std::exp(logRatio*(grading > 1 ? stages-1-k : k)); ";
+	out += "const std::complex<double> a = y + std::complex<double>(0, fraction*omega*" + c + "); ";
+	out += "y = a/(1.0 + fraction*" + r + "*a);} ";
+	out += "return std::complex<fvalue>(1.0/y);}())";
+	return out;
+}
+
+std::string Ladder::getTorchScript(std::vector<std::string>& parameters)
+{
+	std::string r = getUniqueName() + "_0";
+	std::string c = getUniqueName() + "_1";
+	std::string n = getUniqueName() + "_2";
+	std::string g = getUniqueName() + "_3";
+	parameters.push_back(r);
+	parameters.push_back(c);
+	parameters.push_back(n);
+	parameters.push_back(g);
+
+	if(ranges[3].start != 1 || ranges[3].end != 1)
+		Log(Log::WARN)<<"TorchScript of "<<getComponantString(false)<<" ignores the grading of the ladder";
+
+	/* A uniform ladder has the closed form (sinh(t)*coth(n*t) + j*omega*c_k*r_k/2)/(j*omega*c_k)
+	* with cosh(t) = 1 + j*omega*c_k*r_k/2, which avoids a loop over the stages in TorchScript. */
+	std::string stages = "torch.clamp(torch.round(" + n + "), min=1)";
+	std::string jwc = "(1j*omegas*" + c + "/" + stages + ")";
+	std::string half = "(" + jwc + "*" + r + "/" + stages + "/2)";
+	std::string theta = "torch.acosh(1+" + half + ")";
+	return "((torch.sinh(" + theta + ")/torch.tanh(" + stages + "*" + theta + ") + " + half + ")/" + jwc + ")";
+}
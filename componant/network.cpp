@@ -0,0 +1,445 @@
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "componant/network.h"
+#include <map>
+#include <set>
+#include <limits>
+#include <numeric>
+#include <algorithm>
+
+#include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
+
+using namespace eis;
+
+static constexpr size_t NO_SLOT = std::numeric_limits<size_t>::max();
+
+Network::Network(std::vector<Componant*> componantsIn, std::vector<std::pair<size_t, size_t>> terminalsIn):
+componants(componantsIn), terminals(terminalsIn)
+{
+	try
+	{
+		analyse();
+	}
+	catch(...)
+	{
+		for(Componant* componant : componants)
+			delete componant;
+		componants.clear();
+		throw;
+	}
+}
+
+Network::Network(const Network& in)
+{
+	operator=(in);
+}
+
+void Network::operator=(const Network& in)
+{
+	for(Componant* componant : componants)
+		delete componant;
+	componants.clear();
+	componants.reserve(in.componants.size());
+	for(Componant* componant : in.componants)
+		componants.push_back(copy(componant));
+	terminals = in.terminals;
+	_stamps = in._stamps;
+	_eliminations = in._eliminations;
+	_slots = in._slots;
+	_terminalSlot = in._terminalSlot;
+}
+
+Network::~Network()
+{
+	for(Componant* componant : componants)
+		delete componant;
+}
+
+size_t Network::getNodeCount() const
+{
+	size_t nodes = TERMINAL_NODE+1;
+	for(const std::pair<size_t, size_t>& terminal : terminals)
+		nodes = std::max(nodes, std::max(terminal.first, terminal.second)+1);
+	return nodes;
+}
+
+/*
+* The impedance between the terminal node and the reference node is the inverse of the admittance that remains at the terminal
+* node once all other nodes are eliminated from the nodal admittance matrix, as the terminal node is ordered last no back
+* substitution is required. The nodal admittance matrix of a network of reciprocal elements is symmetric, thus only its upper
+* triangle is stored, as a flat array of slots. Which slots exist and the sequence of updates that eliminates the nodes depend
+* only on the topology, so they are computed here once and reused for every frequency and every set of parameters.
+*/
+void Network::analyse()
+{
+	if(componants.size() != terminals.size())
+		throw parse_errror("every element of a network requires a pair of nodes");
+
+	// every node has to be connected to the reference node, thus a network of n elements can not have nodes above n
+	for(const std::pair<size_t, size_t>& terminal : terminals)
+	{
+		size_t node = std::max(terminal.first, terminal.second);
+		if(node > componants.size())
+			throw parse_errror("node " + std::to_string(node) + " exceeds the " + std::to_string(componants.size()) +
+				" nodes a network of this many elements can connect");
+	}
+	const size_t nodes = getNodeCount();
+
+	std::vector<size_t> root(nodes);
+	std::iota(root.begin(), root.end(), 0);
+	auto find = [&root](size_t node)
+	{
+		while(root[node] != node)
+			node = root[node] = root[root[node]];
+		return node;
+	};
+	for(size_t i = 0; i < terminals.size(); ++i)
+	{
+		if(terminals[i].first == terminals[i].second)
+			throw parse_errror(componants[i]->getComponantString(false) + " connects node " +
+				std::to_string(terminals[i].first) + " of the network to itself");
+		root[find(terminals[i].first)] = find(terminals[i].second);
+	}
+	for(size_t node = 1; node < nodes; ++node)
+	{
+		if(find(node) != find(REFERENCE_NODE))
+			throw parse_errror("node " + std::to_string(node) + " of the network is not connected to the reference node");
+	}
+
+	std::map<std::pair<size_t, size_t>, size_t> slotMap;
+	auto slot = [&slotMap](size_t i, size_t j)
+	{
+		if(i > j)
+			std::swap(i, j);
+		return slotMap.try_emplace(std::pair<size_t, size_t>(i, j), slotMap.size()).first->second;
+	};
+
+	// the reference node is not an unknown of the system and has no slots
+	std::vector<std::set<size_t>> adjacency(nodes);
+	for(size_t node = 1; node < nodes; ++node)
+		slot(node, node);
+
+	_stamps.clear();
+	for(const std::pair<size_t, size_t>& terminal : terminals)
+	{
+		const size_t a = terminal.first;
+		const size_t b = terminal.second;
+		std::array<size_t, 3> stamp = {NO_SLOT, NO_SLOT, NO_SLOT};
+		if(a != REFERENCE_NODE)
+			stamp[0] = slot(a, a);
+		if(b != REFERENCE_NODE)
+			stamp[1] = slot(b, b);
+		if(a != REFERENCE_NODE && b != REFERENCE_NODE)
+		{
+			stamp[2] = slot(a, b);
+			adjacency[a].insert(b);
+			adjacency[b].insert(a);
+		}
+		_stamps.push_back(stamp);
+	}
+
+	// nodes are eliminated in order of minimum degree to keep the fill-in small, the terminal node remains
+	_eliminations.clear();
+	std::vector<bool> eliminated(nodes, false);
+	eliminated[REFERENCE_NODE] = true;
+	eliminated[TERMINAL_NODE] = true;
+	for(size_t step = 2; step < nodes; ++step)
+	{
+		size_t pivot = NO_SLOT;
+		for(size_t node = 0; node < nodes; ++node)
+		{
+			if(!eliminated[node] && (pivot == NO_SLOT || adjacency[node].size() < adjacency[pivot].size()))
+				pivot = node;
+		}
+
+		Elimination elimination;
+		elimination.node = pivot;
+		elimination.pivot = slot(pivot, pivot);
+		std::vector<size_t> neighbours(adjacency[pivot].begin(), adjacency[pivot].end());
+		for(size_t i = 0; i < neighbours.size(); ++i)
+		{
+			elimination.neighbours.push_back({neighbours[i], slot(neighbours[i], pivot)});
+			for(size_t j = i; j < neighbours.size(); ++j)
+			{
+				elimination.updates.push_back({slot(neighbours[i], neighbours[j]),
+					slot(neighbours[i], pivot), slot(neighbours[j], pivot)});
+				if(i != j)
+				{
+					adjacency[neighbours[i]].insert(neighbours[j]);
+					adjacency[neighbours[j]].insert(neighbours[i]);
+				}
+			}
+			adjacency[neighbours[i]].erase(pivot);
+		}
+		eliminated[pivot] = true;
+		_eliminations.push_back(std::move(elimination));
+	}
+
+	_terminalSlot = slot(TERMINAL_NODE, TERMINAL_NODE);
+	_slots = slotMap.size();
+}
+
+std::complex<fvalue> Network::execute(fvalue omega)
+{
+	return std::complex<fvalue>(1, 0)/executeAdmittance(omega);
+}
+
+void Network::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	executeAdmittance(plan, out);
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(1, 0)/out[i];
+}
+
+std::complex<fvalue> Network::executeAdmittance(fvalue omega)
+{
+	std::vector<std::complex<fvalue>> slots(_slots, std::complex<fvalue>(0, 0));
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		const std::complex<fvalue> admittance = componants[i]->executeAdmittance(omega);
+		const std::array<size_t, 3>& stamp = _stamps[i];
+		if(stamp[0] != NO_SLOT)
+			slots[stamp[0]] += admittance;
+		if(stamp[1] != NO_SLOT)
+			slots[stamp[1]] += admittance;
+		if(stamp[2] != NO_SLOT)
+			slots[stamp[2]] -= admittance;
+	}
+
+	for(const Elimination& elimination : _eliminations)
+	{
+		const std::complex<fvalue> inverse = std::complex<fvalue>(1, 0)/slots[elimination.pivot];
+		for(const std::array<size_t, 3>& update : elimination.updates)
+			slots[update[0]] -= slots[update[1]]*slots[update[2]]*inverse;
+	}
+	return slots[_terminalSlot];
+}
+
+/*
+* With the node voltages v for a unit current into the terminal node, the impedance is v[terminal] and, as the nodal
+* admittance matrix is symmetric, its derivative with respect to the admittance y of an element between the nodes a and b
+* is -(v[a] - v[b])^2. As only the terminal node has a non zero current, the voltages follow from back substitution
+* through the eliminated nodes without any forward pass over the right hand side.
+*/
+std::complex<fvalue> Network::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	std::vector<std::complex<fvalue>> slots(_slots, std::complex<fvalue>(0, 0));
+	std::vector<std::complex<fvalue>> admittances(componants.size());
+	std::complex<fvalue>* childJacobian = jacobian;
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		admittances[i] = std::complex<fvalue>(1, 0)/componants[i]->executeJacobian(omega, childJacobian);
+		childJacobian += componants[i]->flatParamCount();
+		const std::array<size_t, 3>& stamp = _stamps[i];
+		if(stamp[0] != NO_SLOT)
+			slots[stamp[0]] += admittances[i];
+		if(stamp[1] != NO_SLOT)
+			slots[stamp[1]] += admittances[i];
+		if(stamp[2] != NO_SLOT)
+			slots[stamp[2]] -= admittances[i];
+	}
+
+	for(const Elimination& elimination : _eliminations)
+	{
+		const std::complex<fvalue> inverse = std::complex<fvalue>(1, 0)/slots[elimination.pivot];
+		for(const std::array<size_t, 3>& update : elimination.updates)
+			slots[update[0]] -= slots[update[1]]*slots[update[2]]*inverse;
+	}
+
+	std::vector<std::complex<fvalue>> voltages(getNodeCount(), std::complex<fvalue>(0, 0));
+	voltages[TERMINAL_NODE] = std::complex<fvalue>(1, 0)/slots[_terminalSlot];
+	for(auto elimination = _eliminations.rbegin(); elimination != _eliminations.rend(); ++elimination)
+	{
+		std::complex<fvalue> accum(0, 0);
+		for(const std::pair<size_t, size_t>& neighbour : elimination->neighbours)
+			accum += slots[neighbour.second]*voltages[neighbour.first];
+		voltages[elimination->node] = -accum/slots[elimination->pivot];
+	}
+
+	// dz/dp = -(v[a] - v[b])^2*dy/dp and dy/dp = -y^2*dz_i/dp
+	childJacobian = jacobian;
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		std::complex<fvalue> factor = (voltages[terminals[i].first] - voltages[terminals[i].second])*admittances[i];
+		factor *= factor;
+		for(size_t j = 0; j < componants[i]->flatParamCount(); ++j)
+			childJacobian[j] *= factor;
+		childJacobian += componants[i]->flatParamCount();
+	}
+	return voltages[TERMINAL_NODE];
+}
+
+size_t Network::flatParamCount() const
+{
+	size_t count = 0;
+	for(Componant* componant : componants)
+		count += componant->flatParamCount();
+	return count;
+}
+
+void Network::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	// the slots are stored frequency minor so that every update is a loop over all frequencies
+	const size_t count = plan.size();
+	std::vector<std::complex<fvalue>> slots(_slots*count, std::complex<fvalue>(0, 0));
+	std::vector<std::complex<fvalue>> buffer(count);
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		componants[i]->executeAdmittance(plan, buffer.data());
+		const std::array<size_t, 3>& stamp = _stamps[i];
+		for(size_t k = 0; k < 2; ++k)
+		{
+			if(stamp[k] == NO_SLOT)
+				continue;
+			std::complex<fvalue>* slot = slots.data() + stamp[k]*count;
+			for(size_t j = 0; j < count; ++j)
+				slot[j] += buffer[j];
+		}
+		if(stamp[2] != NO_SLOT)
+		{
+			std::complex<fvalue>* slot = slots.data() + stamp[2]*count;
+			for(size_t j = 0; j < count; ++j)
+				slot[j] -= buffer[j];
+		}
+	}
+
+	for(const Elimination& elimination : _eliminations)
+	{
+		const std::complex<fvalue>* pivot = slots.data() + elimination.pivot*count;
+		for(size_t j = 0; j < count; ++j)
+			buffer[j] = std::complex<fvalue>(1, 0)/pivot[j];
+		for(const std::array<size_t, 3>& update : elimination.updates)
+		{
+			std::complex<fvalue>* target = slots.data() + update[0]*count;
+			const std::complex<fvalue>* left = slots.data() + update[1]*count;
+			const std::complex<fvalue>* right = slots.data() + update[2]*count;
+			for(size_t j = 0; j < count; ++j)
+				target[j] -= left[j]*right[j]*buffer[j];
+		}
+	}
+
+	const std::complex<fvalue>* terminal = slots.data() + _terminalSlot*count;
+	std::copy(terminal, terminal+count, out);
+}
+
+char Network::getComponantChar() const
+{
+	return staticGetComponantChar();
+}
+
+std::string Network::getComponantString(bool currentValue) const
+{
+	std::string out(1, getComponantChar());
+	out.push_back('[');
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		out.append(std::to_string(terminals[i].first) + "," + std::to_string(terminals[i].second) + ":");
+		out.append(componants[i]->getComponantString(currentValue));
+		out.push_back(';');
+	}
+	out.back() = ']';
+	return out;
+}
+
+bool Network::compileable()
+{
+	for(Componant* componant : componants)
+	{
+		if(!componant->compileable())
+			return false;
+	}
+	return true;
+}
+
+std::string Network::getCode(std::vector<std::string>& parameters)
+{
+	// the elimination is emitted as straight line code in an immediately invoked lambda so that it can be used in an expression
+	std::string out = "([&]() -> std::complex<fvalue> {std::complex<fvalue> a[" + std::to_string(_slots) + "] = {}; ";
+	out += "std::complex<fvalue> y; std::complex<fvalue> inverse; ";
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		out += "y = std::complex<fvalue>(1,0)/(" + componants[i]->getCode(parameters) + "); ";
+		for(size_t k = 0; k < 3; ++k)
+		{
+			if(_stamps[i][k] != NO_SLOT)
+				out += "a[" + std::to_string(_stamps[i][k]) + "] " + (k < 2 ? "+" : "-") + "= y; ";
+		}
+	}
+	for(const Elimination& elimination : _eliminations)
+	{
+		out += "inverse = std::complex<fvalue>(1,0)/a[" + std::to_string(elimination.pivot) + "]; ";
+		for(const std::array<size_t, 3>& update : elimination.updates)
+		{
+			out += "a[" + std::to_string(update[0]) + "] -= a[" + std::to_string(update[1]) + "]*a[" +
+				std::to_string(update[2]) + "]*inverse; ";
+		}
+	}
+	out += "return std::complex<fvalue>(1,0)/a[" + std::to_string(_terminalSlot) + "];}())";
+	return out;
+}
+
+size_t Network::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr admittance = getAdmittanceExpression(graph);
+	if(admittance == ExprGraph::INVALID)
+		return ExprGraph::INVALID;
+	return graph.div(graph.constant(1), admittance);
+}
+
+size_t Network::getAdmittanceExpression(ExprGraph& graph)
+{
+	std::vector<ExprGraph::Expr> slots(_slots, graph.constant(0));
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		ExprGraph::Expr admittance = componants[i]->getAdmittanceExpression(graph);
+		if(admittance == ExprGraph::INVALID)
+			return ExprGraph::INVALID;
+		const std::array<size_t, 3>& stamp = _stamps[i];
+		for(size_t k = 0; k < 2; ++k)
+		{
+			if(stamp[k] != NO_SLOT)
+				slots[stamp[k]] = graph.add(slots[stamp[k]], admittance);
+		}
+		if(stamp[2] != NO_SLOT)
+			slots[stamp[2]] = graph.sub(slots[stamp[2]], admittance);
+	}
+
+	for(const Elimination& elimination : _eliminations)
+	{
+		ExprGraph::Expr inverse = graph.div(graph.constant(1), slots[elimination.pivot]);
+		for(const std::array<size_t, 3>& update : elimination.updates)
+		{
+			slots[update[0]] = graph.sub(slots[update[0]],
+				graph.mul(graph.mul(slots[update[1]], slots[update[2]]), inverse));
+		}
+	}
+	return slots[_terminalSlot];
+}
+
+std::string Network::getTorchScript(std::vector<std::string>& parameters)
+{
+	(void)parameters;
+	Log(Log::ERROR)<<"TorchScript is not supported for networks";
+	return std::string();
+}
@@ -21,6 +21,8 @@
 #include "componant/paralellseriel.h"
 #include "componant/componant.h"
 #include "type.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -58,12 +60,72 @@ Parallel::~Parallel()
 
 std::complex<fvalue> Parallel::execute(fvalue omega)
 {
+	return std::complex<fvalue>(1,0)/executeAdmittance(omega);
+}
+
+void Parallel::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	executeAdmittance(plan, out);
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(1, 0)/out[i];
+}
+
+std::complex<fvalue> Parallel::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	// z = 1/sum(1/z_i) thus dz/dp = (z/z_i)^2*dz_i/dp for the parameters p of child i
+	std::vector<std::complex<fvalue>> impedances(componants.size());
+	std::complex<fvalue> admittance(0, 0);
+	std::complex<fvalue>* childJacobian = jacobian;
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		impedances[i] = componants[i]->executeJacobian(omega, childJacobian);
+		admittance += std::complex<fvalue>(1, 0)/impedances[i];
+		childJacobian += componants[i]->flatParamCount();
+	}
+
+	std::complex<fvalue> impedance = std::complex<fvalue>(1, 0)/admittance;
+	childJacobian = jacobian;
+	for(size_t i = 0; i < componants.size(); ++i)
+	{
+		std::complex<fvalue> ratio = impedance/impedances[i];
+		ratio *= ratio;
+		for(size_t j = 0; j < componants[i]->flatParamCount(); ++j)
+			childJacobian[j] *= ratio;
+		childJacobian += componants[i]->flatParamCount();
+	}
+	return impedance;
+}
+
+size_t Parallel::flatParamCount() const
+{
+	size_t count = 0;
+	for(Componant* componant : componants)
+		count += componant->flatParamCount();
+	return count;
+}
+
+std::complex<fvalue> Parallel::executeAdmittance(fvalue omega)
+{
+	// the children are combined in the admittance domain, so only this node needs a complex division
 	std::complex<fvalue> accum(0,0);
 	for(Componant* componant : componants)
 	{
-		accum += std::complex<fvalue>(1,0)/componant->execute(omega);
+		accum += componant->executeAdmittance(omega);
+	}
+	return accum;
+}
+
+void Parallel::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	scratch.resize(plan.size());
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(0, 0);
+	for(Componant* componant : componants)
+	{
+		componant->executeAdmittance(plan, scratch.data());
+		for(size_t i = 0; i < plan.size(); ++i)
+			out[i] += scratch[i];
 	}
-	return std::complex<fvalue>(1,0)/accum;
 }
 
 char Parallel::getComponantChar() const
@@ -104,6 +166,27 @@ std::string Parallel::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Parallel::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr admittance = getAdmittanceExpression(graph);
+	if(admittance == ExprGraph::INVALID)
+		return ExprGraph::INVALID;
+	return graph.div(graph.constant(1), admittance);
+}
+
+size_t Parallel::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr admittance = graph.constant(0);
+	for(Componant* componant : componants)
+	{
+		ExprGraph::Expr element = componant->getAdmittanceExpression(graph);
+		if(element == ExprGraph::INVALID)
+			return ExprGraph::INVALID;
+		admittance = graph.add(admittance, element);
+	}
+	return admittance;
+}
+
 std::string Parallel::getTorchScript(std::vector<std::string>& parameters)
 {
 	std::string out = "1/(";
@@ -162,6 +245,38 @@ std::complex<fvalue> Serial::execute(fvalue omega)
 	return accum;
 }
 
+void Serial::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	scratch.resize(plan.size());
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = std::complex<fvalue>(0, 0);
+	for(Componant* componant : componants)
+	{
+		componant->execute(plan, scratch.data());
+		for(size_t i = 0; i < plan.size(); ++i)
+			out[i] += scratch[i];
+	}
+}
+
+std::complex<fvalue> Serial::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	std::complex<fvalue> accum(0,0);
+	for(Componant* componant : componants)
+	{
+		accum += componant->executeJacobian(omega, jacobian);
+		jacobian += componant->flatParamCount();
+	}
+	return accum;
+}
+
+size_t Serial::flatParamCount() const
+{
+	size_t count = 0;
+	for(Componant* componant : componants)
+		count += componant->flatParamCount();
+	return count;
+}
+
 char Serial::getComponantChar() const
 {
 	return staticGetComponantChar();
@@ -203,6 +318,19 @@ std::string Serial::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Serial::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr impedance = graph.constant(0);
+	for(Componant* componant : componants)
+	{
+		ExprGraph::Expr element = componant->getExpression(graph);
+		if(element == ExprGraph::INVALID)
+			return ExprGraph::INVALID;
+		impedance = graph.add(impedance, element);
+	}
+	return impedance;
+}
+
 std::string Serial::getTorchScript(std::vector<std::string>& parameters)
 {
 	std::string out = "(";
@@ -19,11 +19,14 @@
 //
 
 #include "componant/resistor.h"
+#include "componant/formulas.h"
 #include <vector>
 #include <math.h>
 #include <cassert>
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -67,7 +70,38 @@ std::complex<fvalue> Resistor::execute(fvalue omega)
 {
 	(void)omega;
 	assert(ranges.size() == paramCount());
-	return std::complex<fvalue>(ranges[0].stepValue(), 0);
+	return formulas::resistorImpedance(parameter(0));
+}
+
+void Resistor::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	std::complex<fvalue> value = formulas::resistorImpedance(parameter(0));
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = value;
+}
+
+std::complex<fvalue> Resistor::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	(void)omega;
+	assert(ranges.size() == paramCount());
+	jacobian[0] = std::complex<fvalue>(1, 0);
+	return formulas::resistorImpedance(parameter(0));
+}
+
+std::complex<fvalue> Resistor::executeAdmittance(fvalue omega)
+{
+	(void)omega;
+	assert(ranges.size() == paramCount());
+	return formulas::resistorAdmittance(parameter(0));
+}
+
+void Resistor::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	std::complex<fvalue> value = formulas::resistorAdmittance(parameter(0));
+	for(size_t i = 0; i < plan.size(); ++i)
+		out[i] = value;
 }
 
 size_t Resistor::paramCount() const
@@ -87,6 +121,16 @@ std::string Resistor::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Resistor::getExpression(ExprGraph& graph)
+{
+	return graph.parameter(getUniqueName() + "_0");
+}
+
+size_t Resistor::getAdmittanceExpression(ExprGraph& graph)
+{
+	return graph.div(graph.constant(1), graph.parameter(getUniqueName() + "_0"));
+}
+
 std::string Resistor::getTorchScript(std::vector<std::string>& parameters)
 {
 	parameters.push_back(getUniqueName() + "_0");
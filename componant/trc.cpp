@@ -19,10 +19,13 @@
 //
 
 #include "componant/trc.h"
+#include "componant/formulas.h"
 #include <cstdlib>
 #include <math.h>
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -77,12 +80,44 @@ TransmissionLineClosed::TransmissionLineClosed(const TransmissionLineClosed& in)
 
 std::complex<fvalue> TransmissionLineClosed::execute(fvalue omega)
 {
-	fvalue r = ranges[0].stepValue();
-	fvalue q = ranges[1].stepValue();
-	fvalue a = ranges[2].stepValue();
-	fvalue l = ranges[3].stepValue();
+	return formulas::trcImpedance(omega, parameter(0), parameter(1), parameter(2), parameter(3));
+}
+
+void TransmissionLineClosed::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	fvalue r = parameter(0);
+	fvalue q = parameter(1);
+	fvalue a = parameter(2);
+	fvalue l = parameter(3);
+
+	// (j*omega)^a = omega^a*(cos(a*pi/2) + j*sin(a*pi/2))
+	std::complex<fvalue> phase(std::cos(a*M_PI/2), std::sin(a*M_PI/2));
+	for(size_t i = 0; i < plan.size(); ++i)
+	{
+		std::complex<fvalue> jOmegaPow = plan.powAt(a, i)*phase;
+		out[i] = std::sqrt(r/(q*jOmegaPow))*std::tanh(l*std::sqrt(jOmegaPow*r*q));
+	}
+}
 
-	return std::sqrt(r/(q*std::pow(std::complex<fvalue>(0, omega), a)))*std::tanh(l*std::sqrt(std::pow(std::complex<fvalue>(0, omega), a)*r*q));
+std::complex<fvalue> TransmissionLineClosed::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	fvalue r = parameter(0);
+	fvalue q = parameter(1);
+	fvalue a = parameter(2);
+	fvalue l = parameter(3);
+
+	// z = z0*tanh(l*k) with z0 = sqrt(r/(q*s)), k = sqrt(s*r*q) and s = (j*omega)^a
+	std::complex<fvalue> s = std::pow(std::complex<fvalue>(0, omega), a);
+	std::complex<fvalue> z0 = std::sqrt(r/(q*s));
+	std::complex<fvalue> k = std::sqrt(s*r*q);
+	std::complex<fvalue> t = std::tanh(l*k);
+	std::complex<fvalue> z = z0*t;
+	std::complex<fvalue> b = z0*(fvalue(1) - t*t)*l*k;
+	jacobian[0] = (z + b)/(2*r);
+	jacobian[1] = (b - z)/(2*q);
+	jacobian[2] = std::complex<fvalue>(std::log(omega), M_PI/2)*(b - z)/fvalue(2);
+	jacobian[3] = z0*(fvalue(1) - t*t)*k;
+	return z;
 }
 
 std::string TransmissionLineClosed::getCode(std::vector<std::string>& parameters)
@@ -101,6 +136,19 @@ std::string TransmissionLineClosed::getCode(std::vector<std::string>& parameters
 	return first+second;
 }
 
+size_t TransmissionLineClosed::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr r = graph.parameter(getUniqueName() + "_0");
+	ExprGraph::Expr q = graph.parameter(getUniqueName() + "_1");
+	ExprGraph::Expr a = graph.parameter(getUniqueName() + "_2");
+	ExprGraph::Expr l = graph.parameter(getUniqueName() + "_3");
+
+	ExprGraph::Expr jOmegaA = graph.pow(graph.complex(graph.constant(0), graph.omega()), a);
+	ExprGraph::Expr first = graph.sqrt(graph.div(r, graph.mul(q, jOmegaA)));
+	ExprGraph::Expr second = graph.tanh(graph.mul(l, graph.sqrt(graph.mul(jOmegaA, graph.mul(r, q)))));
+	return graph.mul(first, second);
+}
+
 std::string TransmissionLineClosed::getTorchScript(std::vector<std::string>& parameters)
 {
 	std::string hpi = std::to_string(M_PI/2);
@@ -19,11 +19,14 @@
 //
 
 #include "componant/warburg.h"
+#include "componant/formulas.h"
 #include <cstdlib>
 #include <cmath>
 #include <cassert>
 
 #include "log.h"
+#include "exprgraph.h"
+#include "frequencyplan.h"
 
 using namespace eis;
 
@@ -66,8 +69,45 @@ std::vector<eis::Range> Warburg::getDefaultParameters(bool range) const
 std::complex<fvalue> Warburg::execute(fvalue omega)
 {
 	assert(ranges.size() == paramCount());
-	fvalue N = ranges[0][ranges[0].step]/(std::sqrt(omega));
-	return std::complex<fvalue>(N, 0-N);
+	return formulas::warburgImpedance(omega, parameter(0));
+}
+
+void Warburg::execute(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	const std::vector<fvalue>& sqrtOmega = plan.getSqrtOmega();
+	fvalue a = parameter(0);
+	for(size_t i = 0; i < sqrtOmega.size(); ++i)
+	{
+		fvalue N = a/sqrtOmega[i];
+		out[i] = std::complex<fvalue>(N, 0-N);
+	}
+}
+
+std::complex<fvalue> Warburg::executeJacobian(fvalue omega, std::complex<fvalue>* jacobian)
+{
+	assert(ranges.size() == paramCount());
+	fvalue inverseSqrt = 1.0/std::sqrt(omega);
+	jacobian[0] = std::complex<fvalue>(inverseSqrt, 0-inverseSqrt);
+	return formulas::warburgImpedance(omega, parameter(0));
+}
+
+std::complex<fvalue> Warburg::executeAdmittance(fvalue omega)
+{
+	assert(ranges.size() == paramCount());
+	return formulas::warburgAdmittance(omega, parameter(0));
+}
+
+void Warburg::executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out)
+{
+	assert(ranges.size() == paramCount());
+	const std::vector<fvalue>& sqrtOmega = plan.getSqrtOmega();
+	fvalue scale = 1/(2*parameter(0));
+	for(size_t i = 0; i < sqrtOmega.size(); ++i)
+	{
+		fvalue M = scale*sqrtOmega[i];
+		out[i] = std::complex<fvalue>(M, M);
+	}
 }
 
 size_t Warburg::paramCount() const
@@ -88,6 +128,20 @@ std::string Warburg::getCode(std::vector<std::string>& parameters)
 	return out;
 }
 
+size_t Warburg::getExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr a = graph.parameter(getUniqueName() + "_0");
+	ExprGraph::Expr n = graph.div(a, graph.sqrt(graph.omega()));
+	return graph.complex(n, graph.neg(n));
+}
+
+size_t Warburg::getAdmittanceExpression(ExprGraph& graph)
+{
+	ExprGraph::Expr a = graph.parameter(getUniqueName() + "_0");
+	ExprGraph::Expr m = graph.div(graph.sqrt(graph.omega()), graph.mul(graph.constant(2), a));
+	return graph.complex(m, m);
+}
+
 std::string Warburg::getTorchScript(std::vector<std::string>& parameters)
 {
 	parameters.push_back(getUniqueName() + "_0");
@@ -0,0 +1,292 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "dataset.h"
+
+#include <cstring>
+#include <type_traits>
+
+#include "log.h"
+#include "mapping.h"
+
+using namespace eis;
+
+static_assert(std::is_same<fvalue, float>::value, "the dataset format requires fvalue to be float");
+
+static constexpr char DATASET_MAGIC[8] = {'E', 'I', 'S', 'S', 'W', 'E', 'E', 'P'};
+static constexpr uint32_t DATASET_VERSION = 1;
+static constexpr uint64_t SPECTRA_ALIGNMENT = 64;
+
+struct DatasetHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t stepCount;
+	uint64_t omegaCount;
+	uint64_t parameterCount;
+	uint64_t modelLength;
+	uint64_t namesLength;
+	uint64_t omegaOffset;
+	uint64_t namesOffset;
+	uint64_t spectraOffset;
+	uint64_t indexOffset;
+	uint64_t parameterOffset;
+};
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1)/alignment*alignment;
+}
+
+static void writePadding(std::ofstream& file, uint64_t alignment)
+{
+	uint64_t position = static_cast<uint64_t>(file.tellp());
+	uint64_t padding = alignOffset(position, alignment) - position;
+	for(uint64_t i = 0; i < padding; ++i)
+		file.put(0);
+}
+
+SweepDatasetWriter::SweepDatasetWriter(const std::filesystem::path& path, const std::string& model,
+                                       const std::vector<fvalue>& omega, const std::vector<std::string>& parameterNames):
+_path(path), _omegaCount(omega.size()), _parameterCount(parameterNames.size())
+{
+	_file.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!_file.is_open())
+		throw file_error("Unable to open " + path.string() + " for writing");
+
+	std::string names;
+	for(const std::string& name : parameterNames)
+	{
+		names.append(name);
+		names.push_back('\0');
+	}
+
+	DatasetHeader header = {};
+	std::memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+	header.version = DATASET_VERSION;
+	header.headerSize = sizeof(DatasetHeader);
+	header.omegaCount = _omegaCount;
+	header.parameterCount = _parameterCount;
+	header.modelLength = model.size();
+	header.namesLength = names.size();
+	header.omegaOffset = alignOffset(sizeof(DatasetHeader) + model.size(), sizeof(float));
+	header.namesOffset = header.omegaOffset + omega.size()*sizeof(float);
+	header.spectraOffset = alignOffset(header.namesOffset + names.size(), SPECTRA_ALIGNMENT);
+
+	_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	_file.write(model.data(), model.size());
+	writePadding(_file, sizeof(float));
+	_file.write(reinterpret_cast<const char*>(omega.data()), omega.size()*sizeof(float));
+	_file.write(names.data(), names.size());
+	writePadding(_file, SPECTRA_ALIGNMENT);
+
+	if(!_file.good())
+		throw file_error("Unable to write header to " + path.string());
+}
+
+SweepDatasetWriter::~SweepDatasetWriter()
+{
+	abort();
+}
+
+void SweepDatasetWriter::append(const std::vector<eis::DataPoint>& data, const std::vector<fvalue>& parameters, size_t index)
+{
+	if(data.size() != _omegaCount || parameters.size() != _parameterCount)
+	{
+		throw file_error("Spectrum of size " + std::to_string(data.size()) + " with " + std::to_string(parameters.size()) +
+			" parameters dosent fit " + _path.string());
+	}
+
+	_buffer.resize(_omegaCount*2);
+	for(size_t i = 0; i < data.size(); ++i)
+	{
+		_buffer[i*2] = data[i].im.real();
+		_buffer[i*2+1] = data[i].im.imag();
+	}
+	append(reinterpret_cast<const std::complex<fvalue>*>(_buffer.data()), parameters.data(), index);
+}
+
+void SweepDatasetWriter::append(const std::complex<fvalue>* spectrum, const fvalue* parameters, size_t index)
+{
+	if(!_file.is_open())
+		throw file_error("Can not append to finished dataset " + _path.string());
+
+	_file.write(reinterpret_cast<const char*>(spectrum), _omegaCount*sizeof(std::complex<fvalue>));
+	_indices.push_back(index);
+	_parameters.insert(_parameters.end(), parameters, parameters+_parameterCount);
+	++_stepCount;
+}
+
+void SweepDatasetWriter::finish()
+{
+	if(!_file.is_open())
+		return;
+
+	writePadding(_file, sizeof(uint64_t));
+	uint64_t indexOffset = _file.tellp();
+	_file.write(reinterpret_cast<const char*>(_indices.data()), _indices.size()*sizeof(uint64_t));
+	uint64_t parameterOffset = _file.tellp();
+	_file.write(reinterpret_cast<const char*>(_parameters.data()), _parameters.size()*sizeof(float));
+
+	_file.seekp(offsetof(DatasetHeader, stepCount));
+	uint64_t stepCount = _stepCount;
+	_file.write(reinterpret_cast<const char*>(&stepCount), sizeof(stepCount));
+	_file.seekp(offsetof(DatasetHeader, indexOffset));
+	_file.write(reinterpret_cast<const char*>(&indexOffset), sizeof(indexOffset));
+	_file.write(reinterpret_cast<const char*>(&parameterOffset), sizeof(parameterOffset));
+
+	bool good = _file.good();
+	_file.close();
+	_indices = std::vector<uint64_t>();
+	_parameters = std::vector<float>();
+
+	if(!good)
+		throw file_error("Unable to finish writeing " + _path.string());
+}
+
+void SweepDatasetWriter::abort()
+{
+	if(!_file.is_open())
+		return;
+
+	_file.close();
+	_indices = std::vector<uint64_t>();
+	_parameters = std::vector<float>();
+
+	std::error_code ec;
+	std::filesystem::remove(_path, ec);
+}
+
+size_t SweepDatasetWriter::size() const
+{
+	return _stepCount;
+}
+
+SweepDataset::SweepDataset(const std::filesystem::path& path)
+{
+	if(!mapFile(path, &_data, &_size, &_mapping))
+		throw file_error("Unable to map " + path.string());
+
+	const DatasetHeader* header = reinterpret_cast<const DatasetHeader*>(_data);
+	if(_size < sizeof(DatasetHeader) || std::memcmp(header->magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0)
+	{
+		unmap();
+		throw file_error(path.string() + " is not a eisgenerator dataset");
+	}
+
+	// the row sizes are bounded by the file size first so that computing them can not overflow
+	if(header->version != DATASET_VERSION || header->indexOffset == 0 ||
+		header->headerSize < sizeof(DatasetHeader) ||
+		header->omegaCount > _size || header->parameterCount > _size ||
+		header->omegaOffset % alignof(float) != 0 || header->spectraOffset % alignof(float) != 0 ||
+		header->indexOffset % alignof(uint64_t) != 0 || header->parameterOffset % alignof(float) != 0 ||
+		!regionInMapping(header->headerSize, header->modelLength, 1, _size) ||
+		!regionInMapping(header->omegaOffset, header->omegaCount, sizeof(float), _size) ||
+		!regionInMapping(header->namesOffset, header->namesLength, 1, _size) ||
+		!regionInMapping(header->spectraOffset, header->stepCount, header->omegaCount*2*sizeof(float), header->indexOffset) ||
+		!regionInMapping(header->indexOffset, header->stepCount, sizeof(uint64_t), header->parameterOffset) ||
+		!regionInMapping(header->parameterOffset, header->stepCount, header->parameterCount*sizeof(float), _size))
+	{
+		unmap();
+		throw file_error(path.string() + " is an incompleat or unsupported dataset");
+	}
+
+	_stepCount = header->stepCount;
+	_omegaCount = header->omegaCount;
+	_parameterCount = header->parameterCount;
+	_model.assign(reinterpret_cast<const char*>(_data + header->headerSize), header->modelLength);
+	_omega = reinterpret_cast<const float*>(_data + header->omegaOffset);
+	_spectra = reinterpret_cast<const float*>(_data + header->spectraOffset);
+	_indices = reinterpret_cast<const uint64_t*>(_data + header->indexOffset);
+	_parameters = reinterpret_cast<const float*>(_data + header->parameterOffset);
+
+	_parameterNames = splitStrings(reinterpret_cast<const char*>(_data + header->namesOffset), header->namesLength);
+}
+
+SweepDataset::~SweepDataset()
+{
+	unmap();
+}
+
+void SweepDataset::unmap()
+{
+	unmapFile(_data, _size, _mapping);
+	_mapping = nullptr;
+	_data = nullptr;
+}
+
+size_t SweepDataset::size() const
+{
+	return _stepCount;
+}
+
+size_t SweepDataset::getOmegaCount() const
+{
+	return _omegaCount;
+}
+
+size_t SweepDataset::getParameterCount() const
+{
+	return _parameterCount;
+}
+
+const std::string& SweepDataset::getModelStr() const
+{
+	return _model;
+}
+
+const std::vector<std::string>& SweepDataset::getParameterNames() const
+{
+	return _parameterNames;
+}
+
+const fvalue* SweepDataset::getOmega() const
+{
+	return _omega;
+}
+
+const std::complex<fvalue>* SweepDataset::getSpectrum(size_t step) const
+{
+	return reinterpret_cast<const std::complex<fvalue>*>(_spectra + step*_omegaCount*2);
+}
+
+const fvalue* SweepDataset::getParameters(size_t step) const
+{
+	return _parameters + step*_parameterCount;
+}
+
+size_t SweepDataset::getIndex(size_t step) const
+{
+	return _indices[step];
+}
+
+std::vector<eis::DataPoint> SweepDataset::getDataPoints(size_t step) const
+{
+	const std::complex<fvalue>* spectrum = getSpectrum(step);
+	std::vector<eis::DataPoint> out(_omegaCount);
+	for(size_t i = 0; i < _omegaCount; ++i)
+	{
+		out[i].omega = _omega[i];
+		out[i].im = spectrum[i];
+	}
+	return out;
+}
@@ -19,6 +19,7 @@
  */
 
 #pragma once
+#include <cstdint>
 #include <vector>
 #include <kisstype/type.h>
 
@@ -147,6 +148,20 @@ namespace eis
 	*/
 	void noise(std::vector<eis::DataPoint>& data, double amplitude, bool relative);
 
+	/**
+	* @brief Adds reproducible white noise to the data.
+	*
+	* The noise is a pure function of seed and stream, thus giving every spectrum in a sweep its own stream,
+	* for instance its sweep index, makes the result independent of the order and the thread in which the spectra are processed.
+	*
+	* @param data The data to add noise to.
+	* @param amplitude The amplitude of the noise.
+	* @param relative If true, the amplitude will be taken as relative to the magnitude of the data, otherwise it will be taken as an absolute value.
+	* @param seed The seed of the noise.
+	* @param stream The stream id within the seed.
+	*/
+	void noise(std::vector<eis::DataPoint>& data, double amplitude, bool relative, uint64_t seed, uint64_t stream = 0);
+
 	/**
 	* @brief Removes duplicate data points from the data.
 	*
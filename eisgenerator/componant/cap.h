@@ -33,11 +33,17 @@ public:
 	Cap(std::string paramStr, size_t count = 10, bool defaultToRange = false);
 	Cap(fvalue c = 1e-6);
 	virtual std::complex<fvalue> execute(fvalue omega) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual std::complex<fvalue> executeAdmittance(fvalue omega) override;
+	virtual void executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
 	virtual size_t paramCount() const override;
 	virtual char getComponantChar() const override;
 	static constexpr char staticGetComponantChar(){return 'c';}
 	virtual std::string componantName() const override {return "Capacitor";}
 	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
+	virtual size_t getAdmittanceExpression(ExprGraph& graph) override;
 	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
 	virtual std::vector<eis::Range> getDefaultParameters(bool range = true) const override;
 	virtual ~Cap() = default;
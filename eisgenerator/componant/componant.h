@@ -28,11 +28,25 @@
 namespace eis
 {
 
+class ExprGraph;
+class FrequencyPlan;
+
 class Componant
 {
 	protected:
 		std::vector<eis::Range> ranges;
 		std::string uniqueName;
+		std::vector<fvalue> resolvedValues;
+		bool resolved = false;
+
+		/**
+		* Gets the value of a parameter at the current step of its range, this is the value
+		* set by setResolvedParameters if the ranges have not been accessed mutably since.
+		*/
+		fvalue parameter(size_t index) const
+		{
+			return resolved ? resolvedValues[index] : ranges[index].stepValue();
+		}
 
 	public:
 		virtual std::complex<fvalue> execute(fvalue omega)
@@ -42,16 +56,59 @@ class Componant
 			return std::complex<fvalue> (1,0);
 		}
 
+		/**
+		* Computes the impedance at every frequency of the plan into out, which must point to plan.size() values.
+		* The default implementation calls execute(fvalue) for every frequency.
+		*/
+		virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out);
+
+		/**
+		* Computes the admittance at omega. Elements whose admittance is more natural than their impedance,
+		* like capacitors, override this so that Parallel can sum admittances without complex divisions.
+		* The default implementation returns 1/execute(omega).
+		*/
+		virtual std::complex<fvalue> executeAdmittance(fvalue omega);
+		virtual void executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out);
+
+		/**
+		* Computes the impedance at omega and writes its derivatives with respect to the parameters of this componant and all
+		* of its children, in the order of Model::getFlatParameters, to jacobian, which must point to flatParamCount() values.
+		* The default implementation uses central finite differences of execute(fvalue) on the parameters of this componant.
+		*/
+		virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian);
+
 		virtual void setParamRanges(const std::vector<eis::Range>& ranges);
+
+		/**
+		* Gets the parameter ranges for modification, this discards the values set by setResolvedParameters.
+		*/
 		virtual std::vector<eis::Range>& getParamRanges();
 		virtual std::vector<eis::Range> getParamRanges() const;
 		virtual std::vector<eis::Range> getDefaultParameters(bool range = true) const;
+
+		/**
+		* Sets the values of the parameters at the current steps of the ranges, so that execution
+		* does not have to compute them from the ranges on every call.
+		*/
+		virtual void setResolvedParameters(const std::vector<fvalue>& values);
+
+		/**
+		* Gets the values of all parameters at the current steps of their ranges.
+		*/
+		std::vector<fvalue> getParameterValues() const;
 		virtual size_t paramCount() const {return 0;};
+
+		/**
+		* Gets the number of parameters of this componant and all of its children.
+		*/
+		virtual size_t flatParamCount() const {return paramCount();}
 		virtual ~Componant() = default;
 		virtual char getComponantChar() const = 0;
 		virtual std::string getComponantString(bool currentValue = true) const;
 		virtual std::string componantName() const = 0;
 		virtual std::string getCode(std::vector<std::string>& parameters);
+		virtual size_t getExpression(ExprGraph& graph);
+		virtual size_t getAdmittanceExpression(ExprGraph& graph);
 		virtual std::string getTorchScript(std::vector<std::string>& parameters);
 		virtual bool compileable();
 
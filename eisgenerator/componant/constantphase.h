@@ -36,6 +36,10 @@ public:
 	Cpe(fvalue q, fvalue alpha);
 	Cpe();
 	virtual std::complex<fvalue> execute(fvalue omega) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual std::complex<fvalue> executeAdmittance(fvalue omega) override;
+	virtual void executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
 	virtual size_t paramCount() const override;
 	virtual char getComponantChar() const override;
 	static constexpr char staticGetComponantChar(){return 'p';}
@@ -43,6 +47,8 @@ public:
 	virtual ~Cpe() = default;
 	virtual std::vector<eis::Range> getDefaultParameters(bool range = true) const override;
 	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
+	virtual size_t getAdmittanceExpression(ExprGraph& graph) override;
 	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
 };
 
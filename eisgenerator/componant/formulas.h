@@ -0,0 +1,102 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+#include <complex>
+#include <cmath>
+#include <numbers>
+#include <kisstype/type.h>
+
+/*
+* The impedance and admittance formulas of the circuit elements, shared by the Componant classes
+* and the compile time models of typed.h so that both always compute the same values.
+*/
+
+namespace eis::formulas
+{
+
+inline std::complex<fvalue> resistorImpedance(fvalue r)
+{
+	return std::complex<fvalue>(r, 0);
+}
+
+inline std::complex<fvalue> resistorAdmittance(fvalue r)
+{
+	return std::complex<fvalue>(1/r, 0);
+}
+
+inline std::complex<fvalue> capImpedance(fvalue omega, fvalue c)
+{
+	return std::complex<fvalue>(0, 0.0-(1.0/(c*omega)));
+}
+
+inline std::complex<fvalue> capAdmittance(fvalue omega, fvalue c)
+{
+	return std::complex<fvalue>(0, c*omega);
+}
+
+inline std::complex<fvalue> inductorImpedance(fvalue omega, fvalue l)
+{
+	return std::complex<fvalue>(0, l*omega);
+}
+
+inline std::complex<fvalue> inductorAdmittance(fvalue omega, fvalue l)
+{
+	return std::complex<fvalue>(0, 0-1/(l*omega));
+}
+
+inline std::complex<fvalue> cpeImpedance(fvalue omega, fvalue q, fvalue alpha)
+{
+	fvalue inverse = 1.0/(q*std::pow(omega, alpha));
+	fvalue real = inverse*std::cos((std::numbers::pi/2)*alpha);
+	fvalue imag = 0-inverse*std::sin((std::numbers::pi/2)*alpha);
+	return std::complex<fvalue>(real, imag);
+}
+
+inline std::complex<fvalue> cpeAdmittance(fvalue omega, fvalue q, fvalue alpha)
+{
+	fvalue magnitude = q*std::pow(omega, alpha);
+	return std::complex<fvalue>(magnitude*std::cos((std::numbers::pi/2)*alpha), magnitude*std::sin((std::numbers::pi/2)*alpha));
+}
+
+inline std::complex<fvalue> warburgImpedance(fvalue omega, fvalue a)
+{
+	fvalue N = a/(std::sqrt(omega));
+	return std::complex<fvalue>(N, 0-N);
+}
+
+inline std::complex<fvalue> warburgAdmittance(fvalue omega, fvalue a)
+{
+	// 1/(N*(1-j)) = (1+j)/(2*N)
+	fvalue M = std::sqrt(omega)/(2*a);
+	return std::complex<fvalue>(M, M);
+}
+
+inline std::complex<fvalue> trcImpedance(fvalue omega, fvalue r, fvalue q, fvalue a, fvalue l)
+{
+	return std::sqrt(r/(q*std::pow(std::complex<fvalue>(0, omega), a)))*std::tanh(l*std::sqrt(std::pow(std::complex<fvalue>(0, omega), a)*r*q));
+}
+
+inline std::complex<fvalue> troImpedance(fvalue omega, fvalue r, fvalue q, fvalue a, fvalue l)
+{
+	return std::sqrt(r/(q*std::pow(std::complex<fvalue>(0, omega), a)))*std::pow(std::tanh(l*std::sqrt(std::pow(std::complex<fvalue>(0, omega), a)*r*q)), -1);
+}
+
+}
@@ -0,0 +1,66 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+#include <complex>
+#include <string>
+#include <vector>
+#include "componant.h"
+
+namespace eis
+{
+
+class Ladder: public Componant
+{
+private:
+	// holds the admittance of every frequency of a FrequencyPlan as separate real and imaginary parts
+	std::vector<double> scratch;
+
+	static double getLargestStage(double logRatio, size_t stages);
+	static double getStageFraction(double g, double logRatio, double largest, size_t stages, size_t stage);
+	static void admittance(const fvalue* omega, size_t count, fvalue r, fvalue c, fvalue g, size_t stages, double* re, double* im);
+	size_t getStages() const;
+	fvalue getGrading() const;
+	void checkGrading() const;
+
+public:
+	Ladder(std::string paramStr, size_t count = 10, bool defaultToRange = false);
+	Ladder(fvalue r, fvalue c, fvalue n, fvalue g = 1);
+	virtual std::complex<fvalue> execute(fvalue omega) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+
+	/**
+	* The derivatives with respect to r, c and g are propagated through the continued fraction in forward mode,
+	* the derivative with respect to the integer number of stages is 0. The ladder has no ExprGraph expression,
+	* thus models containing it are not covered by the compiled jacobian kernel and use this instead.
+	*/
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual size_t paramCount() const override;
+	virtual char getComponantChar() const override;
+	static constexpr char staticGetComponantChar(){return 'k';}
+	virtual std::string componantName() const override {return "Ladder";}
+	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual std::vector<eis::Range> getDefaultParameters(bool range = true) const override;
+	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
+	virtual ~Ladder() = default;
+};
+
+}
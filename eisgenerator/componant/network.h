@@ -0,0 +1,80 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+#include <array>
+#include <complex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "componant.h"
+
+namespace eis
+{
+
+class Network: public Componant
+{
+private:
+	struct Elimination
+	{
+		size_t node;
+		size_t pivot;
+		std::vector<std::pair<size_t, size_t>> neighbours;
+		std::vector<std::array<size_t, 3>> updates;
+	};
+
+	std::vector<std::array<size_t, 3>> _stamps;
+	std::vector<Elimination> _eliminations;
+	size_t _slots = 0;
+	size_t _terminalSlot = 0;
+
+	void analyse();
+
+public:
+	static constexpr size_t REFERENCE_NODE = 0;
+	static constexpr size_t TERMINAL_NODE = 1;
+
+	std::vector<Componant*> componants;
+	std::vector<std::pair<size_t, size_t>> terminals;
+
+	Network(std::vector<Componant*> componantsIn, std::vector<std::pair<size_t, size_t>> terminalsIn);
+	Network(const Network& in);
+	void operator=(const Network& in);
+	~Network();
+	virtual std::complex<fvalue> execute(fvalue omega) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual size_t flatParamCount() const override;
+	virtual std::complex<fvalue> executeAdmittance(fvalue omega) override;
+	virtual void executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual char getComponantChar() const override;
+	virtual std::string getComponantString(bool currentValue = true) const override;
+	static constexpr char staticGetComponantChar(){return 'n';}
+	virtual std::string componantName() const override {return "Network";}
+	virtual bool compileable() override;
+	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
+	virtual size_t getAdmittanceExpression(ExprGraph& graph) override;
+	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
+	size_t getNodeCount() const;
+};
+
+}
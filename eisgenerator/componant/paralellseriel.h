@@ -28,6 +28,10 @@ namespace eis
 
 class ParallelSerial: public Componant
 {
+protected:
+	// holds the result of one child while executeing on a FrequencyPlan, kept to avoid an allocation per call
+	std::vector<std::complex<fvalue>> scratch;
+
 public:
 	virtual std::vector<fvalue> contributionRatio(fvalue omega) = 0;
 	std::vector<bool> contributes(fvalue omega, fvalue threshold = 0.01);
@@ -43,12 +47,19 @@ public:
 	void operator=(const Parallel& in);
 	~Parallel();
 	virtual std::complex<fvalue> execute(fvalue omaga) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual size_t flatParamCount() const override;
+	virtual std::complex<fvalue> executeAdmittance(fvalue omega) override;
+	virtual void executeAdmittance(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
 	virtual char getComponantChar() const override;
 	virtual std::string getComponantString(bool currentValue = true) const override;
 	static constexpr char staticGetComponantChar(){return 'd';}
 	virtual std::string componantName() const override {return "Parallel";}
 	virtual bool compileable() override;
 	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
+	virtual size_t getAdmittanceExpression(ExprGraph& graph) override;
 	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
 	virtual std::vector<fvalue> contributionRatio(fvalue omega) override;
 };
@@ -63,12 +74,16 @@ public:
 	void operator=(const Serial& in);
 	~Serial();
 	virtual std::complex<fvalue> execute(fvalue omaga) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
+	virtual size_t flatParamCount() const override;
 	virtual char getComponantChar() const override;
 	virtual std::string getComponantString(bool currentValue = true) const override;
 	static constexpr char staticGetComponantChar(){return 's';}
 	virtual std::string componantName() const override {return "Serial";}
 	virtual bool compileable() override;
 	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
 	virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
 	virtual std::vector<fvalue> contributionRatio(fvalue omega) override;
 };
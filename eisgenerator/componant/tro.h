@@ -32,11 +32,14 @@ public:
 	TransmissionLineOpen(std::string paramStr, size_t count = 10, bool defaultToRange = false);
 	TransmissionLineOpen(const TransmissionLineOpen& in);
 	virtual std::complex<fvalue> execute(fvalue omega) override;
+	virtual void execute(const FrequencyPlan& plan, std::complex<fvalue>* out) override;
+	virtual std::complex<fvalue> executeJacobian(fvalue omega, std::complex<fvalue>* jacobian) override;
 	virtual size_t paramCount() const override;
 	virtual std::vector<eis::Range> getDefaultParameters(bool range = true) const override;
 	virtual ~TransmissionLineOpen();
 	virtual char getComponantChar() const override;
 	virtual std::string getCode(std::vector<std::string>& parameters) override;
+	virtual size_t getExpression(ExprGraph& graph) override;
 	//virtual std::string getTorchScript(std::vector<std::string>& parameters) override;
 	virtual std::string componantName() const override {return "TransmissionLineOpen";}
 	static constexpr char staticGetComponantChar(){return 'o';}
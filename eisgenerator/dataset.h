@@ -0,0 +1,260 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared library and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <kisstype/type.h>
+
+namespace eis
+{
+
+/**
+* Binary storage of parameter sweeps
+* @defgroup DATASET Datasets
+* @{
+*/
+
+/**
+* @brief Interface of the writers that save the spectra of a parameter sweep.
+*/
+class SweepWriter
+{
+public:
+	virtual ~SweepWriter() = default;
+
+	/**
+	* @brief Appends a spectrum.
+	*
+	* @throws file_error If data or parameters dont match the sizes given in the constructor of the writer.
+	* @param data The spectrum to append, must be sampled at the frequencies passed to the constructor of the writer.
+	* @param parameters The values of the parameters of the model for this spectrum.
+	* @param index The parameter sweep index of this spectrum.
+	*/
+	virtual void append(const std::vector<eis::DataPoint>& data, const std::vector<fvalue>& parameters, size_t index) = 0;
+
+	/**
+	* @brief Completes the output, after this call no further spectra can be appended.
+	*/
+	virtual void finish() = 0;
+
+	/**
+	* @brief Discards the output, ie. after an error, so that no incomplete output is left behind that appears valid.
+	*
+	* After this call no further spectra can be appended, calling this after finish does nothing.
+	*/
+	virtual void abort() = 0;
+
+	/**
+	* @brief Gets the number of spectra appended so far.
+	*
+	* @return The number of spectra appended so far.
+	*/
+	virtual size_t size() const = 0;
+};
+
+/**
+* @brief Writes the spectra of a parameter sweep into a single memory-mappable binary file.
+*
+* The file consists of a header containing the model string, the omega grid and the parameter names,
+* followed by a fixed-stride float32 block of [step x omega x 2] (real, imaginary) values,
+* a table of the sweep indices of the steps and a float32 table of [step x parameter] values.
+*
+* Spectra are appended to the file as they are passed to append, the sweep indices and the parameter table are
+* buffered and written to the end of the file by finish.
+*/
+class SweepDatasetWriter: public SweepWriter
+{
+private:
+	std::ofstream _file;
+	std::filesystem::path _path;
+	size_t _omegaCount;
+	size_t _parameterCount;
+	size_t _stepCount = 0;
+	std::vector<uint64_t> _indices;
+	std::vector<float> _parameters;
+	std::vector<float> _buffer;
+
+public:
+	/**
+	* @brief Constructor, creates the file and writes the header.
+	*
+	* @throws file_error If the file can not be created.
+	* @param path The path to the file to create.
+	* @param model The model string of the sweep.
+	* @param omega The frequencies in rad/s at which every spectra in the sweep is sampled.
+	* @param parameterNames The names of the parameters of the model in the order used by Model::getFlatParameters.
+	*/
+	SweepDatasetWriter(const std::filesystem::path& path, const std::string& model,
+	                   const std::vector<fvalue>& omega, const std::vector<std::string>& parameterNames);
+	SweepDatasetWriter(const SweepDatasetWriter&) = delete;
+	SweepDatasetWriter& operator=(const SweepDatasetWriter&) = delete;
+
+	/**
+	* @brief Destructor, calls abort if finish was not called.
+	*/
+	virtual ~SweepDatasetWriter();
+
+	virtual void append(const std::vector<eis::DataPoint>& data, const std::vector<fvalue>& parameters, size_t index) override;
+
+	/**
+	* @brief Appends a spectrum to the file.
+	*
+	* @param spectrum Pointer to omega count impedance values.
+	* @param parameters Pointer to parameter count values.
+	* @param index The parameter sweep index of this spectrum.
+	*/
+	void append(const std::complex<fvalue>* spectrum, const fvalue* parameters, size_t index);
+
+	/**
+	* @brief Writes the index and parameter tables and completes the header.
+	*
+	* After this call no further spectra can be appended.
+	*/
+	virtual void finish() override;
+
+	/**
+	* @brief Closes and removes the file.
+	*/
+	virtual void abort() override;
+
+	virtual size_t size() const override;
+};
+
+/**
+* @brief Read only view of a file created by SweepDatasetWriter.
+*
+* The file is memory mapped, the pointers returned by the accessors of this class point directly into the mapping
+* and thus remain valid only for the lifetime of this object.
+*/
+class SweepDataset
+{
+private:
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+	void* _mapping = nullptr;
+	std::string _model;
+	std::vector<std::string> _parameterNames;
+	size_t _stepCount;
+	size_t _omegaCount;
+	size_t _parameterCount;
+	const float* _omega;
+	const float* _spectra;
+	const uint64_t* _indices;
+	const float* _parameters;
+
+	void unmap();
+
+public:
+	/**
+	* @brief Constructor, maps the given file.
+	*
+	* @throws file_error If the file can not be opened or is not a valid dataset file.
+	* @param path The path of the file to map.
+	*/
+	SweepDataset(const std::filesystem::path& path);
+	SweepDataset(const SweepDataset&) = delete;
+	SweepDataset& operator=(const SweepDataset&) = delete;
+	~SweepDataset();
+
+	/**
+	* @brief Gets the number of spectra in the dataset.
+	*
+	* @return The number of spectra in the dataset.
+	*/
+	size_t size() const;
+
+	/**
+	* @brief Gets the number of frequencies each spectrum is sampled at.
+	*
+	* @return The number of frequencies each spectrum is sampled at.
+	*/
+	size_t getOmegaCount() const;
+
+	/**
+	* @brief Gets the number of parameters stored for each spectrum.
+	*
+	* @return The number of parameters stored for each spectrum.
+	*/
+	size_t getParameterCount() const;
+
+	/**
+	* @brief Gets the model string of the sweep.
+	*
+	* @return The model string of the sweep.
+	*/
+	const std::string& getModelStr() const;
+
+	/**
+	* @brief Gets the names of the parameters.
+	*
+	* @return The names of the parameters.
+	*/
+	const std::vector<std::string>& getParameterNames() const;
+
+	/**
+	* @brief Gets the frequencies the spectra are sampled at.
+	*
+	* @return Pointer to getOmegaCount() frequencies in rad/s.
+	*/
+	const fvalue* getOmega() const;
+
+	/**
+	* @brief Gets a spectrum.
+	*
+	* @param step The position of the spectrum in the file.
+	* @return Pointer to getOmegaCount() impedance values.
+	*/
+	const std::complex<fvalue>* getSpectrum(size_t step) const;
+
+	/**
+	* @brief Gets the parameters of a spectrum.
+	*
+	* @param step The position of the spectrum in the file.
+	* @return Pointer to getParameterCount() parameter values.
+	*/
+	const fvalue* getParameters(size_t step) const;
+
+	/**
+	* @brief Gets the parameter sweep index of a spectrum.
+	*
+	* @param step The position of the spectrum in the file.
+	* @return The parameter sweep index the spectrum was generated at.
+	*/
+	size_t getIndex(size_t step) const;
+
+	/**
+	* @brief Copies a spectrum into a vector of DataPoints.
+	*
+	* @param step The position of the spectrum in the file.
+	* @return The spectrum.
+	*/
+	std::vector<eis::DataPoint> getDataPoints(size_t step) const;
+};
+
+/** @} */
+
+}
@@ -0,0 +1,98 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared library and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+#include <kisstype/type.h>
+
+#include "model.h"
+
+namespace eis
+{
+
+/**
+* Fitting of models to measured spectra
+* @defgroup FIT Fitting
+* @{
+*/
+
+/**
+* @brief Options of the Levenberg-Marquardt fitter.
+*/
+struct FitOptions
+{
+	size_t maxIterations = 200; ///< The maximum number of iterations per spectrum.
+	double tolerance = 1e-6; ///< The fit stops early once an accepted step reduces the cost by less than this fraction.
+	double initialLambda = 1e-3; ///< The initial damping factor.
+	bool logTransform = true; ///< Fit parameters that are bounded below by zero in log space.
+	bool modulusWeighting = true; ///< Weight the residual of every point by the inverse of the modulus of the measured impedance.
+	bool fixUnswept = false; ///< Hold parameters whose range has only a single value constant.
+	bool parallel = true; ///< Fit the spectra on all cores.
+	std::vector<fvalue> initialParameters; ///< If not empty, the fit starts from these parameters, ie. those of a SpectraIndex match, instead of the centers of the ranges.
+};
+
+/**
+* @brief The result of fitting a model to one spectrum.
+*/
+struct FitResult
+{
+	std::vector<fvalue> parameters; ///< The fitted parameters in the order used by Model::getFlatParameters.
+	std::vector<std::complex<fvalue>> residuals; ///< The difference between the fitted model and the measured impedance at every point.
+	std::vector<fvalue> covariance; ///< The parameters x parameters covariance matrix of the fitted parameters in row major order.
+	double cost = 0; ///< The weighted sum of squared residuals.
+	size_t iterations = 0; ///< The number of iterations taken.
+	bool converged = false; ///< True if the fit stopped before reaching FitOptions::maxIterations.
+};
+
+/**
+* @brief Fits the parameters of a model to a measured spectrum by the Levenberg-Marquardt algorithm.
+*
+* The bounds and the starting point of every parameter are derived from its range: parameters with a range are bounded
+* by its start and end and start from its center, which is the geometric center for logarithmic ranges. Parameters with a
+* single value start from this value and are only bounded to remain positive if it is positive.
+* The derivatives are computed by Model::executeJacobian, thus a model compiled by Model::compile(false, true) is fitted
+* with the compiled jacobian kernel.
+*
+* @param model The model to fit, its parameter sweep is left unchanged.
+* @param spectrum The measured spectrum.
+* @param options The options of the fit.
+* @return The fitted parameters, the residuals and the covariance.
+*/
+FitResult fit(Model& model, const std::vector<DataPoint>& spectrum, const FitOptions& options = FitOptions());
+
+/**
+* @brief Fits the parameters of a model to many measured spectra independently.
+*
+* If FitOptions::parallel is set every thread fits a share of the spectra with its own copy of the model.
+*
+* @param model The model to fit, its parameter sweep is left unchanged.
+* @param spectra The measured spectra, these may be sampled at different frequencies.
+* @param options The options of the fits.
+* @return The results of the fits in the order of spectra.
+*/
+std::vector<FitResult> fit(Model& model, const std::vector<std::vector<DataPoint>>& spectra, const FitOptions& options = FitOptions());
+
+/** @} */
+
+}
@@ -0,0 +1,136 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include <kisstype/type.h>
+
+namespace eis
+{
+
+/**
+* @addtogroup MODELING
+* @{
+*/
+
+/**
+* @brief Tables of the quantities that circuit elements derive from omega alone.
+*
+* A FrequencyPlan is built once per omega grid and can then be shared by any number of
+* Model objects and threads, as it is immutable after construction.
+* This allows the execute family of methods to replace transcendental functions of omega, that would otherwise be
+* recomputed for every spectrum of a sweep, with table lookups.
+*/
+class FrequencyPlan
+{
+private:
+	std::vector<fvalue> _omega;
+	std::vector<fvalue> _inverseOmega;
+	std::vector<fvalue> _sqrtOmega;
+	std::vector<fvalue> _logOmega;
+
+public:
+	/**
+	* @brief Constructor, computes the tables for the given frequencies.
+	*
+	* @param omega The frequencies in rad/s.
+	*/
+	explicit FrequencyPlan(const std::vector<fvalue>& omega);
+
+	/**
+	* @brief Constructor, computes the tables for the frequencies of the given range.
+	*
+	* @param omega The range of frequencies in rad/s.
+	*/
+	explicit FrequencyPlan(const Range& omega);
+
+	/**
+	* @brief Gets the number of frequencies in the plan.
+	*
+	* @return The number of frequencies in the plan.
+	*/
+	size_t size() const;
+
+	/**
+	* @brief Gets the frequencies of the plan.
+	*
+	* @return The frequencies in rad/s.
+	*/
+	const std::vector<fvalue>& getOmega() const;
+
+	/**
+	* @brief Gets 1/omega for every frequency in the plan.
+	*
+	* @return 1/omega for every frequency in the plan.
+	*/
+	const std::vector<fvalue>& getInverseOmega() const;
+
+	/**
+	* @brief Gets the square root of omega for every frequency in the plan.
+	*
+	* @return The square root of omega for every frequency in the plan.
+	*/
+	const std::vector<fvalue>& getSqrtOmega() const;
+
+	/**
+	* @brief Gets the natural logarithm of omega for every frequency in the plan.
+	*
+	* @return The natural logarithm of omega for every frequency in the plan.
+	*/
+	const std::vector<fvalue>& getLogOmega() const;
+
+	/**
+	* @brief Computes omega to the power of the given exponent for every frequency in the plan.
+	*
+	* This is computed from the logarithm table and thus requires only one exponential per frequency.
+	*
+	* @param exponent The exponent to raise omega to.
+	* @param out Pointer to size() values that receive the result.
+	*/
+	void pow(fvalue exponent, fvalue* out) const;
+
+	/**
+	* @brief Computes omega to the power of the given exponent for one frequency of the plan.
+	*
+	* Unlike pow() this requires no buffer and is thus suited for use inside of a loop over the plan.
+	*
+	* @param exponent The exponent to raise omega to.
+	* @param index The index of the frequency in the plan.
+	* @return The frequency at index raised to exponent.
+	*/
+	fvalue powAt(fvalue exponent, size_t index) const
+	{
+		return std::exp(exponent*_logOmega[index]);
+	}
+
+	/**
+	* @brief Creates a spectrum with the frequencies of this plan and an impedance of zero.
+	*
+	* @return A spectrum with size() DataPoints.
+	*/
+	std::vector<DataPoint> getDataPoints() const;
+};
+
+/** @} */
+
+}
@@ -22,12 +22,15 @@
 
 #include <complex>
 #include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
+#include <map>
 #include <functional>
 #include <kisstype/type.h>
 
 #include "componant/componant.h"
+#include "frequencyplan.h"
 
 namespace eis
 {
@@ -46,23 +49,91 @@ struct CompiledObject;
 class Model
 {
 private:
-	Componant *processBrackets(std::string& str, size_t& bracketCounter, size_t paramSweepCount, bool defaultToRange);
-	Componant *processBracket(std::string& str, size_t paramSweepCount, bool defaultToRange);
-	std::string getParamStr(const std::string& str, size_t index);
-	static size_t paramSkipIndex(const std::string& str, size_t index);
+	static Componant *parseSerial(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange);
+	static Componant *parseParallel(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange);
+	static Componant *parseElement(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange);
+	static Componant *parseNetwork(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange);
+	static size_t parseNode(const std::string& str, size_t& pos);
+	static std::string parseErrorStr(const std::string& str, size_t pos, const std::string& message);
 	static void addComponantToFlat(Componant* componant, std::vector<Componant*>* flatComponants);
 
-	static void sweepThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop, const std::vector<fvalue>& omega);
+	static void sweepThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+	                          const FrequencyPlan& omega, const std::vector<size_t>* indecies);
+	static void parameterThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+	                              const FrequencyPlan& omega, const std::vector<std::vector<fvalue>>& parameters);
+	static void sampleThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+	                           const FrequencyPlan& omega, size_t count, int mode, uint64_t seed);
+	std::vector<DataPoint> executeCompiled(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters) const;
+	std::vector<DataPoint> executeGraph(const FrequencyPlan& omega);
 
 	size_t getActiveParameterCount();
+	const std::vector<fvalue>& getRangeTable(size_t index, const Range& range);
+	void updateCanonical();
+	static std::string getCodeForComponant(Componant* componant, const std::string& functionName);
+	static CompiledObject* loadCompiled(size_t uuid, const std::string& code, const std::string& symbolName);
+	const CompiledObject* getCompiledObject(const std::vector<fvalue>& canonicalParameters) const;
+	bool compileSpecialized();
+	bool compileJacobian();
+	std::map<size_t, std::vector<DataPoint>> getAdaptiveSweepSamples(const FrequencyPlan& omega, double distance,
+	                                                                size_t budget, bool threaded);
 
 private:
 	Componant *_model = nullptr;
-	std::vector<Componant*> _bracketComponants;
 	std::string _modelStr;
 	std::vector<Componant*> _flatComponants;
 	std::string _modelUuid;
+	std::string _canonicalModelStr;
+	std::vector<std::vector<size_t>> _canonicalParameterMap;
+	bool _canonicalIdentity = true;
+	bool _rational = false;
 	CompiledObject* _compiledModel = nullptr;
+	CompiledObject* _specializedModel = nullptr;
+	std::vector<std::pair<size_t, fvalue>> _specializedParameters;
+	size_t _specializedUuid = 0;
+	CompiledObject* _compiledJacobian = nullptr;
+	std::vector<std::pair<Range, std::vector<fvalue>>> _rangeTables;
+
+public:
+
+	/**
+	* @brief Methods by which parameter vectors can be drawn from the ranges of a model.
+	*
+	* Only parameters with a range of more than one step are sampled, all other parameters are held at the start of their range.
+	*/
+	enum SamplingMode
+	{
+		SAMPLE_UNIFORM, ///< Independent samples distributed uniformly between the start and end of each range.
+		SAMPLE_LOG_UNIFORM, ///< Independent samples distributed uniformly in log space, ranges that include values <= 0 are sampled linearly.
+		SAMPLE_LATIN_HYPERCUBE, ///< Latin hypercube samples, every range is divided into as many strata as samples are requested and every stratum is hit exactly once, logarithmic ranges are stratified in log space.
+		SAMPLE_SOBOL, ///< Shifted Sobol low-discrepancy sequence, logarithmic ranges are sampled in log space. Beyond 21 sampled parameters additional parameters are sampled as with SAMPLE_UNIFORM.
+	};
+
+	/**
+	* @brief Backends by which the impedance of a model can be calculated.
+	*/
+	enum Backend
+	{
+		BACKEND_GRAPH, ///< The tree of circuit elements is evaluated directly, circuits of only resistors, capacitors and inductors are reduced to a rational function first.
+		BACKEND_COMPILED, ///< A kernel compiled from the model, or taken from the kernel cache, is executed.
+	};
+
+	/**
+	* @brief A decision of the execution planner together with the figures it was based on.
+	*/
+	struct ExecutionPlan
+	{
+		std::string model; ///< The model string the plan was made for.
+		Backend backend = BACKEND_GRAPH; ///< The backend chosen.
+		size_t evaluations = 0; ///< The number of impedance evaluations planned for, steps times frequencies.
+		double graphThroughput = 0; ///< The measured evaluations per second of the graph backend, 0 if not measured.
+		double compiledThroughput = 0; ///< The measured evaluations per second of the compiled backend, 0 if not measured.
+		double compileTime = 0; ///< The time in seconds compiling took, or was expected to take if the kernel was not compiled.
+		bool cached = false; ///< True if a compiled kernel was available without compiling.
+		std::string reason; ///< A human readable explanation of the decision.
+	};
+
+private:
+	ExecutionPlan _executionPlan;
 
 public:
 
@@ -118,6 +189,35 @@ public:
 	*/
 	std::vector<DataPoint> executeSweep(const std::vector<fvalue>& omega, size_t index = 0);
 
+	/**
+	* @brief Executes a frequency sweep that is only sampled densely where the spectrum changes.
+	*
+	* The sweep starts from a coarse grid along omega and recursively bisects every interval where linear interpolation
+	* between its ends misses the impedance at its midpoint by more than tolerance, or where the impedance changes by more
+	* than the square root of tolerance, both relative to the largest impedance in the sweep. Thus the returned spectrum
+	* can be resampled to any grid by eis::fitToFrequencies with an error of about tolerance.
+	*
+	* This method calls resolveSteps.
+	*
+	* @param omega The range along which to execute the frequency sweep, its count is the maximum number of points evaluated.
+	* @param index An optional index to the parameter sweep step at which to calculate the impedance.
+	* @param tolerance The tolerated interpolation error relative to the largest impedance of the spectrum.
+	* @return A vector of DataPoint structs, ordered by frequency, at non uniformly spaced frequencies.
+	*/
+	std::vector<DataPoint> executeAdaptiveSweep(const Range& omega, size_t index = 0, fvalue tolerance = 1e-3);
+
+	/**
+	* @brief Executes a frequency sweep at the frequencies of the given plan.
+	*
+	* When many spectra are calculated on the same frequencies, this avoids recomputing
+	* the quantities that the circuit elements derive from omega for every spectrum.
+	*
+	* @param omega The frequency plan to calculate the impedance at.
+	* @param index An optional index to the parameter sweep step at which to calculate the impedance.
+	* @return A vector of DataPoint structs containing the impedance at every frequency in the sweep.
+	*/
+	std::vector<DataPoint> executeSweep(const FrequencyPlan& omega, size_t index = 0);
+
 	/**
 	 * @brief Executes a frequency and parameter sweep at the given parameter indecies
 	 *
@@ -138,6 +238,16 @@ public:
 	 */
 	std::vector<std::vector<DataPoint>> executeSweeps(const std::vector<fvalue>& omega, const std::vector<size_t>& indecies, bool parallel = false);
 
+	/**
+	 * @brief Executes a frequency and parameter sweep at the given parameter indecies
+	 *
+	 * @param omega The frequency plan to calculate the impedance at, it is shared by all threads.
+	 * @param indecies the parameter indecies to include in the sweep
+	 * @param parallel if this is set to true, the parameter sweep is executed in parallel
+	 * @return A vector of vectors of DataPoint structs containing the impedance at every frequency sweep and parameter index.
+	 */
+	std::vector<std::vector<DataPoint>> executeSweeps(const FrequencyPlan& omega, const std::vector<size_t>& indecies, bool parallel = false);
+
 	/**
 	* @brief Executes a frequency sweep with the given omega values for each parameter combination in the applied parameter sweep.
 	*
@@ -148,6 +258,120 @@ public:
 	*/
 	std::vector<std::vector<DataPoint>> executeAllSweeps(const Range& omega);
 
+	/**
+	* @brief Draws the parameters of a sample from the ranges of this model.
+	*
+	* The values returned are a pure function of the arguments and the ranges of the model,
+	* thus any sample can be drawn independently, in any order and on any thread.
+	*
+	* @param index The index of the sample to draw, must be smaller than count.
+	* @param count The total number of samples in the set, used to stratify SAMPLE_LATIN_HYPERCUBE.
+	* @param mode The sampling method to use.
+	* @param seed The seed of the sample set.
+	* @return The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	*/
+	std::vector<fvalue> getSampleParameters(size_t index, size_t count, SamplingMode mode = SAMPLE_LATIN_HYPERCUBE, uint64_t seed = 0);
+
+	/**
+	* @brief Executes a frequency sweep with the given parameter values.
+	*
+	* The parameter sweep of the model is left unchanged.
+	*
+	* @throws std::invalid_argument If the number of parameters dose not match getParameterCount.
+	* @param omega A vector of frequencies in rad/s to calculate the impedance at.
+	* @param parameters The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	* @return A vector of DataPoint structs containing the impedance at every frequency in the sweep.
+	*/
+	std::vector<DataPoint> executeParameters(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters);
+
+	/**
+	* @brief Executes a frequency sweep with the given parameter values at the frequencies of the given plan.
+	*
+	* The parameter sweep of the model is left unchanged.
+	*
+	* @throws std::invalid_argument If the number of parameters dose not match getParameterCount.
+	* @param omega The frequency plan to calculate the impedance at.
+	* @param parameters The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	* @return A vector of DataPoint structs containing the impedance at every frequency in the sweep.
+	*/
+	std::vector<DataPoint> executeParameters(const FrequencyPlan& omega, const std::vector<fvalue>& parameters);
+
+	/**
+	* @brief Executes a frequency sweep with the given parameter values and computes the derivatives of the impedance with respect to every parameter.
+	*
+	* The derivatives are computed analytically, either by the kernel compiled by compile(false, true) or by propagating the
+	* derivatives of every circuit element through the circuit. The parameter sweep of the model is left unchanged.
+	*
+	* @throws std::invalid_argument If the number of parameters dose not match getParameterCount.
+	* @param omega The frequencies to calculate the impedance at.
+	* @param parameters The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	* @param jacobian Is resized to omega.size()*getParameterCount() and filled with the derivative of the impedance at omega[i]
+	* with respect to parameter j at index i*getParameterCount()+j.
+	* @return A vector of DataPoint structs containing the impedance at every frequency in the sweep.
+	*/
+	std::vector<DataPoint> executeJacobian(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters,
+	                                       std::vector<std::complex<fvalue>>& jacobian);
+
+	/**
+	* @brief Executes a frequency sweep for each row of parameter values.
+	*
+	* @throws std::invalid_argument If the number of parameters in any row dose not match getParameterCount.
+	* @param omega A vector of frequencies in rad/s to calculate the impedance at.
+	* @param parameters A vector of rows of parameter values in the order used by getFlatParameters.
+	* @param parallel if this is set to true, the rows are executed in parallel.
+	* @return A vector of vectors of DataPoint structs containing the impedance at every frequency for every row.
+	*/
+	std::vector<std::vector<DataPoint>> executeParameterSweeps(const std::vector<fvalue>& omega,
+	                                                           const std::vector<std::vector<fvalue>>& parameters, bool parallel = false);
+
+	/**
+	* @brief Sets the parameters of all circuit elements to the given fixed values.
+	*
+	* This replaces any parameter sweep of the model, the topology and any compiled code are retained.
+	*
+	* @throws std::invalid_argument If the number of parameters dose not match getParameterCount.
+	* @param parameters The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	*/
+	void setFlatParameters(const std::vector<fvalue>& parameters);
+
+	/**
+	* @brief Binds the parameters embedded in a model string of the same topology to this model.
+	*
+	* This is much faster than constructing a new model from the string, as done for the strings returned by getModelStrWithParam.
+	* The circuit elements in str must appear in the same order as in the string this model was created from,
+	* elements without a parameter string retain their current parameters. If an error is thrown the model is left unchanged.
+	*
+	* @throws parse_errror If the topology of str dose not match this model or its parameters include invalid syntax.
+	* @param str The model string with embedded parameters to bind.
+	*/
+	void bindParameters(const std::string& str);
+
+	/**
+	* @brief Executes a frequency sweep for each of count samples drawn by getSampleParameters.
+	*
+	* @param omega A vector of frequencies in rad/s to calculate the impedance at.
+	* @param count The number of samples to draw.
+	* @param mode The sampling method to use.
+	* @param seed The seed of the sample set.
+	* @param parallel if this is set to true, the samples are executed in parallel.
+	* @return A vector of vectors of DataPoint structs containing the impedance at every frequency for every sample.
+	*/
+	std::vector<std::vector<DataPoint>> executeSamples(const std::vector<fvalue>& omega, size_t count,
+	                                                   SamplingMode mode = SAMPLE_LATIN_HYPERCUBE, uint64_t seed = 0, bool parallel = false);
+
+	/**
+	* @brief Executes a frequency sweep for each of count samples drawn by getSampleParameters.
+	*
+	* @param omega The range along which to execute the frequency sweep.
+	* @param count The number of samples to draw.
+	* @param mode The sampling method to use.
+	* @param seed The seed of the sample set.
+	* @param parallel if this is set to true, the samples are executed in parallel.
+	* @return A vector of vectors of DataPoint structs containing the impedance at every frequency for every sample.
+	*/
+	std::vector<std::vector<DataPoint>> executeSamples(const Range& omega, size_t count,
+	                                                   SamplingMode mode = SAMPLE_LATIN_HYPERCUBE, uint64_t seed = 0, bool parallel = false);
+
 	/**
 	* @brief Returns the model string corresponding to this model object, without embedded parameters.
 	*
@@ -177,12 +401,46 @@ public:
 	/**
 	* @brief Returns a unique id.
 	*
-	* This id is only unique for the given circuit description string, not for this object as sutch.
+	* This id is only unique for the canonical form of the circuit, not for this object as sutch.
+	* Thus circuits that differ only in the order of commutative elements share the same id.
 	*
 	* @return The uid.
 	*/
 	size_t getUuid() const;
 
+	/**
+	* @brief Gets the uuid of the jacobian kernel compiled by compile.
+	*
+	* @return The uuid of the jacobian kernel, its function is named getCompiledFunctionName() + "_jacobian".
+	*/
+	size_t getJacobianUuid() const;
+
+	/**
+	* @brief Returns the model string of the canonical form of this model, without embedded parameters.
+	*
+	* In canonical form nested parallel and serial elements are flattened, resistors in series are merged
+	* and the elements of every parallel and serial group are sorted, so that for instance
+	* "rc", "cr" and "(cr)" all share the canonical form "cr" and "r-c-r" has the canonical form "c-r".
+	*
+	* @return The canonical model string.
+	*/
+	std::string getCanonicalModelStr() const;
+
+	/**
+	* @brief Maps parameter values of this model to the parameters of its canonical form.
+	*
+	* @param parameters The values of the parameters of the circuit elements in the order used by getFlatParameters.
+	* @return The values of the parameters of the canonical form of the model.
+	*/
+	std::vector<fvalue> getCanonicalParameters(const std::vector<fvalue>& parameters) const;
+
+	/**
+	* @brief Gets the mapping between the parameters of this model and those of its canonical form.
+	*
+	* @return For each parameter of the canonical form, the indices of the parameters of this model, in the order used by getFlatParameters, whose values sum to it.
+	*/
+	const std::vector<std::vector<size_t>>& getCanonicalParameterMap() const;
+
 	/**
 	* @brief Returns a vector of pointers to the circuit elements in this model.
 	*
@@ -238,12 +496,59 @@ public:
 	* This function is slow, but results are cached for the lifetime of process linked to libeisgenerator
 	* so that a circuit has to be compiled only once and can then be used by any number of Model objects.
 	*
+	* If specialize is set, an additional kernel is compiled in which every parameter that is not swept is baked in
+	* as a constant, so that the subexpressions that depend only on these parameters are evaluated at compile time.
+	* This kernel is used whenever the parameters passed to the execute family of methods match the baked in values,
+	* otherwise execution falls back to the generic kernel. Specialized kernels are cached by the baked in values.
+	*
 	* This function is only implemented on UNIX, on other platforms this function will always return false.
 	* This function also requires that GCC be available in PATH.
 	*
+	* If jacobian is set, an additional kernel is compiled that computes the derivatives of the impedance with respect to
+	* every parameter alongside the impedance, it is used by executeJacobian.
+	*
+	* @param specialize If true, additionally compile a kernel specialized on the parameters that are not swept.
+	* @param jacobian If true, additionally compile a kernel that computes the jacobian.
 	* @return true if compile was successful, false otherwise.
 	*/
-	bool compile();
+	bool compile(bool specialize = false, bool jacobian = false);
+
+	/**
+	* @brief Chooses the backend for a workload and compiles the model if this is expected to pay off.
+	*
+	* The work is estimated as the number of steps times the number of frequencies. Unless a compiled kernel is already
+	* available, the throughput of the graph backend is measured and compared against the expected throughput of a
+	* compiled kernel, including the time it takes to compile it, as learned from previous compilations in this process.
+	* If the model is compiled its throughput is measured, and should the kernel turn out to be slower than the graph
+	* backend it is dropped again.
+	*
+	* @param omegaCount The number of frequencies every step is evaluated at.
+	* @param steps The number of steps that are going to be evaluated, 0 for getRequiredStepsForSweeps.
+	* @param specialize Passed to compile if the model is compiled.
+	* @return The decision made.
+	*/
+	ExecutionPlan planExecution(size_t omegaCount, size_t steps = 0, bool specialize = false);
+
+	/**
+	* @brief Gets the last decision made by planExecution for this model.
+	*
+	* @return The last decision made, or a default constructed plan if planExecution was never called.
+	*/
+	const ExecutionPlan& getExecutionPlan() const;
+
+	/**
+	* @brief Gets the most recent decisions made by planExecution for any model in this process, oldest first.
+	*
+	* @return The most recent decisions, at most 1000.
+	*/
+	static std::vector<ExecutionPlan> getExecutionDecisions();
+
+	/**
+	* @brief Gets the uuid of the kernel specialized by compile(true).
+	*
+	* @return The uuid of the specialized kernel or 0 if the model has no specialized kernel.
+	*/
+	size_t getSpecializedUuid() const;
 
 	/**
 	* @brief This function drops the compiled object code, reverting to graph execution
@@ -286,6 +591,24 @@ public:
 	*/
 	std::string getCode();
 
+	/**
+	* @brief Creates the c++ code of the kernel built by compile.
+	*
+	* Unlike getCode, the kernel is generated for the canonical form of the circuit, thus it takes the parameters in the
+	* order given by getCanonicalParameters and is shared by all models with the same uuid.
+	*
+	* @return The code or an empty string if the model can not be compiled.
+	*/
+	std::string getKernelCode();
+
+	/**
+	* @brief Creates c++ code that computes the impedance of this model followed by its derivatives with respect to every parameter
+	* of the canonical form of the circuit.
+	*
+	* @return The code or an empty string if the circuit contains elements that lack an expression graph.
+	*/
+	std::string getJacobianCode();
+
 	/**
 	* @brief Compiles this model into TorchScript
 	*
@@ -309,11 +632,19 @@ public:
 	* use getRequiredStepsForSweeps for an estimate of the complexity. It is strongly recommended to call compile()
 	* before using this function.
 	*
+	* If budget is given and smaller than the number of steps, the sweep grid is instead refined adaptively: starting from the
+	* whole grid, cells are bisected along the parameter the spectrum is most sensitive to, as long as spectra in the cell are
+	* well formed and differ by more than distance, until budget steps have been evaluated.
+	*
 	* @param threaded if this is set to true eisgenerator will spawn nproc number of threads to service this request.
 	* @param distance the target distance between subisquent spectra relative to eis::eisDistance.
+	* @param budget the maximum number of steps to evaluate, 0 to evaluate every step.
+	* @param filterElements if true, steps where not all elements contribute or elements in series are too similar are skipped,
+	* see allElementsContribute and hasSeriesDifference.
 	* @return A vector of indecies corresponding to the iso-difference spectras.
 	*/
-	std::vector<size_t> getRecommendedParamIndices(eis::Range omegaRange, double distance, bool threaded = false);
+	std::vector<size_t> getRecommendedParamIndices(eis::Range omegaRange, double distance, bool threaded = false, size_t budget = 0,
+	                                               bool filterElements = true);
 
 	/**
 	* @brief Attempts to check if all elements contribute to the result
@@ -0,0 +1,208 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared library and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <memory>
+#include <filesystem>
+#include <kisstype/type.h>
+
+#include "dataset.h"
+
+namespace eis
+{
+
+/**
+* @addtogroup DATASET
+* @{
+*/
+
+/**
+* @brief Streams a single array into a numpy .npy file.
+*
+* The array is written row by row, its first dimension is the number of rows appended and is filled into the header by finish.
+*/
+class NpyArrayWriter
+{
+private:
+	std::ofstream _ownedFile;
+	std::ostream* _file;
+	uint64_t _start;
+	bool _finished = false;
+	uint32_t _dataCrc = 0;
+	std::filesystem::path _path;
+	std::vector<size_t> _rowShape;
+	size_t _rowSize;
+	size_t _rows = 0;
+	std::string _descr;
+	std::vector<char> _chunk;
+	size_t _chunkSize;
+
+	std::string getHeader(size_t rows) const;
+	void flush();
+
+public:
+	/**
+	* @brief Constructor, creates the file and writes a preliminary header.
+	*
+	* @throws file_error If the file can not be created.
+	* @param path The path to the file to create.
+	* @param descr The numpy type descriptor of the elements, ie. "<f4" or "<c8".
+	* @param elementSize The size of one element in bytes.
+	* @param rowShape The shape of one row, may be empty for a one dimensional array.
+	* @param chunkSize The number of bytes to buffer before they are written to disk.
+	*/
+	NpyArrayWriter(const std::filesystem::path& path, const std::string& descr, size_t elementSize,
+	               const std::vector<size_t>& rowShape = std::vector<size_t>(), size_t chunkSize = 1 << 22);
+
+	/**
+	* @brief Constructor, streams the array into an already open stream starting at its current position, ie. as a member of a zip archive.
+	*
+	* The stream must be seekable and outlive the writer, finish leaves the stream positioned at the end of the array.
+	*
+	* @throws file_error If the header can not be written.
+	* @param stream The stream to write to.
+	* @param descr The numpy type descriptor of the elements, ie. "<f4" or "<c8".
+	* @param elementSize The size of one element in bytes.
+	* @param rowShape The shape of one row, may be empty for a one dimensional array.
+	* @param chunkSize The number of bytes to buffer before they are written to the stream.
+	*/
+	NpyArrayWriter(std::ostream& stream, const std::string& descr, size_t elementSize,
+	               const std::vector<size_t>& rowShape = std::vector<size_t>(), size_t chunkSize = 1 << 22);
+	NpyArrayWriter(const NpyArrayWriter&) = delete;
+	NpyArrayWriter& operator=(const NpyArrayWriter&) = delete;
+	~NpyArrayWriter();
+
+	/**
+	* @brief Appends one row.
+	*
+	* @param row Pointer to the row, must point to the number of bytes given by the row shape times the element size.
+	*/
+	void append(const void* row);
+
+	/**
+	* @brief Flushes the remaining rows, writes the final shape into the header and closes the file.
+	*/
+	void finish();
+
+	/**
+	* @brief Closes the file without completeing the header, the rows appended so far are discarded.
+	*/
+	void abort();
+
+	/**
+	* @brief Gets the size of the array including its header in bytes, valid after finish.
+	*
+	* @return The size in bytes.
+	*/
+	uint64_t byteSize() const;
+
+	/**
+	* @brief Gets the CRC-32 of the array including its header as used by zip archives, valid after finish.
+	*
+	* @return The CRC-32.
+	*/
+	uint32_t crc() const;
+
+	/**
+	* @brief Gets the number of rows appended so far.
+	*
+	* @return The number of rows appended so far.
+	*/
+	size_t size() const;
+};
+
+/**
+* @brief Writes the spectra of a parameter sweep as numpy arrays that can be loaded by numpy.load or torch.from_numpy.
+*
+* The following files are created:
+* * spectra.npy: the impedance as a [step x omega] complex64 array, or a [step x omega x 2] float32 array.
+* * omega.npy: the frequencies in rad/s as a [omega] float32 array.
+* * parameters.npy: the parameters of each step as a [step x parameter] float32 array.
+* * indices.npy: the parameter sweep index of each step as a [step] uint64 array.
+* * model.json: sidecar containing the model string and the names of the parameters.
+*
+* These are either placed in a directory or, if npz is set, packed into an uncompressed .npz archive. In this case the spectra
+* are streamed directly into the archive while the much smaller remaining arrays are buffered in a temporary directory and
+* appended to the archive by finish.
+*/
+class NpySweepWriter: public SweepWriter
+{
+private:
+	std::filesystem::path _path;
+	std::filesystem::path _directory;
+	std::ofstream _zip;
+	uint64_t _spectraEntryOffset = 0;
+	bool _npz;
+	bool _finished = false;
+	size_t _omegaCount;
+	size_t _parameterCount;
+	std::unique_ptr<NpyArrayWriter> _spectra;
+	std::unique_ptr<NpyArrayWriter> _parameters;
+	std::unique_ptr<NpyArrayWriter> _indices;
+	std::vector<float> _buffer;
+
+	void writeNpz();
+
+public:
+	/**
+	* @brief Constructor.
+	*
+	* @throws file_error If the output can not be created.
+	* @param path The directory to create, or if npz is set, the .npz file to create.
+	* @param model The model string of the sweep.
+	* @param omega The frequencies in rad/s at which every spectra in the sweep is sampled.
+	* @param parameterNames The names of the parameters of the model in the order used by Model::getFlatParameters.
+	* @param complex If true the spectra are saved as complex64, otherwise as float32 with a trailing dimension of 2.
+	* @param npz If true the arrays are packed into a single .npz file.
+	*/
+	NpySweepWriter(const std::filesystem::path& path, const std::string& model, const std::vector<fvalue>& omega,
+	               const std::vector<std::string>& parameterNames, bool complex = true, bool npz = false);
+	NpySweepWriter(const NpySweepWriter&) = delete;
+	NpySweepWriter& operator=(const NpySweepWriter&) = delete;
+
+	/**
+	* @brief Destructor, calls abort if finish was not called.
+	*/
+	virtual ~NpySweepWriter();
+
+	virtual void append(const std::vector<eis::DataPoint>& data, const std::vector<fvalue>& parameters, size_t index) override;
+
+	/**
+	* @brief Completes the arrays and, if requested, packs them into the .npz file.
+	*/
+	virtual void finish() override;
+
+	/**
+	* @brief Removes the arrays written so far, or if npz is set, the .npz file.
+	*/
+	virtual void abort() override;
+
+	virtual size_t size() const override;
+};
+
+/** @} */
+
+}
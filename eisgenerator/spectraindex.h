@@ -0,0 +1,170 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared library and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <kisstype/type.h>
+
+#include "model.h"
+
+namespace eis
+{
+
+/**
+* @addtogroup DATASET
+* @{
+*/
+
+/**
+* @brief Memory mapped nearest neighbour index over the spectra of a parameter sweep.
+*
+* The index stores the normalized spectra of every step of a sweep together with their parameters, arranged as a
+* vantage point tree so that the spectra closest to a measured spectrum with respect to eis::eisDistance can be found
+* without comparing against every step. The closest steps are good starting points for eis::fit.
+*
+* The file is memory mapped, the pointers returned by the accessors of this class point directly into the mapping
+* and thus remain valid only for the lifetime of this object.
+*/
+class SpectraIndex
+{
+public:
+	/**
+	* @brief A spectrum in the index close to a queried spectrum.
+	*/
+	struct Match
+	{
+		size_t step; ///< The position of the spectrum in the index, to be passed to getParameters.
+		size_t index; ///< The parameter sweep index of the spectrum.
+		fvalue distance; ///< The eis::eisDistance between the normalized spectra.
+	};
+
+private:
+	const uint8_t* _data = nullptr;
+	size_t _size = 0;
+	void* _mapping = nullptr;
+	std::string _model;
+	std::vector<std::string> _parameterNames;
+	size_t _stepCount;
+	size_t _omegaCount;
+	size_t _parameterCount;
+	const float* _omega;
+	const float* _spectra;
+	const float* _thresholds;
+	const uint64_t* _indices;
+	const float* _parameters;
+
+	void unmap();
+	void search(const float* query, size_t begin, size_t end, size_t k, std::vector<std::pair<float, size_t>>& heap) const;
+
+public:
+	/**
+	* @brief Computes every step of the parameter sweep of a model and saves the index to a file.
+	*
+	* @throws file_error If the file can not be written.
+	* @param path The path to the file to create.
+	* @param model The model to sweep.
+	* @param omega The frequencies in rad/s at which the spectra are computed.
+	* @param threaded If true the spectra are computed on all cores.
+	*/
+	static void build(const std::filesystem::path& path, Model& model, const std::vector<fvalue>& omega, bool threaded = true);
+
+	/**
+	* @brief Constructor, maps the given file.
+	*
+	* @throws file_error If the file can not be opened or is not a valid index file.
+	* @param path The path of the file to map.
+	*/
+	SpectraIndex(const std::filesystem::path& path);
+	SpectraIndex(const SpectraIndex&) = delete;
+	SpectraIndex& operator=(const SpectraIndex&) = delete;
+	~SpectraIndex();
+
+	/**
+	* @brief Finds the spectra in the index closest to the given spectrum.
+	*
+	* The spectrum is resampled to the frequencies of the index by eis::fitToFrequencies and normalized before comparison,
+	* thus it may be sampled at any frequencies.
+	*
+	* @param spectrum The spectrum to look up.
+	* @param k The number of spectra to return.
+	* @return Up to k matches, ordered by increasing distance.
+	*/
+	std::vector<Match> query(const std::vector<eis::DataPoint>& spectrum, size_t k = 1) const;
+
+	/**
+	* @brief Gets the number of spectra in the index.
+	*
+	* @return The number of spectra in the index.
+	*/
+	size_t size() const;
+
+	/**
+	* @brief Gets the model string of the sweep.
+	*
+	* @return The model string of the sweep.
+	*/
+	const std::string& getModelStr() const;
+
+	/**
+	* @brief Gets the names of the parameters.
+	*
+	* @return The names of the parameters.
+	*/
+	const std::vector<std::string>& getParameterNames() const;
+
+	/**
+	* @brief Gets the number of parameters stored for each spectrum.
+	*
+	* @return The number of parameters stored for each spectrum.
+	*/
+	size_t getParameterCount() const;
+
+	/**
+	* @brief Gets the frequencies the spectra are sampled at.
+	*
+	* @return The frequencies in rad/s.
+	*/
+	std::vector<fvalue> getOmega() const;
+
+	/**
+	* @brief Gets the parameters of a spectrum.
+	*
+	* @param step The position of the spectrum in the index.
+	* @return The values of the parameters of the model for this spectrum.
+	*/
+	std::vector<fvalue> getParameters(size_t step) const;
+
+	/**
+	* @brief Gets a normalized spectrum.
+	*
+	* @param step The position of the spectrum in the index.
+	* @return The normalized spectrum.
+	*/
+	std::vector<eis::DataPoint> getDataPoints(size_t step) const;
+};
+
+/** @} */
+
+}
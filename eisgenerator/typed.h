@@ -0,0 +1,441 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared library and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#pragma once
+
+#include <cstddef>
+#include <cassert>
+#include <array>
+#include <complex>
+#include <cmath>
+#include <limits>
+#include <span>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include <kisstype/type.h>
+#include "componant/formulas.h"
+
+namespace eis::typed
+{
+
+/**
+* Circuit models whose topology is fixed at compile time
+* @defgroup TYPED Typed models
+*
+* Models are composed from types, ie. eis::typed::Series<eis::typed::R, eis::typed::Parallel<eis::typed::R, eis::typed::Cpe>>,
+* the resulting impedance function is fully inlined and evaluating it requires neither parsing, virtual dispatch nor heap allocations.
+* The elements use the same formulas as the corresponding eis::Componant.
+* @{
+*/
+
+/**
+* @brief A string that can be built at compile time.
+*/
+template<size_t N>
+struct FixedString
+{
+	char data[N] = {};
+
+	constexpr FixedString() = default;
+	constexpr FixedString(const char (&str)[N])
+	{
+		for(size_t i = 0; i < N; ++i)
+			data[i] = str[i];
+	}
+
+	constexpr size_t size() const {return N-1;}
+	constexpr std::string_view view() const {return std::string_view(data, N-1);}
+	constexpr operator std::string_view() const {return view();}
+};
+
+template<size_t A, size_t B>
+constexpr FixedString<A+B-1> operator+(const FixedString<A>& a, const FixedString<B>& b)
+{
+	FixedString<A+B-1> out;
+	for(size_t i = 0; i < A-1; ++i)
+		out.data[i] = a.data[i];
+	for(size_t i = 0; i < B; ++i)
+		out.data[A-1+i] = b.data[i];
+	return out;
+}
+
+/**
+* @brief Base of all typed models, holds the parameters and provides the interface to evaluate the model.
+*
+* Derived types provide the static members paramCount, modelString, impedance, admittance and appendModelStr.
+*/
+template<typename Derived, size_t N>
+class Circuit
+{
+public:
+	/**
+	* @brief The parameters of the model in the order used by eis::Model::getFlatParameters.
+	*/
+	std::array<fvalue, N> parameters = {};
+
+	constexpr Circuit() = default;
+
+	/**
+	* @brief Constructor.
+	*
+	* @param values The parameters of the model in the order used by eis::Model::getFlatParameters.
+	*/
+	template<typename... P> requires (sizeof...(P) == N && N > 0 && (std::is_arithmetic_v<P> && ...))
+	constexpr Circuit(P... values): parameters{static_cast<fvalue>(values)...}
+	{}
+
+	constexpr Circuit(const std::array<fvalue, N>& parametersIn): parameters(parametersIn)
+	{}
+
+	/**
+	* @brief Gets the impedance of the model at the given frequency.
+	*
+	* @param omega The frequency in rad/s.
+	* @return The impedance.
+	*/
+	std::complex<fvalue> execute(fvalue omega) const
+	{
+		return Derived::impedance(omega, parameters.data());
+	}
+
+	/**
+	* @brief Gets the impedance of the model at the given frequencies.
+	*
+	* @param omega The frequencies in rad/s.
+	* @param out The impedances, must be of the same size as omega.
+	*/
+	void execute(std::span<const fvalue> omega, std::span<std::complex<fvalue>> out) const
+	{
+		assert(omega.size() == out.size());
+		const fvalue* p = parameters.data();
+		for(size_t i = 0; i < omega.size(); ++i)
+			out[i] = Derived::impedance(omega[i], p);
+	}
+
+	/**
+	* @brief Gets the impedance of the model at the given frequencies.
+	*
+	* @param omega The frequencies in rad/s.
+	* @return The impedances.
+	*/
+	template<size_t M>
+	std::array<std::complex<fvalue>, M> execute(const std::array<fvalue, M>& omega) const
+	{
+		std::array<std::complex<fvalue>, M> out;
+		execute(std::span<const fvalue>(omega), std::span<std::complex<fvalue>>(out));
+		return out;
+	}
+
+	/**
+	* @brief Gets the spectrum of the model in the same form as eis::Model::executeSweep.
+	*
+	* @param omega The frequencies in rad/s.
+	* @return The spectrum.
+	*/
+	std::vector<eis::DataPoint> executeSweep(const std::vector<fvalue>& omega) const
+	{
+		std::vector<eis::DataPoint> out(omega.size());
+		const fvalue* p = parameters.data();
+		for(size_t i = 0; i < omega.size(); ++i)
+			out[i] = eis::DataPoint(Derived::impedance(omega[i], p), omega[i]);
+		return out;
+	}
+
+	/**
+	* @brief Gets the model string of this model with its parameters embedded, this string can be used to create an equivalent eis::Model.
+	*
+	* @return The model string.
+	*/
+	std::string getModelStr() const
+	{
+		std::stringstream out;
+		out.precision(std::numeric_limits<fvalue>::max_digits10);
+		Derived::appendModelStr(out, parameters.data());
+		return out.str();
+	}
+
+	/**
+	* @brief Gets the model string of the topology of this model without parameters, ie. "(r-(rp))".
+	*
+	* @return The model string.
+	*/
+	static constexpr std::string_view getTopologyStr()
+	{
+		return Derived::modelString.view();
+	}
+};
+
+/**
+* @brief Base of the elements, an element is a single eis::Componant.
+*/
+template<typename Derived, char Symbol, size_t N>
+class Element: public Circuit<Derived, N>
+{
+public:
+	using Circuit<Derived, N>::Circuit;
+
+	static constexpr size_t paramCount = N;
+	static constexpr FixedString<2> modelString = FixedString<2>({Symbol, '\0'});
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return std::complex<fvalue>(1, 0)/Derived::impedance(omega, parameters);
+	}
+
+	static void appendModelStr(std::ostream& out, const fvalue* parameters)
+	{
+		out<<Symbol<<'{';
+		for(size_t i = 0; i < N; ++i)
+			out<<(i > 0 ? ", " : "")<<parameters[i];
+		out<<'}';
+	}
+};
+
+/**
+* @brief Resistor, parameters: {R}
+*/
+class R: public Element<R, 'r', 1>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		(void)omega;
+		return formulas::resistorImpedance(parameters[0]);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		(void)omega;
+		return formulas::resistorAdmittance(parameters[0]);
+	}
+};
+
+/**
+* @brief Capacitor, parameters: {C}
+*/
+class C: public Element<C, 'c', 1>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::capImpedance(omega, parameters[0]);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::capAdmittance(omega, parameters[0]);
+	}
+};
+
+/**
+* @brief Inductor, parameters: {L}
+*/
+class L: public Element<L, 'l', 1>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::inductorImpedance(omega, parameters[0]);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::inductorAdmittance(omega, parameters[0]);
+	}
+};
+
+/**
+* @brief Constant phase element, parameters: {Q, alpha}
+*/
+class Cpe: public Element<Cpe, 'p', 2>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::cpeImpedance(omega, parameters[0], parameters[1]);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::cpeAdmittance(omega, parameters[0], parameters[1]);
+	}
+};
+
+/**
+* @brief Infinite warburg element, parameters: {A}
+*/
+class W: public Element<W, 'w', 1>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::warburgImpedance(omega, parameters[0]);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::warburgAdmittance(omega, parameters[0]);
+	}
+};
+
+/**
+* @brief Closed transmission line, parameters: {R, Q, a, l}
+*/
+class Trc: public Element<Trc, 't', 4>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::trcImpedance(omega, parameters[0], parameters[1], parameters[2], parameters[3]);
+	}
+};
+
+/**
+* @brief Open (reflecting) transmission line, parameters: {R, Q, a, l}
+*/
+class Tro: public Element<Tro, 'o', 4>
+{
+public:
+	using Element::Element;
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return formulas::troImpedance(omega, parameters[0], parameters[1], parameters[2], parameters[3]);
+	}
+};
+
+/**
+* @brief Base of the series and parallel combinations of several models.
+*/
+template<typename Derived, typename... Componants>
+class Combination: public Circuit<Derived, (Componants::paramCount + ...)>
+{
+public:
+	static_assert(sizeof...(Componants) > 0, "a combination requires at least one componant");
+
+	using Circuit<Derived, (Componants::paramCount + ...)>::Circuit;
+
+	static constexpr size_t paramCount = (Componants::paramCount + ...);
+
+	static void appendModelStr(std::ostream& out, const fvalue* parameters)
+	{
+		out<<'(';
+		appendChildModelStr<Componants...>(out, parameters);
+		out<<')';
+	}
+
+protected:
+	template<typename First, typename... Rest>
+	static std::complex<fvalue> sumImpedance(fvalue omega, const fvalue* parameters)
+	{
+		std::complex<fvalue> accum = First::impedance(omega, parameters);
+		if constexpr(sizeof...(Rest) > 0)
+			accum += sumImpedance<Rest...>(omega, parameters + First::paramCount);
+		return accum;
+	}
+
+	template<typename First, typename... Rest>
+	static std::complex<fvalue> sumAdmittance(fvalue omega, const fvalue* parameters)
+	{
+		std::complex<fvalue> accum = First::admittance(omega, parameters);
+		if constexpr(sizeof...(Rest) > 0)
+			accum += sumAdmittance<Rest...>(omega, parameters + First::paramCount);
+		return accum;
+	}
+
+	template<typename First, typename... Rest>
+	static void appendChildModelStr(std::ostream& out, const fvalue* parameters)
+	{
+		First::appendModelStr(out, parameters);
+		if constexpr(sizeof...(Rest) > 0)
+		{
+			if constexpr(Derived::serial)
+				out<<'-';
+			appendChildModelStr<Rest...>(out, parameters + First::paramCount);
+		}
+	}
+};
+
+/**
+* @brief Series combination of the given models.
+*/
+template<typename First, typename... Rest>
+class Series: public Combination<Series<First, Rest...>, First, Rest...>
+{
+public:
+	using Combination<Series<First, Rest...>, First, Rest...>::Combination;
+
+	static constexpr bool serial = true;
+	static constexpr auto modelString = FixedString("(") + (First::modelString + ... + (FixedString("-") + Rest::modelString)) + FixedString(")");
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return Series::template sumImpedance<First, Rest...>(omega, parameters);
+	}
+
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return std::complex<fvalue>(1, 0)/impedance(omega, parameters);
+	}
+};
+
+/**
+* @brief Parallel combination of the given models.
+*/
+template<typename First, typename... Rest>
+class Parallel: public Combination<Parallel<First, Rest...>, First, Rest...>
+{
+public:
+	using Combination<Parallel<First, Rest...>, First, Rest...>::Combination;
+
+	static constexpr bool serial = false;
+	static constexpr auto modelString = FixedString("(") + (First::modelString + ... + Rest::modelString) + FixedString(")");
+
+	static std::complex<fvalue> impedance(fvalue omega, const fvalue* parameters)
+	{
+		return std::complex<fvalue>(1, 0)/admittance(omega, parameters);
+	}
+
+	// the children are combined in the admittance domain, so only this node needs a complex division
+	static std::complex<fvalue> admittance(fvalue omega, const fvalue* parameters)
+	{
+		return Parallel::template sumAdmittance<First, Rest...>(omega, parameters);
+	}
+};
+
+/** @} */
+
+}
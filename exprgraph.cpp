@@ -0,0 +1,496 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "exprgraph.h"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <utility>
+
+#include "compile.h"
+
+using namespace eis;
+
+ExprGraph::Expr ExprGraph::insert(Op op, Expr a, Expr b, double value, size_t parameter)
+{
+	// operands of commutative operations are ordered so that a+b and b+a share a node
+	if((op == ADD || op == MUL) && a > b)
+		std::swap(a, b);
+
+	std::tuple<int, Expr, Expr, double, size_t> key(op, a, b, value, parameter);
+	auto iter = _lookup.find(key);
+	if(iter != _lookup.end())
+		return iter->second;
+
+	Node node;
+	node.op = op;
+	node.a = a;
+	node.b = b;
+	node.value = value;
+	node.parameter = parameter;
+	node.complex = op == COMPLEX || (a != INVALID && _nodes[a].complex) || (b != INVALID && _nodes[b].complex);
+	node.omega = op == OMEGA || (a != INVALID && _nodes[a].omega) || (b != INVALID && _nodes[b].omega);
+
+	_nodes.push_back(node);
+	_lookup.insert({key, _nodes.size()-1});
+	return _nodes.size()-1;
+}
+
+bool ExprGraph::isConstant(Expr expr) const
+{
+	return _nodes[expr].op == CONSTANT;
+}
+
+bool ExprGraph::isConstant(Expr expr, double value) const
+{
+	return _nodes[expr].op == CONSTANT && _nodes[expr].value == value;
+}
+
+bool ExprGraph::isComplex(Expr expr) const
+{
+	return _nodes[expr].op == COMPLEX;
+}
+
+ExprGraph::Expr ExprGraph::constant(double value)
+{
+	return insert(CONSTANT, INVALID, INVALID, value);
+}
+
+ExprGraph::Expr ExprGraph::parameter(const std::string& name)
+{
+	_parameters.push_back(name);
+	auto fixed = _fixedParameters.find(_parameters.size()-1);
+	if(fixed != _fixedParameters.end())
+		return constant(fixed->second);
+	return insert(PARAMETER, INVALID, INVALID, 0, _parameters.size()-1);
+}
+
+void ExprGraph::fixParameter(size_t index, double value)
+{
+	_fixedParameters[index] = value;
+}
+
+ExprGraph::Expr ExprGraph::omega()
+{
+	return insert(OMEGA);
+}
+
+ExprGraph::Expr ExprGraph::complex(Expr real, Expr imag)
+{
+	if(isConstant(imag, 0) && !_nodes[real].complex)
+		return real;
+	return insert(COMPLEX, real, imag);
+}
+
+ExprGraph::Expr ExprGraph::add(Expr a, Expr b)
+{
+	if(isConstant(a) && isConstant(b))
+		return constant(_nodes[a].value + _nodes[b].value);
+	if(isConstant(a, 0))
+		return b;
+	if(isConstant(b, 0))
+		return a;
+	if(isComplex(a) && isComplex(b))
+		return complex(add(_nodes[a].a, _nodes[b].a), add(_nodes[a].b, _nodes[b].b));
+	if(isComplex(a) && !_nodes[b].complex)
+		return complex(add(_nodes[a].a, b), _nodes[a].b);
+	if(isComplex(b) && !_nodes[a].complex)
+		return complex(add(a, _nodes[b].a), _nodes[b].b);
+	return insert(ADD, a, b);
+}
+
+ExprGraph::Expr ExprGraph::sub(Expr a, Expr b)
+{
+	if(isConstant(a) && isConstant(b))
+		return constant(_nodes[a].value - _nodes[b].value);
+	if(a == b)
+		return constant(0);
+	if(isConstant(b, 0))
+		return a;
+	if(isConstant(a, 0))
+		return neg(b);
+	if(isComplex(a) && isComplex(b))
+		return complex(sub(_nodes[a].a, _nodes[b].a), sub(_nodes[a].b, _nodes[b].b));
+	return insert(SUB, a, b);
+}
+
+ExprGraph::Expr ExprGraph::mul(Expr a, Expr b)
+{
+	if(isConstant(a) && isConstant(b))
+		return constant(_nodes[a].value * _nodes[b].value);
+	if(isConstant(a, 0) || isConstant(b, 0))
+		return constant(0);
+	if(isConstant(a, 1))
+		return b;
+	if(isConstant(b, 1))
+		return a;
+	if(isConstant(a, -1))
+		return neg(b);
+	if(isConstant(b, -1))
+		return neg(a);
+	if(isComplex(b) && !_nodes[a].complex)
+		return complex(mul(a, _nodes[b].a), mul(a, _nodes[b].b));
+	if(isComplex(a) && !_nodes[b].complex)
+		return complex(mul(_nodes[a].a, b), mul(_nodes[a].b, b));
+	return insert(MUL, a, b);
+}
+
+ExprGraph::Expr ExprGraph::div(Expr a, Expr b)
+{
+	if(isConstant(a) && isConstant(b) && _nodes[b].value != 0)
+		return constant(_nodes[a].value / _nodes[b].value);
+	if(isConstant(b, 1))
+		return a;
+	if(isConstant(a, 0))
+		return constant(0);
+
+	const Node& denominator = _nodes[b];
+	if(isConstant(a, 1))
+	{
+		// 1/(1/x) = x
+		if(denominator.op == DIV && isConstant(denominator.a, 1))
+			return denominator.b;
+		// 1/(0+xj) = -(1/x)j
+		if(denominator.op == COMPLEX && isConstant(denominator.a, 0))
+			return complex(constant(0), neg(div(a, denominator.b)));
+	}
+	if(isConstant(a) && denominator.op == NEG)
+		return neg(div(a, denominator.a));
+	if(isComplex(a) && !denominator.complex)
+		return complex(div(_nodes[a].a, b), div(_nodes[a].b, b));
+	return insert(DIV, a, b);
+}
+
+ExprGraph::Expr ExprGraph::neg(Expr a)
+{
+	if(isConstant(a))
+		return constant(-_nodes[a].value);
+	if(_nodes[a].op == NEG)
+		return _nodes[a].a;
+	if(isComplex(a))
+		return complex(neg(_nodes[a].a), neg(_nodes[a].b));
+	return insert(NEG, a);
+}
+
+ExprGraph::Expr ExprGraph::pow(Expr a, Expr b)
+{
+	if(isConstant(a) && isConstant(b) && std::isfinite(std::pow(_nodes[a].value, _nodes[b].value)))
+		return constant(std::pow(_nodes[a].value, _nodes[b].value));
+	if(isConstant(b, 1))
+		return a;
+	if(isConstant(b, -1))
+		return div(constant(1), a);
+	if(isConstant(b, 0.5))
+		return sqrt(a);
+	return insert(POW, a, b);
+}
+
+ExprGraph::Expr ExprGraph::sqrt(Expr a)
+{
+	if(isConstant(a) && _nodes[a].value >= 0)
+		return constant(std::sqrt(_nodes[a].value));
+	return insert(SQRT, a);
+}
+
+ExprGraph::Expr ExprGraph::sin(Expr a)
+{
+	if(isConstant(a))
+		return constant(std::sin(_nodes[a].value));
+	return insert(SIN, a);
+}
+
+ExprGraph::Expr ExprGraph::cos(Expr a)
+{
+	if(isConstant(a))
+		return constant(std::cos(_nodes[a].value));
+	return insert(COS, a);
+}
+
+ExprGraph::Expr ExprGraph::tanh(Expr a)
+{
+	if(isConstant(a))
+		return constant(std::tanh(_nodes[a].value));
+	return insert(TANH, a);
+}
+
+ExprGraph::Expr ExprGraph::log(Expr a)
+{
+	if(isConstant(a) && _nodes[a].value > 0)
+		return constant(std::log(_nodes[a].value));
+	return insert(LOG, a);
+}
+
+ExprGraph::Expr ExprGraph::derivative(Expr expr, size_t parameter)
+{
+	auto iter = _derivatives.find({expr, parameter});
+	if(iter != _derivatives.end())
+		return iter->second;
+
+	// the node is copied as creating the derivative nodes may reallocate _nodes
+	const Node node = _nodes[expr];
+	Expr da = node.a != INVALID ? derivative(node.a, parameter) : INVALID;
+	Expr db = node.b != INVALID ? derivative(node.b, parameter) : INVALID;
+
+	Expr out;
+	switch(node.op)
+	{
+		case PARAMETER:
+			out = constant(node.parameter == parameter ? 1 : 0);
+			break;
+		case ADD:
+			out = add(da, db);
+			break;
+		case SUB:
+			out = sub(da, db);
+			break;
+		case MUL:
+			out = add(mul(da, node.b), mul(node.a, db));
+			break;
+		case DIV:
+			out = isConstant(db, 0) ? div(da, node.b) : div(sub(da, mul(expr, db)), node.b);
+			break;
+		case NEG:
+			out = neg(da);
+			break;
+		case POW:
+			out = constant(0);
+			if(!isConstant(da, 0))
+				out = mul(mul(node.b, div(expr, node.a)), da);
+			if(!isConstant(db, 0))
+				out = add(out, mul(mul(expr, log(node.a)), db));
+			break;
+		case SQRT:
+			out = isConstant(da, 0) ? da : div(da, mul(constant(2), expr));
+			break;
+		case SIN:
+			out = isConstant(da, 0) ? da : mul(cos(node.a), da);
+			break;
+		case COS:
+			out = isConstant(da, 0) ? da : neg(mul(sin(node.a), da));
+			break;
+		case TANH:
+			out = isConstant(da, 0) ? da : mul(sub(constant(1), mul(expr, expr)), da);
+			break;
+		case LOG:
+			out = div(da, node.a);
+			break;
+		case COMPLEX:
+			out = complex(da, db);
+			break;
+		default:
+			out = constant(0);
+			break;
+	}
+
+	_derivatives.insert({{expr, parameter}, out});
+	return out;
+}
+
+const ExprGraph::Node& ExprGraph::getNode(Expr expr) const
+{
+	return _nodes[expr];
+}
+
+const std::vector<std::string>& ExprGraph::getParameters() const
+{
+	return _parameters;
+}
+
+size_t ExprGraph::size() const
+{
+	return _nodes.size();
+}
+
+std::string ExprGraph::getOperand(Expr expr) const
+{
+	const Node& node = _nodes[expr];
+	switch(node.op)
+	{
+		case CONSTANT:
+		{
+			float value = node.value;
+			if(!std::isfinite(value))
+				return std::isnan(value) ? std::string("std::numeric_limits<fvalue>::quiet_NaN()") :
+					(value < 0 ? "(-std::numeric_limits<fvalue>::infinity())" : "std::numeric_limits<fvalue>::infinity()");
+			std::stringstream ss;
+			ss<<std::setprecision(std::numeric_limits<float>::max_digits10)<<value;
+			std::string out = ss.str();
+			if(out.find_first_of(".e") == std::string::npos)
+				out.append(".0");
+			return value < 0 ? "(" + out + "f)" : out + "f";
+		}
+		case PARAMETER:
+			return _parameters[node.parameter];
+		case OMEGA:
+			return "omega";
+		default:
+			return "t" + std::to_string(expr);
+	}
+}
+
+std::string ExprGraph::getStatement(Expr expr) const
+{
+	const Node& node = _nodes[expr];
+	std::string a = node.a != INVALID ? getOperand(node.a) : "";
+	std::string b = node.b != INVALID ? getOperand(node.b) : "";
+
+	std::string value;
+	switch(node.op)
+	{
+		case ADD:
+			value = a + " + " + b;
+			break;
+		case SUB:
+			value = a + " - " + b;
+			break;
+		case MUL:
+			value = a + "*" + b;
+			break;
+		case DIV:
+			value = a + "/" + b;
+			break;
+		case NEG:
+			value = "-" + a;
+			break;
+		case POW:
+			value = "std::pow(" + a + ", " + b + ")";
+			break;
+		case SQRT:
+			value = "std::sqrt(" + a + ")";
+			break;
+		case SIN:
+			value = "std::sin(" + a + ")";
+			break;
+		case COS:
+			value = "std::cos(" + a + ")";
+			break;
+		case TANH:
+			value = "std::tanh(" + a + ")";
+			break;
+		case LOG:
+			value = "std::log(" + a + ")";
+			break;
+		case COMPLEX:
+			value = "std::complex<fvalue>(" + a + ", " + b + ")";
+			break;
+		default:
+			return "";
+	}
+
+	std::string type = node.complex ? "std::complex<fvalue>" : "fvalue";
+	return "const " + type + " " + getOperand(expr) + " = " + value + ";\n";
+}
+
+std::string ExprGraph::getCode(Expr root, const std::string& functionName) const
+{
+	return getKernel({root}, functionName);
+}
+
+std::string ExprGraph::getJacobianCode(Expr root, const std::string& functionName)
+{
+	std::vector<Expr> roots = {root};
+	for(size_t i = 0; i < _parameters.size(); ++i)
+		roots.push_back(derivative(root, i));
+	return getKernel(roots, functionName);
+}
+
+std::string ExprGraph::getKernel(const std::vector<Expr>& roots, const std::string& functionName) const
+{
+	// post order traversal yields the reachable nodes in an order where every node follows its operands
+	std::vector<Expr> order;
+	std::vector<bool> visited(_nodes.size(), false);
+	std::vector<std::pair<Expr, bool>> stack;
+	for(auto root = roots.rbegin(); root != roots.rend(); ++root)
+		stack.push_back({*root, false});
+	while(!stack.empty())
+	{
+		auto [expr, expanded] = stack.back();
+		stack.pop_back();
+		if(expanded)
+		{
+			order.push_back(expr);
+			continue;
+		}
+		if(visited[expr])
+			continue;
+		visited[expr] = true;
+		stack.push_back({expr, true});
+		if(_nodes[expr].b != INVALID && !visited[_nodes[expr].b])
+			stack.push_back({_nodes[expr].b, false});
+		if(_nodes[expr].a != INVALID && !visited[_nodes[expr].a])
+			stack.push_back({_nodes[expr].a, false});
+	}
+
+	std::string out =
+	"#include <cmath>\n"
+	"#include <cassert>\n"
+	"#include <vector>\n"
+	"#include <complex>\n"
+	"#include <limits>\n\n"
+	"typedef float fvalue;\n\n";
+	out.append(KERNEL_ATTRIBUTE_CODE);
+	out.append(
+	"extern \"C\"\n{\n\n"
+	"EIS_KERNEL std::vector<std::complex<fvalue>> ");
+	out.append(functionName);
+	out.append("(const std::vector<fvalue>& parameters, const std::vector<fvalue>& omegas)\n{\n\tassert(parameters.size() == ");
+	out.append(std::to_string(_parameters.size()));
+	out.append(");\n\n");
+	std::string stride = roots.size() > 1 ? "*" + std::to_string(roots.size()) : "";
+	out.append("\tstd::vector<std::complex<fvalue>> out(omegas.size()" + stride + ");\n");
+
+	for(size_t i = 0; i < _parameters.size(); ++i)
+	{
+		if(_fixedParameters.count(i))
+			continue;
+		out.append("\tconst fvalue " + _parameters[i] + " = parameters[" + std::to_string(i) +  "];\n");
+	}
+
+	for(Expr expr : order)
+	{
+		std::string statement = getStatement(expr);
+		if(!_nodes[expr].omega && !statement.empty())
+			out.append("\t" + statement);
+	}
+
+	out.append("\tfor(size_t i = 0; i < omegas.size(); ++i)\n\t{\n");
+	out.append("\t\tconst fvalue& omega = omegas[i];\n");
+	for(Expr expr : order)
+	{
+		std::string statement = getStatement(expr);
+		if(_nodes[expr].omega && !statement.empty())
+			out.append("\t\t" + statement);
+	}
+
+	for(size_t i = 0; i < roots.size(); ++i)
+	{
+		std::string index = roots.size() > 1 ? "i" + stride + "+" + std::to_string(i) : "i";
+		if(_nodes[roots[i]].complex)
+			out.append("\t\tout[" + index + "] = " + getOperand(roots[i]) + ";\n");
+		else
+			out.append("\t\tout[" + index + "] = std::complex<fvalue>(" + getOperand(roots[i]) + ", 0);\n");
+	}
+	out.append("\t}\n\treturn out;\n}\n\n}\n");
+	return out;
+}
@@ -0,0 +1,137 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace eis
+{
+
+/**
+* A directed acyclic graph of the arithmetic expression that computes the impedance of a circuit at omega.
+*
+* Nodes are hash consed, so identical subexpressions are represented by a single node, and the node constructors
+* fold constants and apply algebraic simplifications. Transcendental functions of real nodes are real functions,
+* elements that require complex semantics must create complex nodes explicitly via complex().
+*/
+class ExprGraph
+{
+public:
+	typedef size_t Expr;
+	static constexpr Expr INVALID = SIZE_MAX;
+
+	enum Op
+	{
+		CONSTANT,
+		PARAMETER,
+		OMEGA,
+		ADD,
+		SUB,
+		MUL,
+		DIV,
+		NEG,
+		POW,
+		SQRT,
+		SIN,
+		COS,
+		TANH,
+		LOG,
+		COMPLEX
+	};
+
+	struct Node
+	{
+		Op op;
+		Expr a = INVALID;
+		Expr b = INVALID;
+		double value = 0;
+		size_t parameter = 0;
+		bool complex = false;
+		bool omega = false;
+	};
+
+private:
+	std::vector<Node> _nodes;
+	std::vector<std::string> _parameters;
+	std::map<size_t, double> _fixedParameters;
+	std::map<std::tuple<int, Expr, Expr, double, size_t>, Expr> _lookup;
+	std::map<std::pair<Expr, size_t>, Expr> _derivatives;
+
+	Expr insert(Op op, Expr a = INVALID, Expr b = INVALID, double value = 0, size_t parameter = 0);
+	bool isConstant(Expr expr) const;
+	bool isConstant(Expr expr, double value) const;
+	bool isComplex(Expr expr) const;
+	std::string getOperand(Expr expr) const;
+	std::string getStatement(Expr expr) const;
+	std::string getKernel(const std::vector<Expr>& roots, const std::string& functionName) const;
+
+public:
+	Expr constant(double value);
+	Expr parameter(const std::string& name);
+	Expr omega();
+	Expr complex(Expr real, Expr imag);
+	Expr add(Expr a, Expr b);
+	Expr sub(Expr a, Expr b);
+	Expr mul(Expr a, Expr b);
+	Expr div(Expr a, Expr b);
+	Expr neg(Expr a);
+	Expr pow(Expr a, Expr b);
+	Expr sqrt(Expr a);
+	Expr sin(Expr a);
+	Expr cos(Expr a);
+	Expr tanh(Expr a);
+	Expr log(Expr a);
+
+	/**
+	* Gets the derivative of expr with respect to the parameter with the given index by forward mode differentiation,
+	* the derivative nodes are hash consed together with the rest of the graph. Fixed parameters have a derivative of 0.
+	*/
+	Expr derivative(Expr expr, size_t parameter);
+
+	/**
+	* Makes the parameter with the given index, counted in the order in which parameter() is called, a constant of the
+	* given value, so that the expressions depending on it are folded. Must be called before the parameter is created.
+	*/
+	void fixParameter(size_t index, double value);
+
+	const Node& getNode(Expr expr) const;
+	const std::vector<std::string>& getParameters() const;
+	size_t size() const;
+
+	/**
+	* Emits a kernel with the same signature as the one created by Model::getCode, expressions that do not depend on omega
+	* are evaluated once before the loop over omega, every other node is evaluated once per omega.
+	*/
+	std::string getCode(Expr root, const std::string& functionName) const;
+
+	/**
+	* Emits a kernel with the same signature as getCode that computes the value of root followed by its derivatives with respect
+	* to every parameter, so for every omega parameters+1 values are placed consecutively in the returned vector.
+	*/
+	std::string getJacobianCode(Expr root, const std::string& functionName);
+};
+
+}
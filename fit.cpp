@@ -0,0 +1,379 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "fit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#include "log.h"
+
+using namespace eis;
+
+namespace
+{
+
+struct FitParameter
+{
+	bool free = true;
+	bool log = false;
+	double lower = -std::numeric_limits<double>::infinity();
+	double upper = std::numeric_limits<double>::infinity();
+	double initial = 0;
+};
+
+struct Problem
+{
+	std::vector<fvalue> omega;
+	std::vector<std::complex<fvalue>> measured;
+	std::vector<double> weights;
+	std::vector<FitParameter> parameters;
+	std::vector<size_t> free;
+};
+
+}
+
+// the transformed value x of a parameter p is log(p) for parameters fitted in log space and p otherwise
+static std::vector<fvalue> toParameters(const Problem& problem, const std::vector<double>& x)
+{
+	std::vector<fvalue> out(problem.parameters.size());
+	for(size_t i = 0; i < out.size(); ++i)
+		out[i] = problem.parameters[i].log ? std::exp(x[i]) : x[i];
+	return out;
+}
+
+static std::vector<FitParameter> getFitParameters(Model& model, const FitOptions& options)
+{
+	std::vector<Range> ranges = model.getFlatParameterRanges();
+	std::vector<FitParameter> out(ranges.size());
+	for(size_t i = 0; i < ranges.size(); ++i)
+	{
+		const Range& range = ranges[i];
+		FitParameter& parameter = out[i];
+		if(range.count > 1)
+		{
+			parameter.lower = std::min(range.start, range.end);
+			parameter.upper = std::max(range.start, range.end);
+			if(range.log && parameter.lower > 0)
+				parameter.initial = std::sqrt(parameter.lower*parameter.upper);
+			else
+				parameter.initial = (parameter.lower + parameter.upper)/2;
+		}
+		else
+		{
+			parameter.initial = range.start;
+			parameter.free = !options.fixUnswept;
+			if(parameter.initial > 0)
+				parameter.lower = 0;
+		}
+
+		if(options.initialParameters.size() == ranges.size())
+			parameter.initial = std::clamp<double>(options.initialParameters[i], parameter.lower, parameter.upper);
+
+		parameter.log = options.logTransform && parameter.lower >= 0 && parameter.initial > 0;
+		if(parameter.log)
+		{
+			parameter.initial = std::log(parameter.initial);
+			parameter.lower = parameter.lower > 0 ? std::log(parameter.lower) : -std::numeric_limits<double>::infinity();
+			parameter.upper = std::log(parameter.upper);
+		}
+	}
+	return out;
+}
+
+// computes the weighted residuals and, if jacobian is given, their derivatives with respect to the free transformed parameters
+static double evaluate(Model& model, const Problem& problem, const std::vector<double>& x,
+                       std::vector<double>& residuals, std::vector<double>* jacobian)
+{
+	std::vector<fvalue> parameters = toParameters(problem, x);
+	std::vector<DataPoint> data;
+	std::vector<std::complex<fvalue>> parameterJacobian;
+	if(jacobian)
+		data = model.executeJacobian(problem.omega, parameters, parameterJacobian);
+	else
+		data = model.executeParameters(problem.omega, parameters);
+
+	const size_t count = problem.omega.size();
+	residuals.resize(count*2);
+	double cost = 0;
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::complex<fvalue> difference = data[i].im - problem.measured[i];
+		residuals[i*2] = difference.real()*problem.weights[i];
+		residuals[i*2+1] = difference.imag()*problem.weights[i];
+		cost += residuals[i*2]*residuals[i*2] + residuals[i*2+1]*residuals[i*2+1];
+	}
+
+	if(jacobian)
+	{
+		const size_t freeCount = problem.free.size();
+		jacobian->assign(count*2*freeCount, 0);
+		for(size_t k = 0; k < freeCount; ++k)
+		{
+			size_t j = problem.free[k];
+			double chain = problem.parameters[j].log ? parameters[j] : 1.0;
+			for(size_t i = 0; i < count; ++i)
+			{
+				std::complex<fvalue> derivative = parameterJacobian[i*parameters.size()+j];
+				(*jacobian)[(i*2)*freeCount+k] = derivative.real()*problem.weights[i]*chain;
+				(*jacobian)[(i*2+1)*freeCount+k] = derivative.imag()*problem.weights[i]*chain;
+			}
+		}
+	}
+	return std::isfinite(cost) ? cost : std::numeric_limits<double>::infinity();
+}
+
+// factorizes the symmetric positive definite matrix a of size n in place into its lower cholesky factor
+static bool cholesky(std::vector<double>& a, size_t n)
+{
+	for(size_t j = 0; j < n; ++j)
+	{
+		double diagonal = a[j*n+j];
+		for(size_t k = 0; k < j; ++k)
+			diagonal -= a[j*n+k]*a[j*n+k];
+		if(!(diagonal > 0))
+			return false;
+		a[j*n+j] = std::sqrt(diagonal);
+		for(size_t i = j+1; i < n; ++i)
+		{
+			double value = a[i*n+j];
+			for(size_t k = 0; k < j; ++k)
+				value -= a[i*n+k]*a[j*n+k];
+			a[i*n+j] = value/a[j*n+j];
+		}
+	}
+	return true;
+}
+
+static void choleskySolve(const std::vector<double>& factor, size_t n, std::vector<double>& b)
+{
+	for(size_t i = 0; i < n; ++i)
+	{
+		for(size_t k = 0; k < i; ++k)
+			b[i] -= factor[i*n+k]*b[k];
+		b[i] /= factor[i*n+i];
+	}
+	for(size_t i = n; i > 0; --i)
+	{
+		for(size_t k = i; k < n; ++k)
+			b[i-1] -= factor[k*n+i-1]*b[k];
+		b[i-1] /= factor[(i-1)*n+i-1];
+	}
+}
+
+static void normalEquations(const std::vector<double>& jacobian, const std::vector<double>& residuals, size_t n,
+                            std::vector<double>& hessian, std::vector<double>& gradient)
+{
+	const size_t rows = residuals.size();
+	hessian.assign(n*n, 0);
+	gradient.assign(n, 0);
+	for(size_t r = 0; r < rows; ++r)
+	{
+		const double* row = jacobian.data()+r*n;
+		for(size_t i = 0; i < n; ++i)
+		{
+			gradient[i] += row[i]*residuals[r];
+			for(size_t j = 0; j <= i; ++j)
+				hessian[i*n+j] += row[i]*row[j];
+		}
+	}
+	for(size_t i = 0; i < n; ++i)
+	{
+		for(size_t j = i+1; j < n; ++j)
+			hessian[i*n+j] = hessian[j*n+i];
+	}
+}
+
+static FitResult fitProblem(Model& model, const Problem& problem, const FitOptions& options)
+{
+	const size_t n = problem.free.size();
+	std::vector<double> x(problem.parameters.size());
+	for(size_t i = 0; i < x.size(); ++i)
+		x[i] = problem.parameters[i].initial;
+
+	FitResult result;
+	std::vector<double> residuals;
+	std::vector<double> jacobian;
+	std::vector<double> hessian;
+	std::vector<double> gradient;
+	double cost = evaluate(model, problem, x, residuals, &jacobian);
+	normalEquations(jacobian, residuals, n, hessian, gradient);
+
+	double lambda = options.initialLambda;
+	std::vector<double> trialResiduals;
+	while(result.iterations < options.maxIterations && n > 0)
+	{
+		++result.iterations;
+
+		// marquardt scaling of the damping keeps the step invariant to the scale of the parameters
+		double maxDiagonal = 0;
+		for(size_t i = 0; i < n; ++i)
+			maxDiagonal = std::max(maxDiagonal, hessian[i*n+i]);
+		std::vector<double> damped = hessian;
+		for(size_t i = 0; i < n; ++i)
+			damped[i*n+i] += lambda*std::max(hessian[i*n+i], maxDiagonal*1e-12 + std::numeric_limits<double>::min());
+
+		std::vector<double> step(n);
+		for(size_t i = 0; i < n; ++i)
+			step[i] = -gradient[i];
+		if(!cholesky(damped, n))
+		{
+			lambda *= 10;
+			continue;
+		}
+		choleskySolve(damped, n, step);
+
+		std::vector<double> trial = x;
+		double maxStep = 0;
+		for(size_t k = 0; k < n; ++k)
+		{
+			size_t j = problem.free[k];
+			trial[j] = std::clamp(x[j] + step[k], problem.parameters[j].lower, problem.parameters[j].upper);
+			maxStep = std::max(maxStep, std::abs(trial[j] - x[j])/(std::abs(x[j]) + options.tolerance));
+		}
+
+		double trialCost = evaluate(model, problem, trial, trialResiduals, nullptr);
+		if(trialCost < cost)
+		{
+			double improvement = (cost - trialCost)/cost;
+			x = trial;
+			cost = evaluate(model, problem, x, residuals, &jacobian);
+			normalEquations(jacobian, residuals, n, hessian, gradient);
+			lambda = std::max(lambda/10, 1e-12);
+			if(improvement < options.tolerance || maxStep < options.tolerance)
+			{
+				result.converged = true;
+				break;
+			}
+		}
+		else
+		{
+			lambda *= 10;
+			// no step in the trust region reduces the cost, thus x is a minimum to the precision of the model
+			if(lambda > 1e12 || maxStep < options.tolerance)
+			{
+				result.converged = true;
+				break;
+			}
+		}
+	}
+	if(n == 0)
+		result.converged = true;
+
+	result.parameters = toParameters(problem, x);
+	result.cost = cost;
+
+	std::vector<DataPoint> data = model.executeParameters(problem.omega, result.parameters);
+	result.residuals.resize(data.size());
+	for(size_t i = 0; i < data.size(); ++i)
+		result.residuals[i] = data[i].im - problem.measured[i];
+
+	// the covariance is the inverse of the hessian scaled by the residual variance, transformed back to the parameters
+	const size_t parameterCount = problem.parameters.size();
+	result.covariance.assign(parameterCount*parameterCount, 0);
+	std::vector<double> factor = hessian;
+	if(n > 0 && cholesky(factor, n))
+	{
+		double variance = cost/std::max<double>(1, static_cast<double>(residuals.size()) - n);
+		for(size_t k = 0; k < n; ++k)
+		{
+			std::vector<double> column(n, 0);
+			column[k] = 1;
+			choleskySolve(factor, n, column);
+			size_t a = problem.free[k];
+			double chainA = problem.parameters[a].log ? result.parameters[a] : 1.0;
+			for(size_t l = 0; l < n; ++l)
+			{
+				size_t b = problem.free[l];
+				double chainB = problem.parameters[b].log ? result.parameters[b] : 1.0;
+				result.covariance[a*parameterCount+b] = column[l]*variance*chainA*chainB;
+			}
+		}
+	}
+	else if(n > 0)
+	{
+		std::fill(result.covariance.begin(), result.covariance.end(), std::numeric_limits<fvalue>::quiet_NaN());
+	}
+	return result;
+}
+
+static Problem getProblem(const std::vector<DataPoint>& spectrum, const std::vector<FitParameter>& parameters, const FitOptions& options)
+{
+	Problem problem;
+	problem.parameters = parameters;
+	problem.omega.reserve(spectrum.size());
+	problem.measured.reserve(spectrum.size());
+	problem.weights.reserve(spectrum.size());
+	for(const DataPoint& point : spectrum)
+	{
+		problem.omega.push_back(point.omega);
+		problem.measured.push_back(point.im);
+		double modulus = std::abs(point.im);
+		problem.weights.push_back(options.modulusWeighting && modulus > 0 ? 1.0/modulus : 1.0);
+	}
+	for(size_t i = 0; i < parameters.size(); ++i)
+	{
+		if(parameters[i].free)
+			problem.free.push_back(i);
+	}
+	return problem;
+}
+
+FitResult eis::fit(Model& model, const std::vector<DataPoint>& spectrum, const FitOptions& options)
+{
+	return fitProblem(model, getProblem(spectrum, getFitParameters(model, options), options), options);
+}
+
+static void fitThreadFn(std::vector<FitResult>* results, Model model, const std::vector<std::vector<DataPoint>>& spectra,
+                        const std::vector<FitParameter>& parameters, size_t start, size_t stop, const FitOptions& options)
+{
+	for(size_t i = start; i < stop; ++i)
+		results->at(i) = fitProblem(model, getProblem(spectra[i], parameters, options), options);
+}
+
+std::vector<FitResult> eis::fit(Model& model, const std::vector<std::vector<DataPoint>>& spectra, const FitOptions& options)
+{
+	std::vector<FitResult> results(spectra.size());
+	if(spectra.empty())
+		return results;
+
+	std::vector<FitParameter> parameters = getFitParameters(model, options);
+	size_t threadsCount = options.parallel ? std::max(std::thread::hardware_concurrency(), 1u) : 1;
+	threadsCount = std::min(threadsCount, spectra.size());
+	size_t perThread = spectra.size()/threadsCount;
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadsCount);
+	for(size_t i = 0; i < threadsCount; ++i)
+	{
+		size_t start = i*perThread;
+		size_t stop = i == threadsCount-1 ? spectra.size() : start+perThread;
+		threads.push_back(std::thread(fitThreadFn, &results, model, std::cref(spectra), std::cref(parameters),
+			start, stop, std::cref(options)));
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+
+	return results;
+}
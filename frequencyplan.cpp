@@ -0,0 +1,86 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "frequencyplan.h"
+
+#include <cmath>
+
+using namespace eis;
+
+FrequencyPlan::FrequencyPlan(const std::vector<fvalue>& omega): _omega(omega)
+{
+	_inverseOmega.resize(_omega.size());
+	_sqrtOmega.resize(_omega.size());
+	_logOmega.resize(_omega.size());
+	for(size_t i = 0; i < _omega.size(); ++i)
+	{
+		_inverseOmega[i] = 1/_omega[i];
+		_sqrtOmega[i] = std::sqrt(_omega[i]);
+		_logOmega[i] = std::log(_omega[i]);
+	}
+}
+
+FrequencyPlan::FrequencyPlan(const Range& omega): FrequencyPlan(omega.getRangeVector())
+{
+}
+
+size_t FrequencyPlan::size() const
+{
+	return _omega.size();
+}
+
+const std::vector<fvalue>& FrequencyPlan::getOmega() const
+{
+	return _omega;
+}
+
+const std::vector<fvalue>& FrequencyPlan::getInverseOmega() const
+{
+	return _inverseOmega;
+}
+
+const std::vector<fvalue>& FrequencyPlan::getSqrtOmega() const
+{
+	return _sqrtOmega;
+}
+
+const std::vector<fvalue>& FrequencyPlan::getLogOmega() const
+{
+	return _logOmega;
+}
+
+void FrequencyPlan::pow(fvalue exponent, fvalue* out) const
+{
+	for(size_t i = 0; i < _logOmega.size(); ++i)
+		out[i] = std::exp(exponent*_logOmega[i]);
+}
+
+std::vector<DataPoint> FrequencyPlan::getDataPoints() const
+{
+	std::vector<DataPoint> out(_omega.size());
+	for(size_t i = 0; i < _omega.size(); ++i)
+	{
+		out[i].omega = _omega[i];
+		out[i].im = std::complex<fvalue>(0, 0);
+	}
+	return out;
+}
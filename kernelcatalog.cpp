@@ -0,0 +1,68 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "kernelcatalog.h"
+
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "model.h"
+
+std::string eis::getKernelCatalogCode(const std::vector<std::string>& models)
+{
+	std::stringstream code;
+	std::stringstream entries;
+	std::set<size_t> uuids;
+	size_t count = 0;
+
+	for(const std::string& modelStr : models)
+	{
+		Model model(modelStr, 1, false);
+		if(uuids.count(model.getUuid()))
+			continue;
+		uuids.insert(model.getUuid());
+
+		std::string kernel = model.getKernelCode();
+		if(kernel.empty())
+			throw std::invalid_argument("Model " + modelStr + " can not be compiled");
+		code<<"// "<<modelStr<<'\n'<<kernel<<'\n';
+		entries<<"\t{"<<model.getUuid()<<"ull, reinterpret_cast<void*>(&"<<model.getCompiledFunctionName()<<")},\n";
+		++count;
+
+		std::string jacobian = model.getJacobianCode();
+		if(!jacobian.empty())
+		{
+			code<<jacobian<<'\n';
+			entries<<"\t{"<<model.getJacobianUuid()<<"ull, reinterpret_cast<void*>(&"<<model.getCompiledFunctionName()<<"_jacobian)},\n";
+			++count;
+		}
+	}
+
+	code<<"extern \"C\"\n{\n\n"
+		<<"struct eisgenerator_kernel\n{\n\tunsigned long long uuid;\n\tvoid* symbol;\n};\n\n"
+		// the terminating entry keeps the array valid if the catalog is empty
+		<<"extern const eisgenerator_kernel "<<KERNEL_CATALOG_SYMBOL<<"[] =\n{\n"<<entries.str()<<"\t{0, nullptr}\n};\n\n"
+		<<"extern const unsigned long long "<<KERNEL_CATALOG_SIZE_SYMBOL<<" = "<<count<<";\n\n}\n";
+
+	return code.str();
+}
@@ -0,0 +1,56 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace eis
+{
+
+/**
+* The names of the symbols by which a kernel catalog library exports its kernels.
+*
+* KERNEL_CATALOG_SYMBOL is an array of KernelCatalogEntry and KERNEL_CATALOG_SIZE_SYMBOL an unsigned long long holding its length.
+*/
+static constexpr char KERNEL_CATALOG_SYMBOL[] = "eisgenerator_kernel_catalog";
+static constexpr char KERNEL_CATALOG_SIZE_SYMBOL[] = "eisgenerator_kernel_catalog_size";
+
+struct KernelCatalogEntry
+{
+	unsigned long long uuid;
+	void* symbol;
+};
+
+/**
+* Creates the source of a kernel catalog library containing the kernels, and where possible the jacobian kernels,
+* that Model::compile would build for the given models.
+*
+* Models sharing a canonical form share their kernels.
+*
+* @throws parse_errror If a model string is invalid.
+* @throws std::invalid_argument If a model can not be compiled.
+* @param models The model strings to build kernels for.
+* @return The c++ source of the library.
+*/
+std::string getKernelCatalogCode(const std::vector<std::string>& models);
+
+}
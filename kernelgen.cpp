@@ -0,0 +1,81 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "kernelcatalog.h"
+#include "log.h"
+
+// reads a list of model strings, one per line, and writes the source of a kernel catalog library for them
+int main(int argc, char** argv)
+{
+	// models in the list are commonly given without parameters, the resulting warnings are of no interest here
+	eis::Log::level = eis::Log::ERROR;
+
+	if(argc != 3)
+	{
+		std::cerr<<"Usage: "<<argv[0]<<" [MODEL LIST] [OUTPUT]\n";
+		return 1;
+	}
+
+	std::ifstream list(argv[1]);
+	if(!list.is_open())
+	{
+		eis::Log(eis::Log::ERROR)<<"Unable to open "<<argv[1];
+		return 1;
+	}
+
+	std::vector<std::string> models;
+	std::string line;
+	while(std::getline(list, line))
+	{
+		size_t start = line.find_first_not_of(" \t\r");
+		if(start == std::string::npos || line[start] == '#')
+			continue;
+		size_t end = line.find_last_not_of(" \t\r");
+		models.push_back(line.substr(start, end-start+1));
+	}
+
+	std::string code;
+	try
+	{
+		code = eis::getKernelCatalogCode(models);
+	}
+	catch(const std::exception& err)
+	{
+		eis::Log(eis::Log::ERROR)<<"Unable to create kernel catalog: "<<err.what();
+		return 1;
+	}
+
+	std::ofstream output(argv[2], std::ios_base::out | std::ios_base::trunc);
+	output<<code;
+	if(!output.good())
+	{
+		eis::Log(eis::Log::ERROR)<<"Unable to write "<<argv[2];
+		return 1;
+	}
+
+	return 0;
+}
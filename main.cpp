@@ -25,6 +25,13 @@
 #include <cmath>
 #include <cassert>
 #include <filesystem>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <algorithm>
 #include <kisstype/spectra.h>
 
 #include "basicmath.h"
@@ -33,13 +40,14 @@
 #include "options.h"
 #include "normalize.h"
 #include "translators.h"
+#include "dataset.h"
+#include "npy.h"
+#include "fit.h"
 
 #ifndef M_PI
     #define M_PI 3.14159265358979323846
 #endif
 
-static constexpr double STEP_THRESH = 0.30;
-
 static void printComponants(eis::Model& model)
 {
 	eis::Log(eis::Log::DEBUG)<<"Compnants:";
@@ -59,6 +67,16 @@ static void printComponants(eis::Model& model)
 	}
 }
 
+static void planExecution(const Config& config, eis::Model& model, size_t steps)
+{
+	if(config.noCompile)
+		return;
+
+	eis::Model::ExecutionPlan plan = model.planExecution(config.omegaRange.count, steps, config.specialize);
+	eis::Log(eis::Log::INFO)<<"Using the "<<(plan.backend == eis::Model::BACKEND_COMPILED ? "compiled" : "graph")
+		<<" backend as "<<plan.reason;
+}
+
 static void runSweep(const Config& config, eis::Model& model)
 {
 	std::vector<eis::DataPoint> results;
@@ -66,7 +84,10 @@ static void runSweep(const Config& config, eis::Model& model)
 	eis::Range omega = config.omegaRange;
 
 	auto start = std::chrono::high_resolution_clock::now();
-	results = model.executeSweep(omega);
+	if(config.adaptiveTolerance > 0)
+		results = model.executeAdaptiveSweep(omega, 0, config.adaptiveTolerance);
+	else
+		results = model.executeSweep(omega);
 	auto end = std::chrono::high_resolution_clock::now();
 	auto duration = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 
@@ -114,151 +135,266 @@ static void runSweep(const Config& config, eis::Model& model)
 	}
 }
 
-static void runParamSweep(const Config& config, eis::Model& model)
+template<typename T> class BoundedQueue
 {
-	if(config.saveFileName.empty())
+private:
+	std::deque<T> queue;
+	std::mutex mutex;
+	std::condition_variable notEmpty;
+	std::condition_variable notFull;
+	size_t capacity;
+	bool closed = false;
+
+public:
+	BoundedQueue(size_t capacityIn = 64): capacity(capacityIn)
+	{}
+
+	bool push(T&& item)
 	{
-		eis::Log(eis::Log::WARN)<<"No save directory provided via --save, sweeps will not be saved to disk!";
+		std::unique_lock<std::mutex> lock(mutex);
+		notFull.wait(lock, [this]{return queue.size() < capacity || closed;});
+		if(closed)
+			return false;
+		queue.push_back(std::move(item));
+		notEmpty.notify_one();
+		return true;
 	}
-	else
+
+	bool pop(T& item)
 	{
-		eis::Log(eis::Log::INFO)<<"Saving sweep to "<<config.saveFileName;
-		std::filesystem::create_directory(config.saveFileName);
+		std::unique_lock<std::mutex> lock(mutex);
+		notEmpty.wait(lock, [this]{return !queue.empty() || closed;});
+		if(queue.empty())
+			return false;
+		item = std::move(queue.front());
+		queue.pop_front();
+		notFull.notify_one();
+		return true;
 	}
 
-	size_t count = model.getRequiredStepsForSweeps();
-	eis::Log(eis::Log::INFO)<<"Executeing "<<count<<" steps";
+	void close()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		closed = true;
+		notEmpty.notify_all();
+		notFull.notify_all();
+	}
+};
 
-	if(!config.noCompile)
-		model.compile();
+struct SweepResult
+{
+	size_t index;
+	std::vector<eis::DataPoint> data;
+	std::vector<fvalue> parameters;
+	std::string modelStr;
+};
 
-	auto start = std::chrono::high_resolution_clock::now();
+static std::filesystem::path getShardPath(const std::filesystem::path& path, size_t shard, size_t shards)
+{
+	if(shards < 2)
+		return path;
+	std::filesystem::path out = path;
+	out.replace_filename(path.stem().string() + "_" + std::to_string(shard) + path.extension().string());
+	return out;
+}
 
-	std::vector<std::vector<eis::DataPoint>> allSweeps;
-	if(config.threaded)
-	{
-		eis::Log(eis::Log::INFO)<<"Calculateing sweeps in threads";
-		allSweeps = model.executeAllSweeps(config.omegaRange);
-		eis::Log(eis::Log::INFO)<<"Done";
-	}
+static size_t getShard(const Config& config, size_t index)
+{
+	return index % std::max<size_t>(config.shards, 1);
+}
 
-	for(size_t i = 0; i < count; ++i)
+static void sweepGenerate(const Config* config, eis::Model& model, const eis::FrequencyPlan* omega,
+                          std::atomic<size_t>* next, size_t count, std::vector<BoundedQueue<SweepResult>>* queues,
+                          const std::atomic<bool>* failed)
+{
+	for(size_t i = next->fetch_add(1); i < count && !*failed; i = next->fetch_add(1))
 	{
-		std::vector<eis::DataPoint> data;
-		if(config.threaded)
-			data = allSweeps[i];
-		else
-			data = model.executeSweep(config.omegaRange, i);
+		SweepResult result;
+		result.index = i;
+		result.data = model.executeSweep(*omega, i);
 
-		if(!config.saveFileName.empty())
+		if(queues->empty())
+			continue;
+
+		if(config->normalize)
+			eis::normalize(result.data);
+		if(config->reduce)
 		{
-			if(config.normalize)
-				eis::normalize(data);
-			if(config.reduce)
+			size_t initalDataSize = result.data.size();
+			result.data = eis::reduceRegion(result.data);
+			if(result.data.size() < initalDataSize/8)
 			{
-				size_t initalDataSize = data.size();
-				data = eis::reduceRegion(data);
-				if(data.size() < initalDataSize/8)
-				{
-					eis::Log(eis::Log::INFO)<<"\nskipping output for step "<<i
-						<<" as data has no interesting region";
-					continue;
-				}
-				//data = eis::rescale(data, initalDataSize);
+				eis::Log(eis::Log::INFO)<<"skipping output for step "<<i
+					<<" as data has no interesting region";
+				continue;
 			}
+		}
 
-			if(config.skipLinear && i > 0)
+		if(config->skipLinear && i > 0)
+		{
+			fvalue correlation = std::abs(pearsonCorrelation(result.data));
+			if(correlation > 0.5)
 			{
-				fvalue correlation = std::abs(pearsonCorrelation(data));
-				if(correlation > 0.5)
-				{
-					eis::Log(eis::Log::INFO)<<"skipping output for step "<<i
-						<<" as data is too linear: "<<correlation;
-					continue;
-				}
+				eis::Log(eis::Log::INFO)<<"skipping output for step "<<i
+					<<" as data is too linear: "<<correlation;
+				continue;
 			}
-
-			eis::Spectra(data, model.getModelStrWithParam(i), "").saveToDisk(config.saveFileName+"/"+std::to_string(i)+".csv");
 		}
-		eis::Log(eis::Log::INFO, false)<<'.';
-	}
-	auto end = std::chrono::high_resolution_clock::now();
-	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
-	eis::Log(eis::Log::INFO, false)<<'\n';
 
-	eis::Log(eis::Log::INFO)<<"time taken: "<<duration.count()<<" ms";
+		if(config->format != FORMAT_CSV)
+			result.parameters = model.getFlatParameters();
+		else
+			result.modelStr = model.getModelStrWithParam(i);
+
+		// every shard is serviced by exactly one writer so that the sweep writers need no locking
+		size_t queue = config->format != FORMAT_CSV ? getShard(*config, i) % queues->size() : i % queues->size();
+		if(!(*queues)[queue].push(std::move(result)))
+			return;
+	}
 }
 
-static std::vector<std::vector<fvalue>> getRangeValuesForModel(const Config& config, eis::Model& model, std::vector<size_t>* indices = nullptr)
+// exceptions can not propagate out of a std::thread, so they are logged here and the failure is
+// flagged, all queues are closed so that no thread stays blocked on a peer that has stopped
+static void sweepGeneratorFn(const Config* config, eis::Model model, const eis::FrequencyPlan* omega,
+                             std::atomic<size_t>* next, size_t count, std::vector<BoundedQueue<SweepResult>>* queues,
+                             std::atomic<bool>* failed)
 {
-	std::vector<std::vector<fvalue>> values;
-	std::vector<std::vector<eis::DataPoint>> sweeps;
-	size_t count = model.getRequiredStepsForSweeps();
-	eis::Log(eis::Log::INFO)<<"Executeing "<<count<<" steps";
-	std::vector<eis::Componant*> componants = model.getFlatComponants();
-	std::vector<std::vector<eis::DataPoint>> allSweeps;
-
-	if(config.threaded)
-		allSweeps = model.executeAllSweeps(config.omegaRange);
-
-	for(size_t i = 0; i < count; ++i)
+	try
 	{
-		std::vector<eis::DataPoint> data;
-		if(config.threaded)
-			data = allSweeps[i];
-		else
-			data = model.executeSweep(config.omegaRange, i);
-		normalize(data);
+		sweepGenerate(config, model, omega, next, count, queues, failed);
+	}
+	catch(const std::exception& ex)
+	{
+		eis::Log(eis::Log::ERROR)<<"Failed to calculate sweep: "<<ex.what();
+		*failed = true;
+		for(BoundedQueue<SweepResult>& queue : *queues)
+			queue.close();
+	}
+}
 
-		fvalue maxJump =  maximumNyquistJump(data);
-		if(maxJump > STEP_THRESH)
+static void sweepWriterFn(const Config* config, std::vector<BoundedQueue<SweepResult>>* queues,
+                          size_t queueIndex, std::vector<std::unique_ptr<eis::SweepWriter>>* sweepWriters,
+                          std::atomic<bool>* failed)
+{
+	try
+	{
+		SweepResult result;
+		while((*queues)[queueIndex].pop(result))
 		{
-			eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<i
-				<<" is not well centered: "<<maxJump;
-			continue;
+			if(config->format != FORMAT_CSV)
+				(*sweepWriters)[getShard(*config, result.index)]->append(result.data, result.parameters, result.index);
+			else
+				eis::Spectra(result.data, result.modelStr, "").saveToDisk(config->saveFileName+"/"+std::to_string(result.index)+".csv");
 		}
+	}
+	catch(const std::exception& ex)
+	{
+		eis::Log(eis::Log::ERROR)<<"Failed to save sweep: "<<ex.what();
+		*failed = true;
+		for(BoundedQueue<SweepResult>& queue : *queues)
+			queue.close();
+	}
+}
 
-		fvalue correlation = std::abs(pearsonCorrelation(data));
-		if(correlation > 0.8)
-		{
-			eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<i
-				<<" as data is too linear: "<<correlation;
-			continue;
-		}
+static bool runParamSweep(const Config& config, eis::Model& model)
+{
+	if(config.saveFileName.empty())
+	{
+		eis::Log(eis::Log::WARN)<<"No save directory provided via --save, sweeps will not be saved to disk!";
+	}
+
+	size_t count = model.getRequiredStepsForSweeps();
+	eis::Log(eis::Log::INFO)<<"Executeing "<<count<<" steps";
+
+	planExecution(config, model, count);
+
+	size_t generators = config.threaded ? std::max(std::thread::hardware_concurrency(), 1u) : 1;
+	size_t writers = config.saveFileName.empty() ? 0 : std::max<size_t>(config.writers, 1);
+	if(config.format != FORMAT_CSV)
+		writers = std::min(writers, std::max<size_t>(config.shards, 1));
 
-		bool found = false;
-		for(ssize_t  j = static_cast<ssize_t>(sweeps.size())-1; j >= 0; --j)
+	eis::FrequencyPlan plan(config.omegaRange);
+	const std::vector<fvalue>& omega = plan.getOmega();
+	std::vector<std::unique_ptr<eis::SweepWriter>> sweepWriters;
+	if(config.format != FORMAT_CSV && writers > 0)
+	{
+		size_t shards = std::max<size_t>(config.shards, 1);
+		eis::Log(eis::Log::INFO)<<"Saving sweep to "<<shards<<" shard(s) at "<<config.saveFileName;
+		for(size_t i = 0; i < shards; ++i)
 		{
-			fvalue dist = eisDistance(data, sweeps[j]);
-			if(dist < config.rangeDistance)
+			std::filesystem::path path = getShardPath(config.saveFileName, i, shards);
+			if(config.format == FORMAT_DATASET)
 			{
-				found = true;
-				break;
+				sweepWriters.push_back(std::make_unique<eis::SweepDatasetWriter>(path, model.getModelStr(),
+					omega, model.getParameterNames()));
 			}
-		}
-		if(!found)
-		{
-			if(indices)
-				indices->push_back(i);
-			sweeps.push_back(data);
-			values.push_back(std::vector<fvalue>());
-			if(config.threaded)
-				model.resolveSteps(i);
-			for(eis::Componant* componant : componants)
+			else
 			{
-				std::vector<eis::Range>& ranges = componant->getParamRanges();
-				for(const eis::Range& range : ranges)
-					values.back().push_back(range.stepValue());
+				sweepWriters.push_back(std::make_unique<eis::NpySweepWriter>(path, model.getModelStr(), omega,
+					model.getParameterNames(), !config.realSpectra, config.format == FORMAT_NPZ));
 			}
 		}
-		if(i % 200 == 0)
-		{
-			eis::Log(eis::Log::INFO, false)<<'.';
-			std::cout<<std::flush;
-		}
 	}
-	eis::Log(eis::Log::INFO, false)<<'\n';
+	else if(writers > 0)
+	{
+		eis::Log(eis::Log::INFO)<<"Saving sweep to "<<config.saveFileName;
+		std::filesystem::create_directory(config.saveFileName);
+	}
 
+	auto start = std::chrono::high_resolution_clock::now();
+
+	std::vector<BoundedQueue<SweepResult>> queues(writers);
+	std::atomic<size_t> next = 0;
+	std::atomic<bool> failed = false;
+
+	std::vector<std::thread> writerThreads;
+	for(size_t i = 0; i < writers; ++i)
+		writerThreads.push_back(std::thread(sweepWriterFn, &config, &queues, i, &sweepWriters, &failed));
+
+	eis::Log(eis::Log::INFO)<<"Calculateing sweeps in "<<generators<<" thread(s) with "<<writers<<" writer(s)";
+
+	std::vector<std::thread> generatorThreads;
+	for(size_t i = 0; i < generators; ++i)
+		generatorThreads.push_back(std::thread(sweepGeneratorFn, &config, model, &plan, &next, count, &queues, &failed));
+
+	for(std::thread& thread : generatorThreads)
+		thread.join();
+	for(BoundedQueue<SweepResult>& queue : queues)
+		queue.close();
+	for(std::thread& thread : writerThreads)
+		thread.join();
+
+	if(failed)
+	{
+		for(std::unique_ptr<eis::SweepWriter>& sweepWriter : sweepWriters)
+			sweepWriter->abort();
+		eis::Log(eis::Log::ERROR)<<"Sweep aborted";
+		return false;
+	}
+
+	for(std::unique_ptr<eis::SweepWriter>& sweepWriter : sweepWriters)
+		sweepWriter->finish();
+
+	auto end = std::chrono::high_resolution_clock::now();
+	auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
+
+	eis::Log(eis::Log::INFO)<<"time taken: "<<duration.count()<<" ms";
+	return true;
+}
+
+static std::vector<std::vector<fvalue>> getRangeValuesForModel(const Config& config, eis::Model& model)
+{
+	// unlike export-ranges, find-range only filters on the spectra and not on the contribution of the elements
+	std::vector<size_t> indices = model.getRecommendedParamIndices(config.omegaRange, config.rangeDistance,
+		config.threaded, config.rangeBudget, false);
+
+	std::vector<std::vector<fvalue>> values;
+	values.reserve(indices.size());
+	for(size_t index : indices)
+	{
+		model.resolveSteps(index);
+		values.push_back(model.getFlatParameters());
+	}
 	return values;
 }
 
@@ -314,7 +450,7 @@ static void findRanges(const Config& config, eis::Model& model)
 
 static void outputRanges(const Config& config, eis::Model& model)
 {
-	std::vector<size_t> indices = model.getRecommendedParamIndices(config.omegaRange, config.rangeDistance, config.threaded);
+	std::vector<size_t> indices = model.getRecommendedParamIndices(config.omegaRange, config.rangeDistance, config.threaded, config.rangeBudget);
 
 	if(indices.empty())
 	{
@@ -326,6 +462,54 @@ static void outputRanges(const Config& config, eis::Model& model)
 		std::cout<<model.getModelStrWithParam(index)<<'\n';
 }
 
+static void fitSpectra(const Config& config, eis::Model& model)
+{
+	std::vector<std::filesystem::path> paths;
+	if(std::filesystem::is_directory(config.fitInput))
+	{
+		for(const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(config.fitInput))
+		{
+			if(entry.is_regular_file())
+				paths.push_back(entry.path());
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+	else
+	{
+		paths.push_back(config.fitInput);
+	}
+
+	std::vector<std::vector<eis::DataPoint>> spectra;
+	spectra.reserve(paths.size());
+	for(const std::filesystem::path& path : paths)
+		spectra.push_back(eis::Spectra::loadFromDisk(path).data);
+
+	if(!config.noCompile)
+		model.compile(config.specialize, true);
+
+	eis::FitOptions options;
+	options.parallel = config.threaded;
+	std::vector<eis::FitResult> results = eis::fit(model, spectra, options);
+
+	std::vector<std::string> names = model.getParameterNames();
+	std::cout<<"file, converged, cost, iterations";
+	for(const std::string& name : names)
+		std::cout<<", "<<name;
+	for(const std::string& name : names)
+		std::cout<<", "<<name<<"_std";
+	std::cout<<'\n';
+
+	for(size_t i = 0; i < results.size(); ++i)
+	{
+		const eis::FitResult& result = results[i];
+		std::cout<<paths[i].string()<<", "<<result.converged<<", "<<result.cost<<", "<<result.iterations;
+		for(fvalue parameter : result.parameters)
+			std::cout<<", "<<parameter;
+		for(size_t j = 0; j < result.parameters.size(); ++j)
+			std::cout<<", "<<std::sqrt(result.covariance[j*result.parameters.size()+j]);
+		std::cout<<'\n';
+	}
+}
 
 std::string translateModelString(const std::string& in, int type)
 {
@@ -359,6 +543,18 @@ int main(int argc, char** argv)
 		return 1;
 	}
 
+	if(config.format == FORMAT_INVALID)
+	{
+		eis::Log(eis::Log::ERROR)<<"Invalid output format specified";
+		return 1;
+	}
+
+	if(config.format != FORMAT_CSV && config.reduce)
+	{
+		eis::Log(eis::Log::ERROR)<<"Binary sweep formats require a fixed number of frequencies and can not be used with --reduce";
+		return 1;
+	}
+
 	if(config.inputType == INPUT_TYPE_UNKOWN)
 	{
 		eis::Log(eis::Log::ERROR)<<"Invalid input type specified";
@@ -399,6 +595,12 @@ int main(int argc, char** argv)
 			return 1;
 		}
 
+		if(config.mode == MODE_FIND_RANGE || config.mode == MODE_OUTPUT_RANGE_DATAPOINTS)
+		{
+			size_t count = model.getRequiredStepsForSweeps();
+			planExecution(config, model, config.rangeBudget > 0 ? std::min(count, config.rangeBudget) : count);
+		}
+
 		if(config.mode == MODE_FIND_RANGE)
 		{
 			findRanges(config, model);
@@ -417,6 +619,15 @@ int main(int argc, char** argv)
 			}
 			std::cout<<code;
 		}
+		else if(config.mode == MODE_FIT)
+		{
+			if(config.fitInput.empty())
+			{
+				eis::Log(eis::Log::ERROR)<<"Fit mode requires a spectrum to be given with --fit-input";
+				return 1;
+			}
+			fitSpectra(config, model);
+		}
 		else if(config.mode == MODE_TORCH_SCRIPT)
 		{
 			std::string code = model.getTorchScript();
@@ -430,7 +641,10 @@ int main(int argc, char** argv)
 		else
 		{
 			if(model.isParamSweep())
-				runParamSweep(config, model);
+			{
+				if(!runParamSweep(config, model))
+					return 1;
+			}
 			else
 				runSweep(config, model);
 		}
@@ -440,6 +654,16 @@ int main(int argc, char** argv)
 		eis::Log(eis::Log::ERROR)<<"Unable to parse model string, "<<ia.what();
 		return 1;
 	}
+	catch(const eis::file_error& err)
+	{
+		eis::Log(eis::Log::ERROR)<<err.what();
+		return 1;
+	}
+	catch(const std::filesystem::filesystem_error& err)
+	{
+		eis::Log(eis::Log::ERROR)<<err.what();
+		return 1;
+	}
 
 	return 0;
 }
@@ -0,0 +1,114 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "mapping.h"
+
+#include <cstring>
+#include <limits>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+bool eis::mapFile(const std::filesystem::path& path, const uint8_t** data, size_t* size, void** mapping)
+{
+	*data = nullptr;
+	*size = 0;
+	*mapping = nullptr;
+#ifdef _WIN32
+	HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER fileSize;
+	GetFileSizeEx(file, &fileSize);
+	*size = fileSize.QuadPart;
+	HANDLE fileMapping = *size > 0 ? CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if(fileMapping)
+	{
+		*data = static_cast<const uint8_t*>(MapViewOfFile(fileMapping, FILE_MAP_READ, 0, 0, 0));
+		*mapping = fileMapping;
+	}
+#else
+	int fd = open(path.string().c_str(), O_RDONLY);
+	if(fd < 0)
+		return false;
+	struct stat statBuf;
+	if(fstat(fd, &statBuf) == 0 && statBuf.st_size > 0)
+	{
+		*size = statBuf.st_size;
+		void* fileData = mmap(nullptr, *size, PROT_READ, MAP_SHARED, fd, 0);
+		if(fileData != MAP_FAILED)
+			*data = static_cast<const uint8_t*>(fileData);
+	}
+	close(fd);
+#endif
+
+	if(!*data)
+	{
+		unmapFile(*data, *size, *mapping);
+		*mapping = nullptr;
+		return false;
+	}
+	return true;
+}
+
+void eis::unmapFile(const uint8_t* data, size_t size, void* mapping)
+{
+#ifdef _WIN32
+	if(data)
+		UnmapViewOfFile(data);
+	if(mapping)
+		CloseHandle(static_cast<HANDLE>(mapping));
+#else
+	if(data)
+		munmap(const_cast<uint8_t*>(data), size);
+#endif
+}
+
+bool eis::regionInMapping(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size)
+{
+	if(offset > size)
+		return false;
+	if(count == 0 || elementSize == 0)
+		return true;
+	if(count > std::numeric_limits<uint64_t>::max()/elementSize)
+		return false;
+	return count*elementSize <= size - offset;
+}
+
+std::vector<std::string> eis::splitStrings(const char* data, size_t length)
+{
+	std::vector<std::string> out;
+	for(size_t i = 0; i < length;)
+	{
+		size_t stringLength = strnlen(data+i, length-i);
+		out.push_back(std::string(data+i, stringLength));
+		i += stringLength+1;
+	}
+	return out;
+}
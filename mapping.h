@@ -0,0 +1,59 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace eis
+{
+
+/**
+* Maps a file read only into memory.
+*
+* @param path The file to map.
+* @param data Is set to the start of the mapping.
+* @param size Is set to the size of the file.
+* @param mapping Is set to the platform handle of the mapping, if any.
+* @return true if the file could be mapped, otherwise false and nothing is left mapped.
+*/
+bool mapFile(const std::filesystem::path& path, const uint8_t** data, size_t* size, void** mapping);
+
+/**
+* Releases a mapping created by mapFile, does nothing if data is nullptr.
+*/
+void unmapFile(const uint8_t* data, size_t size, void* mapping);
+
+/**
+* Checks that a region of count elements of elementSize bytes each starting at offset lies within a mapping of size bytes.
+* The check can not overflow, no matter the values given.
+*/
+bool regionInMapping(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size);
+
+/**
+* Splits a block of consecutive nul terminated strings, the strings never extend past the end of the block.
+*/
+std::vector<std::string> splitStrings(const char* data, size_t length);
+
+}
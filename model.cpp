@@ -30,150 +30,238 @@
 #include <algorithm>
 #include <execution>
 #include <dlfcn.h>
+#include <unistd.h>
 #include <functional>
+#include <bit>
+#include <stdexcept>
+#include <cstdlib>
+#include <cmath>
+#include <map>
+#include <mutex>
+#include <deque>
+#include <chrono>
+#include <limits>
+#include <queue>
 
 #include "componant/componant.h"
 #include "componant/resistor.h"
 #include "strops.h"
 #include "componant/paralellseriel.h"
+#include "componant/network.h"
 #include "log.h"
 #include "normalize.h"
 #include "basicmath.h"
 #include "compile.h"
 #include "compcache.h"
+#include "sampling.h"
+#include "canonical.h"
+#include "exprgraph.h"
+#include "rational.h"
 
 using namespace eis;
 
 
-Componant *Model::processBrackets(std::string& str, size_t& bracketCounter, size_t paramSweepCount, bool defaultToRange)
+std::string Model::parseErrorStr(const std::string& str, size_t pos, const std::string& message)
 {
-	size_t bracketStart = deepestBraket(str);
-	Log(Log::DEBUG)<<str<<" bracket start "<<(bracketStart == std::string::npos ? std::string("npos") :  std::to_string(bracketStart));
-
-	if(bracketStart == std::string::npos)
-	{
-		Componant* componant = processBracket(str, paramSweepCount, defaultToRange);
-		if(!componant)
-			throw parse_errror("can not create componant type B for " + str);
-		return componant;
-	}
-
-	size_t bracketEnd = opposingBraket(str, bracketStart);
-
-	if(bracketEnd == std::string::npos)
-	{
-		return nullptr;
-	}
-
-	std::string bracket = str.substr(bracketStart+1, bracketEnd-1-bracketStart);
-
-	Componant* componant = processBracket(bracket, paramSweepCount, defaultToRange);
-	if(!componant)
-		throw parse_errror("can not create componant type B for " + str);
-	_bracketComponants.push_back(componant);
-
-	str.erase(str.begin()+bracketStart, str.begin()+bracketEnd+1);
-	str.insert(str.begin()+bracketStart, bracketCounter+48);
-	++bracketCounter;
-	return processBrackets(str, bracketCounter, paramSweepCount, defaultToRange);
+	return message + " at position " + std::to_string(pos) + " in model string " + str;
 }
 
-Componant *Model::processBracket(std::string& str, size_t paramSweepCount, bool defaultToRange)
+// serial := parallel ('-' parallel)*
+Componant *Model::parseSerial(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange)
 {
-	Log(Log::DEBUG)<<__func__<<'('<<str<<')';
-	std::vector<std::string> tokens = tokenize(str, '-', '{', '}');
-
 	std::vector<Componant*> nodes;
-
-	for(const std::string& nodeStr : tokens)
+	try
 	{
-		Log(Log::DEBUG)<<__func__<<" full node str: "<<nodeStr;
-		std::vector<Componant*> componants;
-		for(size_t i = 0; i < nodeStr.size(); ++i)
+		while(true)
 		{
-			Log(Log::DEBUG)<<__func__<<" arg: "<<nodeStr[i];
-			if(Componant::isValidComponantChar(nodeStr[i]))
+			if(pos < str.size() && str[pos] == '-')
 			{
-				componants.push_back(Componant::createNewComponant(nodeStr[i], getParamStr(nodeStr, i), paramSweepCount, defaultToRange));
-				i = paramSkipIndex(nodeStr, i);
+				Log(Log::WARN)<<parseErrorStr(str, pos, "empty node");
 			}
 			else
 			{
-				switch(nodeStr[i])
+				nodes.push_back(parseParallel(str, pos, paramSweepCount, defaultToRange));
+				if(!nodes.back())
 				{
-					case '{':
-						i = opposingBraket(nodeStr, i, '}');
-					case '}':
-						Log(Log::WARN)<<getModelStr()<<" stray "<<nodeStr[i]<<" in model string";
-						break;
-					case '0':
-					case '1':
-					case '2':
-					case '3':
-					case '4':
-					case '5':
-					case '6':
-					case '7':
-					case '8':
-					case '9':
-					{
-						size_t j = nodeStr[i]-48;
-						if(_bracketComponants.size() > j)
-							componants.push_back(_bracketComponants[j]);
-						break;
-					}
-					default:
-						Log(Log::DEBUG)<<"Invalid char "<<nodeStr[i]<<" in model string";
-						return nullptr;
+					nodes.pop_back();
+					Log(Log::WARN)<<parseErrorStr(str, pos, "empty node");
 				}
 			}
+
+			if(pos >= str.size() || str[pos] != '-')
+				break;
+			++pos;
 		}
-		if(componants.size() > 1)
-			nodes.push_back(new Parallel(componants));
-		else if(componants.size() == 1)
-			nodes.push_back(componants[0]);
-		else
-			Log(Log::WARN)<<"empty node for "<<nodeStr;
+	}
+	catch(...)
+	{
+		for(Componant* node : nodes)
+			delete node;
+		throw;
 	}
 
 	if(nodes.size() > 1)
 		return new Serial(nodes);
 	else if(nodes.size() == 1)
 		return nodes[0];
-	else
-		return nullptr;
+	return nullptr;
 }
 
-std::string Model::getParamStr(const std::string& str, size_t index)
+// parallel := element element*
+Componant *Model::parseParallel(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange)
 {
-	if(static_cast<int64_t>(str.size())-index < 3 || str[index+1] != '{')
+	std::vector<Componant*> componants;
+	try
 	{
-		Log(Log::WARN)<<"missing parameter string for "<<str[index];
-		return "";
+		while(pos < str.size() && str[pos] != '-' && str[pos] != ')' && str[pos] != ';' && str[pos] != ']')
+			componants.push_back(parseElement(str, pos, paramSweepCount, defaultToRange));
+	}
+	catch(...)
+	{
+		for(Componant* componant : componants)
+			delete componant;
+		throw;
+	}
+
+	if(componants.size() > 1)
+		return new Parallel(componants);
+	else if(componants.size() == 1)
+		return componants[0];
+	return nullptr;
+}
+
+// element := componantChar ['{' parameters '}'] | '(' serial ')' | network
+Componant *Model::parseElement(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange)
+{
+	char ch = str[pos];
+	if(ch == Network::staticGetComponantChar())
+	{
+		return parseNetwork(str, pos, paramSweepCount, defaultToRange);
+	}
+	else if(ch == '(')
+	{
+		size_t start = pos;
+		++pos;
+		Componant* componant = parseSerial(str, pos, paramSweepCount, defaultToRange);
+		if(pos >= str.size() || str[pos] != ')')
+		{
+			delete componant;
+			throw parse_errror(parseErrorStr(str, start, "unmatched ("));
+		}
+		++pos;
+		if(!componant)
+			throw parse_errror(parseErrorStr(str, start, "empty bracket"));
+		return componant;
 	}
+	else if(Componant::isValidComponantChar(ch))
+	{
+		++pos;
+		std::string paramStr;
+		if(pos < str.size() && str[pos] == '{')
+		{
+			size_t end = str.find('}', pos);
+			if(end == std::string::npos)
+				throw parse_errror(parseErrorStr(str, pos, "unmatched {"));
+			paramStr = str.substr(pos+1, end-pos-1);
+			pos = end+1;
+		}
+		else
+		{
+			Log(Log::WARN)<<"missing parameter string for "<<ch;
+		}
+		return Componant::createNewComponant(ch, paramStr, paramSweepCount, defaultToRange);
+	}
+
+	throw parse_errror(parseErrorStr(str, pos, std::string("invalid character ") + ch));
+}
+
+// node numbers are bounded by the element count in Network, this only keeps them within the range of size_t
+static constexpr size_t MAX_NODE_DIGITS = 9;
 
-	size_t end = opposingBraket(str, index, '}');
-	std::string parameterStr = str.substr(index+2, end-index-2);
-	Log(Log::DEBUG)<<"param for "<<str[index]<<' '<<parameterStr;
-	return parameterStr;
+size_t Model::parseNode(const std::string& str, size_t& pos)
+{
+	size_t start = pos;
+	while(pos < str.size() && str[pos] >= '0' && str[pos] <= '9')
+		++pos;
+	if(pos == start)
+		throw parse_errror(parseErrorStr(str, pos, "expected a node number"));
+	if(pos - start > MAX_NODE_DIGITS)
+		throw parse_errror(parseErrorStr(str, start, "node number is too large"));
+	return std::stoul(str.substr(start, pos-start));
 }
 
-size_t Model::paramSkipIndex(const std::string& str, size_t index)
+// network := 'n' '[' branch (';' branch)* ']'
+// branch := node ',' node ':' serial
+Componant *Model::parseNetwork(const std::string& str, size_t& pos, size_t paramSweepCount, bool defaultToRange)
 {
-	if(index+2 > str.size() || str[index+1] != '{')
-		return index;
+	size_t start = pos;
+	++pos;
+	if(pos >= str.size() || str[pos] != '[')
+		throw parse_errror(parseErrorStr(str, pos, "expected [ after network"));
+	++pos;
+
+	std::vector<Componant*> componants;
+	std::vector<std::pair<size_t, size_t>> terminals;
+	try
+	{
+		while(true)
+		{
+			size_t a = parseNode(str, pos);
+			if(pos >= str.size() || str[pos] != ',')
+				throw parse_errror(parseErrorStr(str, pos, "expected , between the nodes of a network element"));
+			++pos;
+			size_t b = parseNode(str, pos);
+			if(pos >= str.size() || str[pos] != ':')
+				throw parse_errror(parseErrorStr(str, pos, "expected : after the nodes of a network element"));
+			++pos;
+
+			Componant* componant = parseSerial(str, pos, paramSweepCount, defaultToRange);
+			if(!componant)
+				throw parse_errror(parseErrorStr(str, pos, "empty network element"));
+			componants.push_back(componant);
+			terminals.push_back({a, b});
+
+			if(pos >= str.size())
+				throw parse_errror(parseErrorStr(str, start, "unmatched ["));
+			if(str[pos] == ']')
+				break;
+			if(str[pos] != ';')
+				throw parse_errror(parseErrorStr(str, pos, "expected ; or ] after network element"));
+			++pos;
+		}
+	}
+	catch(...)
+	{
+		for(Componant* componant : componants)
+			delete componant;
+		throw;
+	}
+	++pos;
 
-	size_t opposing = opposingBraket(str, index, '}');
-	if(opposing != std::string::npos)
-		return opposing;
-	return index;
+	try
+	{
+		return new Network(componants, terminals);
+	}
+	catch(const parse_errror& err)
+	{
+		throw parse_errror(parseErrorStr(str, start, err.what()));
+	}
 }
 
 Model::Model(const std::string& str, size_t paramSweepCount, bool defaultToRange): _modelStr(str)
 {
-	size_t bracketCounter = 0;
-	std::string strCpy(str);
-	_model = processBrackets(strCpy, bracketCounter, paramSweepCount, defaultToRange);
+	size_t pos = 0;
+	_model = parseSerial(str, pos, paramSweepCount, defaultToRange);
+	if(pos < str.size())
+	{
+		delete _model;
+		_model = nullptr;
+		throw parse_errror(parseErrorStr(str, pos, "unmatched )"));
+	}
+	if(!_model)
+		throw parse_errror("can not create a model from an empty model string");
+	updateCanonical();
+	_rational = RationalImpedance::isRational(_model);
 }
 
 Model::Model(const Model& in)
@@ -185,10 +273,19 @@ Model& Model::operator=(const Model& in)
 {
 	delete _model;
 	_modelStr = in._modelStr;
-	_bracketComponants.clear();
 	_flatComponants.clear();
 	_model = Componant::copy(in._model);
 	_compiledModel = in._compiledModel;
+	_specializedModel = in._specializedModel;
+	_specializedParameters = in._specializedParameters;
+	_specializedUuid = in._specializedUuid;
+	_compiledJacobian = in._compiledJacobian;
+	_rangeTables = in._rangeTables;
+	_canonicalModelStr = in._canonicalModelStr;
+	_canonicalParameterMap = in._canonicalParameterMap;
+	_canonicalIdentity = in._canonicalIdentity;
+	_rational = in._rational;
+	_executionPlan = in._executionPlan;
 	return *this;
 }
 
@@ -205,7 +302,7 @@ std::vector<Range> Model::getFlatParameterRanges()
 	out.reserve(getParameterCount());
 	for(Componant* componant : flatComponants)
 	{
-		const std::vector<Range> ranges = componant->getParamRanges();
+		const std::vector<Range> ranges = static_cast<const Componant*>(componant)->getParamRanges();
 		for(const Range& range : ranges)
 			out.push_back(range);
 	}
@@ -214,12 +311,13 @@ std::vector<Range> Model::getFlatParameterRanges()
 
 std::vector<fvalue> Model::getFlatParameters()
 {
-	std::vector<Range> flatRanges = getFlatParameterRanges();
-
 	std::vector<fvalue> out;
-	out.reserve(flatRanges.size());
-	for(const Range& range : flatRanges)
-		out.push_back(range.stepValue());
+	out.reserve(getParameterCount());
+	for(const Componant* componant : getFlatComponants())
+	{
+		std::vector<fvalue> values = componant->getParameterValues();
+		out.insert(out.end(), values.begin(), values.end());
+	}
 	return out;
 }
 
@@ -288,6 +386,14 @@ void Model::addComponantToFlat(Componant* componant, std::vector<Componant*>* fl
 		return;
 	}
 
+	Network* network = dynamic_cast<Network*>(componant);
+	if(network)
+	{
+		for(Componant* element : network->componants)
+			addComponantToFlat(element, flatComponants);
+		return;
+	}
+
 	flatComponants->push_back(componant);
 }
 
@@ -357,33 +463,134 @@ std::vector<DataPoint> Model::executeSweep(const Range& omega, size_t index)
 	return executeSweep(omega.getRangeVector(), index);
 }
 
-std::vector<DataPoint> Model::executeSweep(const std::vector<fvalue>& omega, size_t index)
+std::vector<DataPoint> Model::executeCompiled(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters) const
+{
+	std::vector<fvalue> canonicalParameters = getCanonicalParameters(parameters);
+	std::vector<std::complex<fvalue>> values = getCompiledObject(canonicalParameters)->symbol(canonicalParameters, omega);
+
+	std::vector<DataPoint> results(omega.size());
+	for(size_t i = 0; i < omega.size(); ++i)
+	{
+		results[i].omega = omega[i];
+		results[i].im = values[i];
+	}
+	return results;
+}
+
+std::vector<DataPoint> Model::executeGraph(const FrequencyPlan& omega)
 {
-	std::vector<DataPoint> results;
-	results.reserve(omega.size());
+	std::vector<DataPoint> results = omega.getDataPoints();
+	if(!_model)
+	{
+		Log(Log::WARN)<<"model not ready";
+		return results;
+	}
+
+	std::vector<std::complex<fvalue>> values(omega.size());
+	std::vector<fvalue> parameters = _rational ? getFlatParameters() : std::vector<fvalue>();
+	bool positive = std::all_of(parameters.begin(), parameters.end(), [](fvalue value){return value > 0 && std::isfinite(value);});
 
+	// circuits of only resistors, capacitors and inductors are reduced to a rational function once per parameter set
+	if(_rational && positive)
+		RationalImpedance(_model, parameters).evaluate(omega.getOmega(), values.data());
+	else
+		_model->execute(omega, values.data());
+	for(size_t i = 0; i < values.size(); ++i)
+		results[i].im = values[i];
+	return results;
+}
+
+std::vector<DataPoint> Model::executeSweep(const std::vector<fvalue>& omega, size_t index)
+{
+	// the compiled kernel derives everything it needs from omega itself, so building a plan would be wasted work
 	if(_compiledModel)
 	{
 		resolveSteps(index);
-		std::vector<fvalue> parameters = getFlatParameters();
-		std::vector<std::complex<fvalue>> values = _compiledModel->symbol(parameters, omega);
-		for(size_t i = 0; i < omega.size(); ++i)
-		{
-			DataPoint dataPoint;
-			dataPoint.omega = omega[i];
-			dataPoint.im = values[i];
-			results.push_back(dataPoint);
-		}
+		return executeCompiled(omega, getFlatParameters());
 	}
-	else
+	return executeSweep(FrequencyPlan(omega), index);
+}
+
+std::vector<DataPoint> Model::executeSweep(const FrequencyPlan& omega, size_t index)
+{
+	resolveSteps(index);
+	if(_compiledModel)
+		return executeCompiled(omega.getOmega(), getFlatParameters());
+	return executeGraph(omega);
+}
+
+std::vector<DataPoint> Model::executeAdaptiveSweep(const Range& omega, size_t index, fvalue tolerance)
+{
+	struct Interval
 	{
-		for(size_t i = 0; i < omega.size(); ++i)
+		DataPoint left;
+		DataPoint right;
+		fvalue error;
+	};
+
+	const size_t maxPoints = std::max<size_t>(omega.count, 2);
+	Range coarse = omega;
+	coarse.count = std::min<size_t>(maxPoints, 9);
+	std::vector<DataPoint> data = executeSweep(coarse.getRangeVector(), index);
+
+	fvalue scale = 0;
+	for(const DataPoint& point : data)
+		scale = std::max(scale, std::abs(point.im));
+	const fvalue stepTolerance = std::sqrt(tolerance);
+
+	std::vector<Interval> candidates;
+	for(size_t i = 0; i+1 < data.size(); ++i)
+		candidates.push_back({data[i], data[i+1], std::numeric_limits<fvalue>::max()});
+
+	// every interval is probed at its midpoint, if linear interpolation between its ends misses the probe by more than
+	// tolerance or the impedance steps by more than the square root of tolerance, relative to the largest impedance,
+	// both halves become candidates for refinement in the next pass
+	while(!candidates.empty() && data.size() < maxPoints)
+	{
+		if(data.size() + candidates.size() > maxPoints)
+		{
+			std::sort(candidates.begin(), candidates.end(), [](const Interval& a, const Interval& b){return a.error > b.error;});
+			candidates.resize(maxPoints - data.size());
+		}
+
+		std::vector<fvalue> mids;
+		mids.reserve(candidates.size());
+		for(const Interval& interval : candidates)
+		{
+			fvalue a = interval.left.omega;
+			fvalue b = interval.right.omega;
+			mids.push_back(omega.log && a > 0 ? std::sqrt(a*b) : (a+b)/2);
+		}
+		std::vector<DataPoint> probes = executeSweep(mids, index);
+
+		for(const DataPoint& probe : probes)
+			scale = std::max(scale, std::abs(probe.im));
+		if(scale == 0)
+			scale = 1;
+
+		std::vector<Interval> next;
+		for(size_t i = 0; i < candidates.size(); ++i)
 		{
-			fvalue omegaStep = omega[i];
-			results.push_back(execute(omegaStep, index));
+			const Interval& interval = candidates[i];
+			const DataPoint& probe = probes[i];
+			data.push_back(probe);
+
+			fvalue span = interval.right.omega - interval.left.omega;
+			std::complex<fvalue> interpolated = interval.left.im +
+				(interval.right.im - interval.left.im)*((probe.omega - interval.left.omega)/span);
+			fvalue error = std::abs(probe.im - interpolated)/scale;
+			fvalue step = std::abs(interval.right.im - interval.left.im)/scale;
+			if((error > tolerance || step > stepTolerance) && span > interval.left.omega*1e-5f)
+			{
+				next.push_back({interval.left, probe, error});
+				next.push_back({probe, interval.right, error});
+			}
 		}
+		candidates = std::move(next);
 	}
-	return results;
+
+	std::sort(data.begin(), data.end(), [](const DataPoint& a, const DataPoint& b){return a.omega < b.omega;});
+	return data;
 }
 
 std::vector<std::vector<DataPoint>> Model::executeSweeps(const Range& omega, const std::vector<size_t>& indecies, bool parallel)
@@ -392,6 +599,11 @@ std::vector<std::vector<DataPoint>> Model::executeSweeps(const Range& omega, con
 }
 
 std::vector<std::vector<DataPoint>> Model::executeSweeps(const std::vector<fvalue>& omega, const std::vector<size_t>& indecies, bool parallel)
+{
+	return executeSweeps(FrequencyPlan(omega), indecies, parallel);
+}
+
+std::vector<std::vector<DataPoint>> Model::executeSweeps(const FrequencyPlan& omega, const std::vector<size_t>& indecies, bool parallel)
 {
 	unsigned int threadsCount = parallel ? std::thread::hardware_concurrency() : 1;
 
@@ -408,7 +620,7 @@ std::vector<std::vector<DataPoint>> Model::executeSweeps(const std::vector<fvalu
 	{
 		size_t start = i*countPerThread;
 		size_t stop = i < threadsCount-1 ? (i+1)*countPerThread : indecies.size();
-		threads[i] = std::thread(sweepThreadFn, &data, &models[i], start, stop, omega);
+		threads[i] = std::thread(sweepThreadFn, &data, &models[i], start, stop, std::cref(omega), &indecies);
 	}
 	for(size_t i = 0; i < threadsCount; ++i)
 		threads[i].join();
@@ -416,11 +628,12 @@ std::vector<std::vector<DataPoint>> Model::executeSweeps(const std::vector<fvalu
 	return data;
 }
 
-void Model::sweepThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop, const std::vector<fvalue>& omega)
+void Model::sweepThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+                          const FrequencyPlan& omega, const std::vector<size_t>* indecies)
 {
 	for(size_t i = start; i < stop; ++i)
 	{
-		data->at(i) = model->executeSweep(omega, i);
+		data->at(i) = model->executeSweep(omega, indecies ? (*indecies)[i] : i);
 	}
 }
 
@@ -435,80 +648,256 @@ std::vector<std::vector<DataPoint>> Model::executeAllSweeps(const Range& omega)
 	std::vector<Model> models(threadsCount, *this);
 
 	std::vector<std::vector<DataPoint>> data(count);
+	FrequencyPlan plan(omega);
 
 	for(size_t i = 0; i < threadsCount; ++i)
 	{
 		size_t start = i*countPerThread;
 		size_t stop = i < threadsCount-1 ? (i+1)*countPerThread : count;
-		threads[i] = std::thread(sweepThreadFn, &data, &models[i], start, stop, omega.getRangeVector());
+		threads[i] = std::thread(sweepThreadFn, &data, &models[i], start, stop, std::cref(plan), nullptr);
 	}
 	for(size_t i = 0; i < threadsCount; ++i)
 		threads[i].join();
 	return data;
 }
 
-void Model::resolveSteps(int64_t index)
+std::vector<fvalue> Model::getSampleParameters(size_t index, size_t count, SamplingMode mode, uint64_t seed)
+{
+	std::vector<Range> ranges = getFlatParameterRanges();
+
+	std::vector<fvalue> out;
+	out.reserve(ranges.size());
+	size_t dimension = 0;
+	for(const Range& range : ranges)
+	{
+		if(range.count < 2)
+		{
+			out.push_back(range[0]);
+			continue;
+		}
+
+		double unit;
+		switch(mode)
+		{
+			case SAMPLE_LATIN_HYPERCUBE:
+				unit = latinHypercubeUnit(seed, index, dimension, count);
+				break;
+			case SAMPLE_SOBOL:
+				unit = sobolUnit(seed, index, dimension);
+				break;
+			case SAMPLE_UNIFORM:
+			case SAMPLE_LOG_UNIFORM:
+			default:
+				unit = uniformUnit(seed, index, dimension);
+				break;
+		}
+
+		bool logScale = mode == SAMPLE_LOG_UNIFORM || (mode != SAMPLE_UNIFORM && range.log);
+		if(logScale && range.start > 0 && range.end > 0)
+		{
+			double start = std::log10(range.start);
+			out.push_back(std::pow(10.0, start + unit*(std::log10(range.end) - start)));
+		}
+		else
+		{
+			out.push_back(range.start + unit*(range.end - range.start));
+		}
+		++dimension;
+	}
+	return out;
+}
+
+std::vector<DataPoint> Model::executeParameters(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters)
+{
+	if(_compiledModel && parameters.size() == getParameterCount())
+		return executeCompiled(omega, parameters);
+	return executeParameters(FrequencyPlan(omega), parameters);
+}
+
+std::vector<DataPoint> Model::executeParameters(const FrequencyPlan& omega, const std::vector<fvalue>& parameters)
 {
+	if(parameters.size() != getParameterCount())
+	{
+		throw std::invalid_argument("Model " + getModelStr() + " requires " + std::to_string(getParameterCount()) +
+			" parameters but " + std::to_string(parameters.size()) + " where given");
+	}
+
+	if(_compiledModel)
+		return executeCompiled(omega.getOmega(), parameters);
+
 	std::vector<Componant*> componants = getFlatComponants();
-	if(index == 0)
+	std::vector<std::vector<Range>> sweepRanges;
+	sweepRanges.reserve(componants.size());
+
+	size_t parameter = 0;
+	for(Componant* componant : componants)
 	{
-		for(Componant* componant : componants)
+		sweepRanges.push_back(componant->getParamRanges());
+		for(Range& range : componant->getParamRanges())
 		{
-			for(Range& range :  componant->getParamRanges())
-				range.step = 0;
+			range = Range(parameters[parameter], parameters[parameter], 1);
+			++parameter;
 		}
-		return;
 	}
 
-	std::vector<Range*> flatRanges;
+	std::vector<DataPoint> results = executeGraph(omega);
+
+	for(size_t i = 0; i < componants.size(); ++i)
+		componants[i]->getParamRanges() = sweepRanges[i];
+	return results;
+}
+
+std::vector<DataPoint> Model::executeJacobian(const std::vector<fvalue>& omega, const std::vector<fvalue>& parameters,
+                                              std::vector<std::complex<fvalue>>& jacobian)
+{
+	const size_t parameterCount = getParameterCount();
+	if(parameters.size() != parameterCount)
+	{
+		throw std::invalid_argument("Model " + getModelStr() + " requires " + std::to_string(parameterCount) +
+			" parameters but " + std::to_string(parameters.size()) + " where given");
+	}
+
+	std::vector<DataPoint> results(omega.size());
+	jacobian.resize(omega.size()*parameterCount);
+
+	if(_compiledJacobian)
+	{
+		// every parameter is summed into exactly one canonical parameter, so it shares the derivative of that parameter
+		std::vector<size_t> canonicalIndex(parameterCount);
+		for(size_t i = 0; i < _canonicalParameterMap.size(); ++i)
+		{
+			for(size_t source : _canonicalParameterMap[i])
+				canonicalIndex[source] = i;
+		}
+
+		std::vector<fvalue> canonicalParameters = getCanonicalParameters(parameters);
+		std::vector<std::complex<fvalue>> values = _compiledJacobian->symbol(canonicalParameters, omega);
+		const size_t stride = canonicalParameters.size()+1;
+		for(size_t i = 0; i < omega.size(); ++i)
+		{
+			results[i].omega = omega[i];
+			results[i].im = values[i*stride];
+			for(size_t j = 0; j < parameterCount; ++j)
+				jacobian[i*parameterCount+j] = values[i*stride+1+canonicalIndex[j]];
+		}
+		return results;
+	}
+
+	std::vector<Componant*> componants = getFlatComponants();
+	std::vector<std::vector<Range>> sweepRanges;
+	sweepRanges.reserve(componants.size());
 
+	size_t parameter = 0;
 	for(Componant* componant : componants)
 	{
-		for(Range& range :  componant->getParamRanges())
-			flatRanges.push_back(&range);
+		sweepRanges.push_back(componant->getParamRanges());
+		for(Range& range : componant->getParamRanges())
+		{
+			range = Range(parameters[parameter], parameters[parameter], 1);
+			++parameter;
+		}
+	}
+
+	for(size_t i = 0; i < omega.size(); ++i)
+	{
+		results[i].omega = omega[i];
+		results[i].im = _model->executeJacobian(omega[i], jacobian.data()+i*parameterCount);
+	}
+
+	for(size_t i = 0; i < componants.size(); ++i)
+		componants[i]->getParamRanges() = sweepRanges[i];
+	return results;
+}
+
+std::vector<std::vector<DataPoint>> Model::executeParameterSweeps(const std::vector<fvalue>& omega,
+                                                                 const std::vector<std::vector<fvalue>>& parameters, bool parallel)
+{
+	unsigned int threadsCount = parallel ? std::thread::hardware_concurrency() : 1;
+
+	if(parameters.size() < threadsCount*10)
+		threadsCount = 1;
+
+	for(const std::vector<fvalue>& row : parameters)
+	{
+		if(row.size() != getParameterCount())
+		{
+			throw std::invalid_argument("Model " + getModelStr() + " requires " + std::to_string(getParameterCount()) +
+				" parameters but a row with " + std::to_string(row.size()) + " where given");
+		}
+	}
+
+	size_t countPerThread = parameters.size()/threadsCount;
+	std::vector<std::thread> threads(threadsCount);
+	std::vector<Model> models(threadsCount, *this);
+
+	std::vector<std::vector<DataPoint>> data(parameters.size());
+	FrequencyPlan plan(omega);
+
+	for(size_t i = 0; i < threadsCount; ++i)
+	{
+		size_t start = i*countPerThread;
+		size_t stop = i < threadsCount-1 ? (i+1)*countPerThread : parameters.size();
+		threads[i] = std::thread(parameterThreadFn, &data, &models[i], start, stop, std::cref(plan), std::cref(parameters));
 	}
+	for(size_t i = 0; i < threadsCount; ++i)
+		threads[i].join();
+
+	return data;
+}
 
-	std::vector<size_t> placeMagnitude;
-	placeMagnitude.reserve(flatRanges.size());
+void Model::parameterThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+                              const FrequencyPlan& omega, const std::vector<std::vector<fvalue>>& parameters)
+{
+	for(size_t i = start; i < stop; ++i)
+		data->at(i) = model->executeParameters(omega, parameters[i]);
+}
 
-	//Log(Log::DEBUG)<<"Magnitudes:";
-	for(size_t i = 0; i < flatRanges.size(); ++i)
+void Model::setFlatParameters(const std::vector<fvalue>& parameters)
+{
+	if(parameters.size() != getParameterCount())
 	{
-		size_t magnitude = 1;
-		for(int64_t j = static_cast<int64_t>(i)-1; j >= 0; --j)
-			magnitude = magnitude*flatRanges[j]->count;
-		placeMagnitude.push_back(magnitude);
-		//Log(Log::DEBUG)<<placeMagnitude.back();
+		throw std::invalid_argument("Model " + getModelStr() + " requires " + std::to_string(getParameterCount()) +
+			" parameters but " + std::to_string(parameters.size()) + " where given");
 	}
 
-	//Log(Log::DEBUG)<<"Steps for index "<<index<<" ranges "<<flatRanges.size()<<" Ranges:";
-	for(int64_t i = flatRanges.size()-1; i >= 0; --i)
+	size_t parameter = 0;
+	for(Componant* componant : getFlatComponants())
 	{
-		flatRanges[i]->step = index/placeMagnitude[i];
-		index = index % placeMagnitude[i];
-		//Log(Log::DEBUG)<<placeMagnitude[i]<<'('<<flatRanges[i]->step<<')'<<(i == 0 ? "" : " + ");
+		for(Range& range : componant->getParamRanges())
+		{
+			range = Range(parameters[parameter], parameters[parameter], 1);
+			++parameter;
+		}
 	}
 }
 
-size_t Model::getRequiredStepsForSweeps()
+static bool parseParameterValues(const std::string& str, size_t start, size_t end, std::vector<Range>& ranges)
 {
-	size_t stepsRequired = 1;
-	std::vector<Componant*> componants = getFlatComponants();
-	for(Componant* componant : componants)
+	const char* pos = str.c_str()+start;
+	const char* endPos = str.c_str()+end;
+	while(pos < endPos)
 	{
-		std::vector<Range> ranges = componant->getParamRanges();
-		for(const Range& range : ranges)
-			stepsRequired *= range.count;
+		char* valueEnd;
+		fvalue value = std::strtof(pos, &valueEnd);
+		if(valueEnd == pos || valueEnd > endPos)
+			return false;
+		ranges.push_back(Range(value, value, 1));
+		pos = valueEnd;
+		while(pos < endPos && *pos == ' ')
+			++pos;
+		if(pos < endPos && *pos != ',')
+			return false;
+		++pos;
 	}
-	return stepsRequired;
+	return true;
 }
 
-std::string Model::getModelStr() const
+static std::string stripParameterStrings(const std::string& str)
 {
 	std::string output;
-	output.reserve(_modelStr.size());
+	output.reserve(str.size());
 	int bracket = 0;
-	for(const char c : _modelStr)
+	for(const char c : str)
 	{
 		if(c == '{')
 			++bracket;
@@ -519,102 +908,494 @@ std::string Model::getModelStr() const
 		{
 			--bracket;
 			if(bracket < 0)
-				return _modelStr;
+				return str;
 		}
 	}
 	return output;
 }
 
-std::string Model::getModelStrWithParam(size_t index)
+void Model::bindParameters(const std::string& str)
 {
-	if(!_model)
-		return "";
-	resolveSteps(index);
-	std::string out = _model->getComponantString();
-	eisRemoveUnneededBrackets(out);
-	return out;
-}
+	std::vector<Componant*> componants = getFlatComponants();
+	std::vector<std::vector<Range>> bound;
+	bound.reserve(componants.size());
 
-std::string Model::getModelStrWithParam() const
-{
-	if(!_model)
-		return "";
-	std::string out = _model->getComponantString(false);
-	eisRemoveUnneededBrackets(out);
-	return out;
-}
+	for(size_t i = 0; i < str.size(); ++i)
+	{
+		if(str[i] == '{' || str[i] == '}')
+			throw parse_errror(parseErrorStr(str, i, std::string("stray ") + str[i]));
+		if(!Componant::isValidComponantChar(str[i]))
+			continue;
 
-bool Model::isReady()
-{
-	return _model;
-}
+		if(bound.size() >= componants.size() || componants[bound.size()]->getComponantChar() != str[i])
+			throw parse_errror(parseErrorStr(str, i, "topology dose not match model " + getModelStr()));
+
+		Componant* componant = componants[bound.size()];
+		if(i+1 >= str.size() || str[i+1] != '{')
+		{
+			bound.push_back(componant->getParamRanges());
+			continue;
+		}
+
+		size_t end = str.find('}', i+1);
+		if(end == std::string::npos)
+			throw parse_errror(parseErrorStr(str, i+1, "unmatched {"));
+
+		std::vector<Range> ranges;
+		if(!parseParameterValues(str, i+2, end, ranges))
+		{
+			size_t count = componant->getParamRanges().empty() ? 1 : componant->getParamRanges()[0].count;
+			ranges = Range::rangesFromParamString(str.substr(i+2, end-i-2), count);
+		}
+		if(ranges.size() != componant->paramCount())
+			throw parse_errror(parseErrorStr(str, i, "wrong number of parameters for " + componant->componantName()));
+
+		bound.push_back(ranges);
+		i = end;
+	}
+
+	if(bound.size() != componants.size())
+		throw parse_errror(parseErrorStr(str, str.size(), "topology dose not match model " + getModelStr()));
+
+	// the elements match, the structure must match as well, either as written or as returned by getModelStrWithParam
+	std::string topology = stripParameterStrings(str);
+	if(topology != getModelStr() && topology != stripParameterStrings(getModelStrWithParam()))
+		throw parse_errror(parseErrorStr(str, 0, "topology dose not match model " + getModelStr()));
+
+	for(size_t i = 0; i < componants.size(); ++i)
+		componants[i]->getParamRanges() = bound[i];
+}
+
+std::vector<std::vector<DataPoint>> Model::executeSamples(const Range& omega, size_t count, SamplingMode mode, uint64_t seed, bool parallel)
+{
+	return executeSamples(omega.getRangeVector(), count, mode, seed, parallel);
+}
+
+std::vector<std::vector<DataPoint>> Model::executeSamples(const std::vector<fvalue>& omega, size_t count, SamplingMode mode, uint64_t seed, bool parallel)
+{
+	unsigned int threadsCount = parallel ? std::thread::hardware_concurrency() : 1;
+
+	if(count < threadsCount*10)
+		threadsCount = 1;
+
+	size_t countPerThread = count/threadsCount;
+	std::vector<std::thread> threads(threadsCount);
+	std::vector<Model> models(threadsCount, *this);
+
+	std::vector<std::vector<DataPoint>> data(count);
+	FrequencyPlan plan(omega);
+
+	for(size_t i = 0; i < threadsCount; ++i)
+	{
+		size_t start = i*countPerThread;
+		size_t stop = i < threadsCount-1 ? (i+1)*countPerThread : count;
+		threads[i] = std::thread(sampleThreadFn, &data, &models[i], start, stop, std::cref(plan), count, mode, seed);
+	}
+	for(size_t i = 0; i < threadsCount; ++i)
+		threads[i].join();
+
+	return data;
+}
+
+void Model::sampleThreadFn(std::vector<std::vector<DataPoint>>* data, Model* model, size_t start, size_t stop,
+                           const FrequencyPlan& omega, size_t count, int mode, uint64_t seed)
+{
+	for(size_t i = start; i < stop; ++i)
+	{
+		std::vector<fvalue> parameters = model->getSampleParameters(i, count, static_cast<SamplingMode>(mode), seed);
+		data->at(i) = model->executeParameters(omega, parameters);
+	}
+}
+
+const std::vector<fvalue>& Model::getRangeTable(size_t index, const Range& range)
+{
+	if(_rangeTables.size() <= index)
+		_rangeTables.resize(index+1);
+
+	std::pair<Range, std::vector<fvalue>>& table = _rangeTables[index];
+	if(table.second.size() != range.count || table.first.start != range.start ||
+		table.first.end != range.end || table.first.log != range.log)
+	{
+		table.first = range;
+		table.second = range.getRangeVector();
+	}
+	return table.second;
+}
+
+void Model::resolveSteps(int64_t index)
+{
+	std::vector<Componant*> componants = getFlatComponants();
+	std::vector<Range*> flatRanges;
+
+	for(Componant* componant : componants)
+	{
+		for(Range& range :  componant->getParamRanges())
+			flatRanges.push_back(&range);
+	}
+
+	if(index == 0)
+	{
+		for(Range* range : flatRanges)
+			range->step = 0;
+	}
+	else
+	{
+		std::vector<size_t> placeMagnitude;
+		placeMagnitude.reserve(flatRanges.size());
+
+		//Log(Log::DEBUG)<<"Magnitudes:";
+		for(size_t i = 0; i < flatRanges.size(); ++i)
+		{
+			size_t magnitude = 1;
+			for(int64_t j = static_cast<int64_t>(i)-1; j >= 0; --j)
+				magnitude = magnitude*flatRanges[j]->count;
+			placeMagnitude.push_back(magnitude);
+			//Log(Log::DEBUG)<<placeMagnitude.back();
+		}
+
+		//Log(Log::DEBUG)<<"Steps for index "<<index<<" ranges "<<flatRanges.size()<<" Ranges:";
+		for(int64_t i = flatRanges.size()-1; i >= 0; --i)
+		{
+			flatRanges[i]->step = index/placeMagnitude[i];
+			index = index % placeMagnitude[i];
+			//Log(Log::DEBUG)<<placeMagnitude[i]<<'('<<flatRanges[i]->step<<')'<<(i == 0 ? "" : " + ");
+		}
+	}
+
+	// the values of the ranges are materialized once so that log ranges dont recompute a power on every access
+	size_t rangeIndex = 0;
+	std::vector<fvalue> values;
+	for(Componant* componant : componants)
+	{
+		values.clear();
+		for(const Range& range : componant->getParamRanges())
+		{
+			const std::vector<fvalue>& table = getRangeTable(rangeIndex, range);
+			values.push_back(range.step < table.size() ? table[range.step] : range.stepValue());
+			++rangeIndex;
+		}
+		componant->setResolvedParameters(values);
+	}
+}
+
+size_t Model::getRequiredStepsForSweeps()
+{
+	size_t stepsRequired = 1;
+	std::vector<Componant*> componants = getFlatComponants();
+	for(Componant* componant : componants)
+	{
+		std::vector<Range> ranges = componant->getParamRanges();
+		for(const Range& range : ranges)
+			stepsRequired *= range.count;
+	}
+	return stepsRequired;
+}
+
+std::string Model::getModelStr() const
+{
+	return stripParameterStrings(_modelStr);
+}
+
+std::string Model::getModelStrWithParam(size_t index)
+{
+	if(!_model)
+		return "";
+	resolveSteps(index);
+	std::string out = _model->getComponantString();
+	eisRemoveUnneededBrackets(out);
+	return out;
+}
+
+std::string Model::getModelStrWithParam() const
+{
+	if(!_model)
+		return "";
+	std::string out = _model->getComponantString(false);
+	eisRemoveUnneededBrackets(out);
+	return out;
+}
+
+bool Model::isReady()
+{
+	return _model;
+}
 
 bool Model::isParamSweep()
 {
 	return getRequiredStepsForSweeps() > 1;
 }
 
-std::vector<size_t> Model::getRecommendedParamIndices(eis::Range omegaRange, double distance, bool threaded)
+static bool isInterestingSpectrum(const std::vector<eis::DataPoint>& data, size_t index)
 {
-	std::vector<std::vector<eis::DataPoint>> sweeps;
-	size_t count = getRequiredStepsForSweeps();
-	eis::Log(eis::Log::INFO)<<"Executeing "<<count<<" steps";
-	std::vector<std::vector<eis::DataPoint>> allSweeps;
-	std::vector<size_t> indices;
+	fvalue maxJump =  maximumNyquistJump(data);
+	if(maxJump > 0.30)
+	{
+		eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<index
+			<<" is not well centered: "<<maxJump;
+		return false;
+	}
+
+	fvalue correlation = std::abs(pearsonCorrelation(data));
+	if(correlation > 0.8)
+	{
+		eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<index
+			<<" as data is too linear: "<<correlation;
+		return false;
+	}
+	return true;
+}
 
+static bool isNewSpectrum(const std::vector<eis::DataPoint>& data, const std::vector<std::vector<eis::DataPoint>>& sweeps,
+                          double distance, bool threaded)
+{
+	std::vector<std::vector<eis::DataPoint>>::const_iterator search;
 	if(threaded)
-		allSweeps = executeAllSweeps(omegaRange);
+	{
+		search = std::find_if(std::execution::par, sweeps.begin(), sweeps.end(),
+						[distance, &data](const std::vector<eis::DataPoint>& a){return distance > eisDistance(data, a);});
+	}
+	else
+	{
+		search = std::find_if(std::execution::seq, sweeps.begin(), sweeps.end(),
+						[distance, &data](const std::vector<eis::DataPoint>& a){return distance > eisDistance(data, a);});
+	}
+	return search == sweeps.end();
+}
 
-	for(size_t i = 0; i < count; ++i)
+namespace
+{
+
+// A hyper-rectangle of the sweep grid, spanning [lower, upper] steps in every swept parameter.
+struct SweepCell
+{
+	std::vector<size_t> lower;
+	std::vector<size_t> upper;
+	std::vector<size_t> faces;
+	size_t center;
+	double spread;
+	size_t splitDimension;
+
+	bool operator<(const SweepCell& other) const
 	{
-		std::vector<eis::DataPoint> data;
-		if(threaded)
-			data = allSweeps[i];
-		else
-			data = executeSweep(omegaRange, i);
-		normalize(data);
+		return spread < other.spread;
+	}
+};
+
+struct SweepSample
+{
+	std::vector<DataPoint> data;
+	bool interesting;
+};
+
+}
 
-		fvalue maxJump =  maximumNyquistJump(data);
-		if(maxJump > 0.30)
+std::map<size_t, std::vector<DataPoint>> Model::getAdaptiveSweepSamples(const FrequencyPlan& omega, double distance,
+                                                                      size_t budget, bool threaded)
+{
+	std::vector<Range> ranges = getFlatParameterRanges();
+	std::vector<size_t> magnitudes;
+	std::vector<size_t> counts;
+	size_t magnitude = 1;
+	for(const Range& range : ranges)
+	{
+		if(range.count > 1)
 		{
-			eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<i
-				<<" is not well centered: "<<maxJump;
-			continue;
+			magnitudes.push_back(magnitude);
+			counts.push_back(range.count);
 		}
+		magnitude *= std::max<size_t>(range.count, 1);
+	}
 
-		fvalue correlation = std::abs(pearsonCorrelation(data));
-		if(correlation > 0.8)
+	std::map<size_t, SweepSample> samples;
+	auto evaluate = [this, &samples, &omega, threaded](const std::vector<size_t>& indices)
+	{
+		std::vector<size_t> missing;
+		for(size_t index : indices)
 		{
-			eis::Log(eis::Log::DEBUG)<<"skipping output for step "<<i
-				<<" as data is too linear: "<<correlation;
-			continue;
+			if(samples.find(index) == samples.end() && std::find(missing.begin(), missing.end(), index) == missing.end())
+				missing.push_back(index);
 		}
 
-		std::vector<std::vector<eis::DataPoint>>::iterator search;
+		std::vector<std::vector<DataPoint>> data;
 		if(threaded)
 		{
-			search = std::find_if(std::execution::par, sweeps.begin(), sweeps.end(),
-							[distance, &data](std::vector<eis::DataPoint>& a){return distance > eisDistance(data, a);});
+			data = executeSweeps(omega, missing, true);
 		}
 		else
 		{
-			search = std::find_if(std::execution::seq, sweeps.begin(), sweeps.end(),
-							[distance, &data](std::vector<eis::DataPoint>& a){return distance > eisDistance(data, a);});
+			data.reserve(missing.size());
+			for(size_t index : missing)
+				data.push_back(executeSweep(omega, index));
 		}
-		if(search == sweeps.end())
+
+		for(size_t i = 0; i < missing.size(); ++i)
 		{
-			indices.push_back(i);
-			sweeps.push_back(data);
-			if(threaded)
-				resolveSteps(i);
+			normalize(data[i]);
+			bool interesting = isInterestingSpectrum(data[i], missing[i]);
+			samples[missing[i]] = {std::move(data[i]), interesting};
 		}
-		if(i % 200 == 0)
+	};
+
+	// every cell is sampled at its center and at the centers of its faces, the distance between opposing faces gives the
+	// sensitivity of the spectrum to each parameter within the cell, cells are bisected along their most sensitive parameter
+	auto makeCell = [&](const std::vector<size_t>& lower, const std::vector<size_t>& upper) -> SweepCell
+	{
+		SweepCell cell;
+		cell.lower = lower;
+		cell.upper = upper;
+		size_t center = 0;
+		for(size_t i = 0; i < counts.size(); ++i)
+			center += (lower[i] + upper[i])/2*magnitudes[i];
+		cell.center = center;
+		for(size_t i = 0; i < counts.size(); ++i)
 		{
-			eis::Log(eis::Log::INFO, false)<<'.';
-			std::cout<<std::flush;
+			size_t offset = (lower[i] + upper[i])/2*magnitudes[i];
+			cell.faces.push_back(center - offset + lower[i]*magnitudes[i]);
+			cell.faces.push_back(center - offset + upper[i]*magnitudes[i]);
+		}
+		cell.spread = 0;
+		cell.splitDimension = counts.size();
+		return cell;
+	};
+
+	auto rateCell = [&](SweepCell& cell)
+	{
+		bool interesting = samples[cell.center].interesting;
+		for(size_t index : cell.faces)
+			interesting = interesting || samples[index].interesting;
+
+		for(size_t i = 0; i < counts.size() && interesting; ++i)
+		{
+			if(cell.upper[i] - cell.lower[i] < 2)
+				continue;
+			double spread = eisDistance(samples[cell.faces[i*2]].data, samples[cell.faces[i*2+1]].data);
+			if(spread > cell.spread)
+			{
+				cell.spread = spread;
+				cell.splitDimension = i;
+			}
+		}
+	};
+
+	// the children of several cells are evaluated together so that executeSweeps has enough steps to spread over all cores
+	size_t roundCells = threaded ? std::max(1u, std::thread::hardware_concurrency()) : 1;
+	size_t samplesPerCell = 2*counts.size()+1;
+
+	std::vector<size_t> lower(counts.size(), 0);
+	std::vector<size_t> upper(counts.size());
+	for(size_t i = 0; i < counts.size(); ++i)
+		upper[i] = counts[i]-1;
+
+	std::priority_queue<SweepCell> cells;
+	std::vector<SweepCell> round = {makeCell(lower, upper)};
+	while(!round.empty())
+	{
+		std::vector<size_t> indices;
+		for(const SweepCell& cell : round)
+		{
+			indices.push_back(cell.center);
+			indices.insert(indices.end(), cell.faces.begin(), cell.faces.end());
+		}
+		evaluate(indices);
+		for(SweepCell& cell : round)
+		{
+			rateCell(cell);
+			cells.push(std::move(cell));
+		}
+		round.clear();
+
+		size_t planned = samples.size();
+		while(!cells.empty() && round.size() < roundCells*2 && planned < budget)
+		{
+			SweepCell cell = cells.top();
+			cells.pop();
+			if(cell.spread <= distance || cell.splitDimension >= counts.size())
+				continue;
+
+			size_t dimension = cell.splitDimension;
+			size_t mid = (cell.lower[dimension] + cell.upper[dimension])/2;
+			std::vector<size_t> childUpper = cell.upper;
+			childUpper[dimension] = mid;
+			std::vector<size_t> childLower = cell.lower;
+			childLower[dimension] = mid;
+			round.push_back(makeCell(cell.lower, childUpper));
+			round.push_back(makeCell(childLower, cell.upper));
+			planned += samplesPerCell*2;
 		}
 	}
 
+	Log(Log::INFO)<<"Evaluated "<<samples.size()<<" of "<<getRequiredStepsForSweeps()<<" steps";
+
+	std::map<size_t, std::vector<DataPoint>> out;
+	for(std::pair<const size_t, SweepSample>& sample : samples)
+	{
+		if(sample.second.interesting)
+			out[sample.first] = std::move(sample.second.data);
+	}
+	return out;
+}
+
+std::vector<size_t> Model::getRecommendedParamIndices(eis::Range omegaRange, double distance, bool threaded, size_t budget,
+                                                      bool filterElements)
+{
+	std::vector<std::vector<eis::DataPoint>> sweeps;
+	size_t count = getRequiredStepsForSweeps();
+	std::vector<size_t> indices;
+
+	if(budget > 0 && budget < count)
+	{
+		eis::Log(eis::Log::INFO)<<"Adaptively executeing at most "<<budget<<" of "<<count<<" steps";
+		std::map<size_t, std::vector<DataPoint>> samples = getAdaptiveSweepSamples(FrequencyPlan(omegaRange), distance, budget, threaded);
+		for(std::pair<const size_t, std::vector<DataPoint>>& sample : samples)
+		{
+			if(isNewSpectrum(sample.second, sweeps, distance, threaded))
+			{
+				indices.push_back(sample.first);
+				sweeps.push_back(std::move(sample.second));
+			}
+		}
+	}
+	else
+	{
+		eis::Log(eis::Log::INFO)<<"Executeing "<<count<<" steps";
+		std::vector<std::vector<eis::DataPoint>> allSweeps;
+
+		if(threaded)
+			allSweeps = executeAllSweeps(omegaRange);
+
+		for(size_t i = 0; i < count; ++i)
+		{
+			std::vector<eis::DataPoint> data;
+			if(threaded)
+				data = allSweeps[i];
+			else
+				data = executeSweep(omegaRange, i);
+			normalize(data);
+
+			if(!isInterestingSpectrum(data, i))
+				continue;
+
+			if(isNewSpectrum(data, sweeps, distance, threaded))
+			{
+				indices.push_back(i);
+				sweeps.push_back(data);
+				if(threaded)
+					resolveSteps(i);
+			}
+			if(i % 200 == 0)
+			{
+				eis::Log(eis::Log::INFO, false)<<'.';
+				std::cout<<std::flush;
+			}
+		}
+	}
+
+	if(!filterElements)
+	{
+		eis::Log(eis::Log::INFO, false)<<'\n';
+		return indices;
+	}
+
 	std::vector<size_t> out;
 	out.reserve(indices.size());
 	for(size_t candidate : indices)
@@ -633,12 +1414,117 @@ std::vector<size_t> Model::getRecommendedParamIndices(eis::Range omegaRange, dou
 	return out;
 }
 
+void Model::updateCanonical()
+{
+	CanonicalNode canonical = canonicalize(_model);
+	_canonicalModelStr = canonical.str;
+	_canonicalParameterMap = eis::getCanonicalParameterMap(canonical);
+
+	_canonicalIdentity = true;
+	for(size_t i = 0; i < _canonicalParameterMap.size(); ++i)
+	{
+		if(_canonicalParameterMap[i].size() != 1 || _canonicalParameterMap[i][0] != i)
+			_canonicalIdentity = false;
+	}
+}
+
+std::string Model::getCanonicalModelStr() const
+{
+	return _canonicalModelStr;
+}
+
+std::vector<fvalue> Model::getCanonicalParameters(const std::vector<fvalue>& parameters) const
+{
+	if(_canonicalIdentity)
+		return parameters;
+
+	std::vector<fvalue> out(_canonicalParameterMap.size(), 0);
+	for(size_t i = 0; i < _canonicalParameterMap.size(); ++i)
+	{
+		for(size_t source : _canonicalParameterMap[i])
+			out[i] += parameters[source];
+	}
+	return out;
+}
+
+const std::vector<std::vector<size_t>>& Model::getCanonicalParameterMap() const
+{
+	return _canonicalParameterMap;
+}
+
 size_t Model::getUuid() const
 {
-	return std::hash<std::string>{}(getModelStr());
+	return std::hash<std::string>{}(_canonicalModelStr);
 }
 
-bool Model::compile()
+size_t Model::getJacobianUuid() const
+{
+	return std::hash<std::string>{}(_canonicalModelStr + ";jacobian");
+}
+
+CompiledObject* Model::loadCompiled(size_t uuid, const std::string& code, const std::string& symbolName)
+{
+	CompCache* cache = CompCache::getInstance();
+
+	CompiledObject* compiled = cache->getObject(uuid);
+	if(compiled)
+		return compiled;
+
+	// the object is tagged with the hash of its code so that objects in a temporary directory shared by
+	// several hosts or versions of eisgenerator are only reused if they where built from the same code
+	std::filesystem::path path = std::filesystem::path(getTempdir())/
+		(std::to_string(uuid) + "_" + std::to_string(std::hash<std::string>{}(code)) + ".so");
+	if(!std::filesystem::is_regular_file(path))
+	{
+		std::filesystem::path tempPath = path;
+		tempPath += "." + std::to_string(getpid()) + "_" + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+		int ret = compile_code(code, tempPath.string());
+		if(ret != 0)
+		{
+			std::error_code ec;
+			std::filesystem::remove(tempPath, ec);
+			return nullptr;
+		}
+		std::error_code ec;
+		std::filesystem::rename(tempPath, path, ec);
+		if(ec)
+		{
+			Log(Log::WARN)<<"Unable to move compiled model to "<<path<<": "<<ec.message();
+			std::filesystem::remove(tempPath, ec);
+			return nullptr;
+		}
+	}
+
+	CompiledObject object;
+	object.objectCode = dlopen(path.string().c_str(), RTLD_NOW);
+	if(!object.objectCode)
+		throw std::runtime_error("Unable to dlopen compiled model " + std::string(dlerror()));
+
+	object.symbol =
+		reinterpret_cast<std::vector<std::complex<fvalue>>(*)(const std::vector<fvalue>&, const std::vector<fvalue>&)>
+			(dlsym(object.objectCode, symbolName.c_str()));
+
+	if(!object.symbol)
+		throw std::runtime_error(path.string() + " dosent have a symbol " + symbolName);
+
+	cache->addObject(uuid, object);
+	return cache->getObject(uuid);
+}
+
+const CompiledObject* Model::getCompiledObject(const std::vector<fvalue>& canonicalParameters) const
+{
+	if(!_specializedModel)
+		return _compiledModel;
+
+	for(const std::pair<size_t, fvalue>& parameter : _specializedParameters)
+	{
+		if(canonicalParameters[parameter.first] != parameter.second)
+			return _compiledModel;
+	}
+	return _specializedModel;
+}
+
+bool Model::compile(bool specialize, bool jacobian)
 {
 	if(!_model->compileable())
 	{
@@ -647,65 +1533,331 @@ bool Model::compile()
 		return false;
 	}
 
-	CompCache* cache = CompCache::getInstance();
+	_specializedModel = nullptr;
+	_specializedParameters.clear();
+	_specializedUuid = 0;
 
-	_compiledModel = cache->getObject(getUuid());
+	// the kernel is compiled for the canonical form so that it can be shared by all equivalent models
+	_compiledModel = CompCache::getInstance()->getObject(getUuid());
 	if(!_compiledModel)
 	{
-		std::filesystem::path tmp = getTempdir();
-		size_t uuid = getUuid();
-
-		std::filesystem::path path = tmp/(std::to_string(getUuid())+".so");
-		int ret = compile_code(getCode(), path.string());
-		if(ret != 0)
+		_compiledModel = loadCompiled(getUuid(), getKernelCode(), getCompiledFunctionName());
+		if(!_compiledModel)
 		{
 			Log(Log::WARN)<<"Unable to compile model!! expect performance degredation";
 			return false;
 		}
+	}
+
+	if(specialize && !compileSpecialized())
+		Log(Log::WARN)<<"Unable to compile a specialized kernel for "<<getModelStr()<<", using the generic kernel";
 
-		CompiledObject object;
-		object.objectCode = dlopen(path.string().c_str(), RTLD_NOW);
-		if(!object.objectCode)
-			throw std::runtime_error("Unable to dlopen compiled model " + std::string(dlerror()));
+	if(jacobian && !compileJacobian())
+		Log(Log::WARN)<<"Unable to compile a jacobian kernel for "<<getModelStr()<<", the jacobian will be computed uncompiled";
 
-		std::string symbolName = getCompiledFunctionName();
-		object.symbol =
-			reinterpret_cast<std::vector<std::complex<fvalue>>(*)(const std::vector<fvalue>&, const std::vector<fvalue>&)>
-				(dlsym(object.objectCode, symbolName.c_str()));
+	return true;
+}
 
-		if(!object.symbol)
-			throw std::runtime_error(path.string() + " dosent have a symbol " + symbolName);
+bool Model::compileSpecialized()
+{
+	std::vector<Componant*> componants = getFlatComponants();
+	std::vector<fvalue> values;
+	std::vector<bool> fixed;
+	for(Componant* componant : componants)
+	{
+		for(const Range& range : componant->getParamRanges())
+		{
+			values.push_back(range.start);
+			fixed.push_back(range.count < 2);
+		}
+	}
+
+	// a canonical parameter is fixed only if all parameters that are summed into it are fixed
+	std::vector<fvalue> canonicalValues = getCanonicalParameters(values);
+	std::vector<std::pair<size_t, fvalue>> specialized;
+	for(size_t i = 0; i < _canonicalParameterMap.size(); ++i)
+	{
+		bool canonicalFixed = true;
+		for(size_t source : _canonicalParameterMap[i])
+			canonicalFixed = canonicalFixed && fixed[source];
+		if(canonicalFixed)
+			specialized.push_back({i, canonicalValues[i]});
+	}
+
+	if(specialized.empty())
+		return false;
+
+	std::string key = _canonicalModelStr;
+	for(const std::pair<size_t, fvalue>& parameter : specialized)
+		key.append(";" + std::to_string(parameter.first) + "=" + std::to_string(std::bit_cast<uint32_t>(parameter.second)));
+	size_t uuid = std::hash<std::string>{}(key);
+	std::string functionName = "model_" + std::to_string(uuid);
+
+	CompiledObject* compiled = CompCache::getInstance()->getObject(uuid);
+	if(!compiled)
+	{
+		Componant* canonical = createCanonicalComponant(canonicalize(_model));
+		ExprGraph graph;
+		for(const std::pair<size_t, fvalue>& parameter : specialized)
+			graph.fixParameter(parameter.first, parameter.second);
+		ExprGraph::Expr root = canonical->getExpression(graph);
+		delete canonical;
+		if(root == ExprGraph::INVALID)
+			return false;
 
-		cache->addObject(uuid, object);
-		_compiledModel = cache->getObject(uuid);
+		compiled = loadCompiled(uuid, graph.getCode(root, functionName), functionName);
+		if(!compiled)
+			return false;
 	}
 
+	_specializedModel = compiled;
+	_specializedParameters = specialized;
+	_specializedUuid = uuid;
 	return true;
 }
 
+bool Model::compileJacobian()
+{
+	size_t uuid = getJacobianUuid();
+	_compiledJacobian = CompCache::getInstance()->getObject(uuid);
+	if(_compiledJacobian)
+		return true;
+
+	std::string code = getJacobianCode();
+	if(code.empty())
+		return false;
+
+	_compiledJacobian = loadCompiled(uuid, code, getCompiledFunctionName() + "_jacobian");
+	return _compiledJacobian;
+}
+
+size_t Model::getSpecializedUuid() const
+{
+	return _specializedUuid;
+}
+
 void Model::dropCompiled()
 {
 	_compiledModel = nullptr;
+	_specializedModel = nullptr;
+	_specializedParameters.clear();
+	_specializedUuid = 0;
+	_compiledJacobian = nullptr;
+}
+
+// work below this many evaluations is never worth measureing or compileing for
+static constexpr size_t PLANNER_MIN_EVALUATIONS = 20000;
+static constexpr size_t PLANNER_MAX_DECISIONS = 1000;
+
+namespace
+{
+
+// what the planner has learned about compileing in this process, the initial guesses are typical of a small model
+struct PlannerStatistics
+{
+	std::mutex mutex;
+	double compileTime = 1.0;
+	double speedup = 10;
+	size_t compilations = 0;
+	std::deque<Model::ExecutionPlan> decisions;
+};
+
+}
+
+static PlannerStatistics& getPlannerStatistics()
+{
+	static PlannerStatistics statistics;
+	return statistics;
+}
+
+// measures the evaluations per second of fn, repeating it until at least a millisecond has passed
+static double measureThroughput(const std::function<void()>& fn, size_t evaluations)
+{
+	size_t repetitions = 0;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	std::chrono::duration<double> elapsed;
+	do
+	{
+		fn();
+		++repetitions;
+		elapsed = std::chrono::steady_clock::now() - start;
+	} while(elapsed.count() < 1e-3 && repetitions < 100);
+	return repetitions*evaluations/std::max(elapsed.count(), 1e-9);
+}
+
+Model::ExecutionPlan Model::planExecution(size_t omegaCount, size_t steps, bool specialize)
+{
+	PlannerStatistics& statistics = getPlannerStatistics();
+	ExecutionPlan plan;
+	plan.model = getModelStr();
+	plan.evaluations = (steps == 0 ? getRequiredStepsForSweeps() : steps)*std::max<size_t>(omegaCount, 1);
+	{
+		std::lock_guard<std::mutex> lock(statistics.mutex);
+		plan.compileTime = statistics.compileTime;
+	}
+
+	FrequencyPlan omega(Range(1, 1e6, std::max<size_t>(omegaCount, 1), true));
+	plan.cached = _compiledModel || CompCache::getInstance()->getObject(getUuid());
+
+	if(!_model || !_model->compileable())
+	{
+		plan.backend = BACKEND_GRAPH;
+		plan.reason = "the model contains elements that can not be compiled";
+	}
+	else if(plan.cached)
+	{
+		if(_compiledModel || compile(specialize))
+		{
+			plan.backend = BACKEND_COMPILED;
+			plan.compileTime = 0;
+			plan.reason = "a compiled kernel is already available";
+		}
+		else
+		{
+			plan.reason = "the cached kernel could not be loaded";
+		}
+	}
+	else if(plan.evaluations < PLANNER_MIN_EVALUATIONS)
+	{
+		plan.backend = BACKEND_GRAPH;
+		plan.reason = "too little work to amortize compileing";
+	}
+	else
+	{
+		double speedup;
+		{
+			std::lock_guard<std::mutex> lock(statistics.mutex);
+			speedup = statistics.speedup;
+		}
+
+		plan.graphThroughput = measureThroughput([this, &omega](){executeGraph(omega);}, omega.size());
+		double graphTime = plan.evaluations/plan.graphThroughput;
+		double compiledTime = plan.compileTime + plan.evaluations/(plan.graphThroughput*speedup);
+
+		if(compiledTime >= graphTime)
+		{
+			plan.backend = BACKEND_GRAPH;
+			plan.reason = "expected to take " + std::to_string(graphTime) + "s uncompiled while compileing takes " +
+				std::to_string(plan.compileTime) + "s";
+		}
+		else
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			bool compiled = compile(specialize);
+			plan.compileTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			if(!compiled)
+			{
+				plan.backend = BACKEND_GRAPH;
+				plan.reason = "compileing failed";
+			}
+			else
+			{
+				std::vector<fvalue> parameters = getFlatParameters();
+				plan.compiledThroughput = measureThroughput([this, &omega, &parameters](){executeCompiled(omega.getOmega(), parameters);},
+					omega.size());
+
+				std::lock_guard<std::mutex> lock(statistics.mutex);
+				// running means, so that later plans in this process are based on what was actually observed
+				++statistics.compilations;
+				statistics.compileTime += (plan.compileTime - statistics.compileTime)/statistics.compilations;
+				statistics.speedup += (plan.compiledThroughput/plan.graphThroughput - statistics.speedup)/statistics.compilations;
+
+				if(plan.compiledThroughput < plan.graphThroughput)
+				{
+					dropCompiled();
+					plan.backend = BACKEND_GRAPH;
+					plan.reason = "the compiled kernel is slower than the graph";
+				}
+				else
+				{
+					plan.backend = BACKEND_COMPILED;
+					plan.reason = "expected to take " + std::to_string(graphTime) + "s uncompiled but " +
+						std::to_string(compiledTime) + "s including compileing";
+				}
+			}
+		}
+	}
+
+	Log(Log::DEBUG)<<"Execution plan for "<<plan.model<<": "<<(plan.backend == BACKEND_COMPILED ? "compiled" : "graph")
+		<<" as "<<plan.reason;
+
+	{
+		std::lock_guard<std::mutex> lock(statistics.mutex);
+		statistics.decisions.push_back(plan);
+		if(statistics.decisions.size() > PLANNER_MAX_DECISIONS)
+			statistics.decisions.pop_front();
+	}
+	_executionPlan = plan;
+	return plan;
+}
+
+const Model::ExecutionPlan& Model::getExecutionPlan() const
+{
+	return _executionPlan;
+}
+
+std::vector<Model::ExecutionPlan> Model::getExecutionDecisions()
+{
+	PlannerStatistics& statistics = getPlannerStatistics();
+	std::lock_guard<std::mutex> lock(statistics.mutex);
+	return std::vector<ExecutionPlan>(statistics.decisions.begin(), statistics.decisions.end());
 }
 
 std::string Model::getCode()
+{
+	if(!_model || !_model->compileable())
+		return "";
+	return getCodeForComponant(_model, getCompiledFunctionName());
+}
+
+std::string Model::getKernelCode()
 {
 	if(!_model || !_model->compileable())
 		return "";
 
+	Componant* canonical = createCanonicalComponant(canonicalize(_model));
+	std::string code = getCodeForComponant(canonical, getCompiledFunctionName());
+	delete canonical;
+	return code;
+}
+
+std::string Model::getJacobianCode()
+{
+	if(!_model)
+		return "";
+
+	Componant* canonical = createCanonicalComponant(canonicalize(_model));
+	ExprGraph graph;
+	ExprGraph::Expr root = canonical->getExpression(graph);
+	delete canonical;
+	if(root == ExprGraph::INVALID)
+		return "";
+	return graph.getJacobianCode(root, getCompiledFunctionName() + "_jacobian");
+}
+
+std::string Model::getCodeForComponant(Componant* componant, const std::string& functionName)
+{
+	ExprGraph graph;
+	ExprGraph::Expr root = componant->getExpression(graph);
+	if(root != ExprGraph::INVALID)
+		return graph.getCode(root, functionName);
+
 	std::vector<std::string> parameters;
-	std::string formular = _model->getCode(parameters);
+	std::string formular = componant->getCode(parameters);
 
 	std::string out =
 	"#include <cmath>\n"
 	"#include <cassert>\n"
 	"#include <vector>\n"
 	"#include <complex>\n\n"
-	"typedef float fvalue;\n\n"
+	"typedef float fvalue;\n\n";
+	out.append(KERNEL_ATTRIBUTE_CODE);
+	out.append(
 	"extern \"C\"\n{\n\n"
-	"std::vector<std::complex<fvalue>> ";
-	out.append(getCompiledFunctionName());
-	out.append("(const std::vector<fvalue>& parameters, const std::vector<fvalue> omegas)\n{\n\tassert(parameters.size() == ");
+	"EIS_KERNEL std::vector<std::complex<fvalue>> ");
+	out.append(functionName);
+	out.append("(const std::vector<fvalue>& parameters, const std::vector<fvalue>& omegas)\n{\n\tassert(parameters.size() == ");
 	out.append(std::to_string(parameters.size()));
 	out.append(");\n\n");
 	out.append("\tstd::vector<std::complex<fvalue>> out(omegas.size());\n");
@@ -728,6 +1880,8 @@ std::string Model::getTorchScript()
 
 	std::vector<std::string> parameters;
 	std::string formular = _model->getTorchScript(parameters);
+	if(formular.empty())
+		return "";
 
 	std::stringstream out;
 	out<<"def "<<getCompiledFunctionName()<<"(parameters: torch.Tensor, omegas: torch.Tensor) -> torch.Tensor:\n";
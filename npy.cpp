@@ -0,0 +1,538 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+#include "npy.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <iterator>
+#include <limits>
+#include <type_traits>
+
+#include "log.h"
+
+using namespace eis;
+
+static_assert(std::is_same<fvalue, float>::value, "the npy writer requires fvalue to be float");
+
+static constexpr char NPY_MAGIC[] = "\x93NUMPY";
+static constexpr size_t NPY_PREAMBLE_SIZE = 10;
+static constexpr size_t NPY_ALIGNMENT = 64;
+
+static const char* const NPZ_MEMBERS[] = {"spectra.npy", "omega.npy", "parameters.npy", "indices.npy", "model.json"};
+
+static uint32_t crc32(uint32_t crc, const char* data, size_t size)
+{
+	static std::array<uint32_t, 256> table = []()
+	{
+		std::array<uint32_t, 256> out;
+		for(uint32_t i = 0; i < 256; ++i)
+		{
+			uint32_t value = i;
+			for(int j = 0; j < 8; ++j)
+				value = value & 1 ? 0xEDB88320 ^ (value >> 1) : value >> 1;
+			out[i] = value;
+		}
+		return out;
+	}();
+
+	crc = ~crc;
+	for(size_t i = 0; i < size; ++i)
+		crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+	return ~crc;
+}
+
+static uint32_t gf2MatrixTimes(const uint32_t* matrix, uint32_t vector)
+{
+	uint32_t sum = 0;
+	for(; vector; vector >>= 1, ++matrix)
+	{
+		if(vector & 1)
+			sum ^= *matrix;
+	}
+	return sum;
+}
+
+static void gf2MatrixSquare(uint32_t* square, const uint32_t* matrix)
+{
+	for(size_t i = 0; i < 32; ++i)
+		square[i] = gf2MatrixTimes(matrix, matrix[i]);
+}
+
+// gives the crc of the concatenation of a and b from the crcs of both as done by zlib's crc32_combine,
+// this allows the crc of an array to be computed as it is streamed even though its header is only final once it is complete
+static uint32_t crc32Combine(uint32_t crcA, uint32_t crcB, uint64_t lengthB)
+{
+	if(lengthB == 0)
+		return crcA;
+
+	uint32_t even[32];
+	uint32_t odd[32];
+	odd[0] = 0xEDB88320;
+	uint32_t row = 1;
+	for(size_t i = 1; i < 32; ++i)
+	{
+		odd[i] = row;
+		row <<= 1;
+	}
+	gf2MatrixSquare(even, odd);
+	gf2MatrixSquare(odd, even);
+
+	while(true)
+	{
+		gf2MatrixSquare(even, odd);
+		if(lengthB & 1)
+			crcA = gf2MatrixTimes(even, crcA);
+		lengthB >>= 1;
+		if(lengthB == 0)
+			break;
+
+		gf2MatrixSquare(odd, even);
+		if(lengthB & 1)
+			crcA = gf2MatrixTimes(odd, crcA);
+		lengthB >>= 1;
+		if(lengthB == 0)
+			break;
+	}
+	return crcA ^ crcB;
+}
+
+std::string NpyArrayWriter::getHeader(size_t rows) const
+{
+	std::string shape = "(" + std::to_string(rows) + ",";
+	for(size_t dim : _rowShape)
+		shape.append(" " + std::to_string(dim) + ",");
+	if(!_rowShape.empty())
+		shape.pop_back();
+	shape.push_back(')');
+
+	std::string dict = "{'descr': '" + _descr + "', 'fortran_order': False, 'shape': " + shape + ", }";
+
+	// the header is sized for the largest possible row count so that it can be rewritten in place by finish
+	size_t maxDictSize = dict.size() - std::to_string(rows).size() + std::to_string(std::numeric_limits<uint64_t>::max()).size();
+	size_t totalSize = (NPY_PREAMBLE_SIZE + maxDictSize + 1 + NPY_ALIGNMENT - 1)/NPY_ALIGNMENT*NPY_ALIGNMENT;
+	dict.append(totalSize - NPY_PREAMBLE_SIZE - dict.size() - 1, ' ');
+	dict.push_back('\n');
+
+	uint16_t headerLength = dict.size();
+	std::string out(NPY_MAGIC, sizeof(NPY_MAGIC)-1);
+	out.push_back(1);
+	out.push_back(0);
+	out.push_back(static_cast<char>(headerLength & 0xff));
+	out.push_back(static_cast<char>(headerLength >> 8));
+	out.append(dict);
+	return out;
+}
+
+NpyArrayWriter::NpyArrayWriter(const std::filesystem::path& path, const std::string& descr, size_t elementSize,
+                               const std::vector<size_t>& rowShape, size_t chunkSize):
+_file(&_ownedFile), _start(0), _path(path), _rowShape(rowShape), _rowSize(elementSize), _descr(descr)
+{
+	for(size_t dim : _rowShape)
+		_rowSize *= dim;
+	_chunkSize = std::max(chunkSize/std::max<size_t>(_rowSize, 1), static_cast<size_t>(1))*_rowSize;
+	_chunk.reserve(_chunkSize);
+
+	_ownedFile.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!_ownedFile.is_open())
+		throw file_error("Unable to open " + path.string() + " for writing");
+	std::string header = getHeader(0);
+	_file->write(header.data(), header.size());
+}
+
+NpyArrayWriter::NpyArrayWriter(std::ostream& stream, const std::string& descr, size_t elementSize,
+                               const std::vector<size_t>& rowShape, size_t chunkSize):
+_file(&stream), _start(stream.tellp()), _path("stream"), _rowShape(rowShape), _rowSize(elementSize), _descr(descr)
+{
+	for(size_t dim : _rowShape)
+		_rowSize *= dim;
+	_chunkSize = std::max(chunkSize/std::max<size_t>(_rowSize, 1), static_cast<size_t>(1))*_rowSize;
+	_chunk.reserve(_chunkSize);
+
+	std::string header = getHeader(0);
+	_file->write(header.data(), header.size());
+	if(!_file->good())
+		throw file_error("Unable to write npy header");
+}
+
+NpyArrayWriter::~NpyArrayWriter()
+{
+	try
+	{
+		finish();
+	}
+	catch(const file_error& err)
+	{
+		Log(Log::ERROR)<<err.what();
+	}
+}
+
+void NpyArrayWriter::flush()
+{
+	_dataCrc = crc32(_dataCrc, _chunk.data(), _chunk.size());
+	_file->write(_chunk.data(), _chunk.size());
+	_chunk.clear();
+}
+
+void NpyArrayWriter::append(const void* row)
+{
+	const char* data = static_cast<const char*>(row);
+	_chunk.insert(_chunk.end(), data, data+_rowSize);
+	++_rows;
+	if(_chunk.size() >= _chunkSize)
+		flush();
+}
+
+void NpyArrayWriter::finish()
+{
+	if(_finished)
+		return;
+	_finished = true;
+
+	flush();
+	uint64_t end = _file->tellp();
+	std::string header = getHeader(_rows);
+	_file->seekp(_start);
+	_file->write(header.data(), header.size());
+	_file->seekp(end);
+	bool good = _file->good();
+	if(_file == &_ownedFile)
+		_ownedFile.close();
+	if(!good)
+		throw file_error("Unable to write " + _path.string());
+}
+
+void NpyArrayWriter::abort()
+{
+	if(_finished)
+		return;
+	_finished = true;
+
+	_chunk.clear();
+	if(_file == &_ownedFile)
+		_ownedFile.close();
+}
+
+uint64_t NpyArrayWriter::byteSize() const
+{
+	return getHeader(_rows).size() + static_cast<uint64_t>(_rows)*_rowSize;
+}
+
+uint32_t NpyArrayWriter::crc() const
+{
+	std::string header = getHeader(_rows);
+	return crc32Combine(crc32(0, header.data(), header.size()), _dataCrc, static_cast<uint64_t>(_rows)*_rowSize);
+}
+
+size_t NpyArrayWriter::size() const
+{
+	return _rows;
+}
+
+static std::string jsonEscape(const std::string& in)
+{
+	std::string out;
+	for(char ch : in)
+	{
+		if(ch == '"' || ch == '\\')
+			out.push_back('\\');
+		out.push_back(ch);
+	}
+	return out;
+}
+
+template<typename T> static void writeLe(std::ostream& stream, T value)
+{
+	for(size_t i = 0; i < sizeof(T); ++i)
+		stream.put(static_cast<char>((static_cast<uint64_t>(value) >> (i*8)) & 0xff));
+}
+
+struct ZipEntry
+{
+	std::string name;
+	uint64_t size;
+	uint64_t offset;
+	uint32_t crc;
+};
+
+static constexpr uint64_t ZIP32_MAX = 0xFFFFFFFF;
+static constexpr uint16_t ZIP_VERSION = 45;
+static constexpr uint16_t ZIP_DATE = (0 << 9) | (1 << 5) | 1;
+
+// the zip64 extra field is written if requested or if the size requires it, it allows the header to be rewritten in place
+// once the final size of an entry that is streamed into the archive is known
+static void writeLocalHeader(std::ostream& zip, const ZipEntry& entry, bool zip64)
+{
+	zip64 = zip64 || entry.size >= ZIP32_MAX;
+	writeLe<uint32_t>(zip, 0x04034b50);
+	writeLe<uint16_t>(zip, ZIP_VERSION);
+	writeLe<uint16_t>(zip, 0);
+	writeLe<uint16_t>(zip, 0);
+	writeLe<uint16_t>(zip, 0);
+	writeLe<uint16_t>(zip, ZIP_DATE);
+	writeLe<uint32_t>(zip, entry.crc);
+	writeLe<uint32_t>(zip, zip64 ? ZIP32_MAX : entry.size);
+	writeLe<uint32_t>(zip, zip64 ? ZIP32_MAX : entry.size);
+	writeLe<uint16_t>(zip, entry.name.size());
+	writeLe<uint16_t>(zip, zip64 ? 20 : 0);
+	zip.write(entry.name.data(), entry.name.size());
+	if(zip64)
+	{
+		writeLe<uint16_t>(zip, 0x0001);
+		writeLe<uint16_t>(zip, 16);
+		writeLe<uint64_t>(zip, entry.size);
+		writeLe<uint64_t>(zip, entry.size);
+	}
+}
+
+NpySweepWriter::NpySweepWriter(const std::filesystem::path& path, const std::string& model, const std::vector<fvalue>& omega,
+                               const std::vector<std::string>& parameterNames, bool complex, bool npz):
+_path(path), _npz(npz), _omegaCount(omega.size()), _parameterCount(parameterNames.size())
+{
+	_directory = npz ? std::filesystem::path(path.string() + ".tmp") : path;
+	std::filesystem::create_directories(_directory);
+	if(!std::filesystem::is_directory(_directory))
+		throw file_error("Unable to create directory " + _directory.string());
+
+	std::string spectraDescr = complex ? "<c8" : "<f4";
+	size_t spectraElementSize = complex ? sizeof(float)*2 : sizeof(float);
+	std::vector<size_t> spectraShape = complex ? std::vector<size_t>({_omegaCount}) : std::vector<size_t>({_omegaCount, 2});
+	if(npz)
+	{
+		// the spectra make up nearly all of the data, thus they are streamed directly into the archive as its first member
+		_zip.open(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+		if(!_zip.is_open())
+			throw file_error("Unable to open " + path.string() + " for writing");
+		_spectraEntryOffset = _zip.tellp();
+		writeLocalHeader(_zip, {NPZ_MEMBERS[0], 0, _spectraEntryOffset, 0}, true);
+		_spectra = std::make_unique<NpyArrayWriter>(_zip, spectraDescr, spectraElementSize, spectraShape);
+	}
+	else
+	{
+		_spectra = std::make_unique<NpyArrayWriter>(_directory/NPZ_MEMBERS[0], spectraDescr, spectraElementSize, spectraShape);
+	}
+	_parameters = std::make_unique<NpyArrayWriter>(_directory/"parameters.npy", "<f4", sizeof(float), std::vector<size_t>({_parameterCount}));
+	_indices = std::make_unique<NpyArrayWriter>(_directory/"indices.npy", "<u8", sizeof(uint64_t));
+
+	NpyArrayWriter omegaWriter(_directory/"omega.npy", "<f4", sizeof(float));
+	for(const fvalue& value : omega)
+		omegaWriter.append(&value);
+	omegaWriter.finish();
+
+	std::ofstream json(_directory/"model.json", std::ios_base::out | std::ios_base::trunc);
+	if(!json.is_open())
+		throw file_error("Unable to open " + (_directory/"model.json").string() + " for writing");
+	json<<"{\"model\": \""<<jsonEscape(model)<<"\", \"parameters\": [";
+	for(size_t i = 0; i < parameterNames.size(); ++i)
+		json<<(i == 0 ? "" : ", ")<<'"'<<jsonEscape(parameterNames[i])<<'"';
+	json<<"]}\n";
+}
+
+NpySweepWriter::~NpySweepWriter()
+{
+	abort();
+}
+
+void NpySweepWriter::append(const std::vector<eis::DataPoint>& data, const std::vector<fvalue>& parameters, size_t index)
+{
+	if(data.size() != _omegaCount || parameters.size() != _parameterCount)
+	{
+		throw file_error("Spectrum of size " + std::to_string(data.size()) + " with " + std::to_string(parameters.size()) +
+			" parameters dosent fit " + _path.string());
+	}
+
+	_buffer.resize(_omegaCount*2);
+	for(size_t i = 0; i < data.size(); ++i)
+	{
+		_buffer[i*2] = data[i].im.real();
+		_buffer[i*2+1] = data[i].im.imag();
+	}
+
+	uint64_t index64 = index;
+	_spectra->append(_buffer.data());
+	_parameters->append(parameters.data());
+	_indices->append(&index64);
+}
+
+void NpySweepWriter::finish()
+{
+	if(_finished)
+		return;
+	_finished = true;
+
+	_spectra->finish();
+	_parameters->finish();
+	_indices->finish();
+
+	if(_npz)
+	{
+		writeNpz();
+		std::filesystem::remove_all(_directory);
+	}
+}
+
+void NpySweepWriter::abort()
+{
+	if(_finished)
+		return;
+	_finished = true;
+
+	_spectra->abort();
+	_parameters->abort();
+	_indices->abort();
+
+	// only the files written by this writer are removed, as the directory of a npy sweep may have existed before
+	std::error_code ec;
+	for(const char* member : NPZ_MEMBERS)
+		std::filesystem::remove(_directory/member, ec);
+	std::filesystem::remove(_directory, ec);
+	if(_npz)
+	{
+		_zip.close();
+		std::filesystem::remove(_path, ec);
+	}
+}
+
+size_t NpySweepWriter::size() const
+{
+	return _spectra->size();
+}
+
+// completes the archive the spectra were streamed into by appending the remaining arrays using the store method and the
+// central directory, zip64 extensions are used where sizes require them
+void NpySweepWriter::writeNpz()
+{
+	std::ofstream& zip = _zip;
+
+	std::vector<ZipEntry> entries;
+	ZipEntry spectraEntry = {NPZ_MEMBERS[0], _spectra->byteSize(), _spectraEntryOffset, _spectra->crc()};
+	uint64_t end = zip.tellp();
+	zip.seekp(spectraEntry.offset);
+	writeLocalHeader(zip, spectraEntry, true);
+	zip.seekp(end);
+	entries.push_back(spectraEntry);
+
+	std::vector<char> buffer(1 << 20);
+	for(size_t i = 1; i < std::size(NPZ_MEMBERS); ++i)
+	{
+		std::filesystem::path memberPath = _directory/NPZ_MEMBERS[i];
+		std::ifstream file(memberPath, std::ios_base::in | std::ios_base::binary);
+		if(!file.is_open())
+			throw file_error("Unable to open " + memberPath.string());
+
+		ZipEntry entry;
+		entry.name = NPZ_MEMBERS[i];
+		entry.size = std::filesystem::file_size(memberPath);
+		entry.offset = zip.tellp();
+		entry.crc = 0;
+		writeLocalHeader(zip, entry, false);
+
+		while(file)
+		{
+			file.read(buffer.data(), buffer.size());
+			std::streamsize read = file.gcount();
+			entry.crc = crc32(entry.crc, buffer.data(), read);
+			zip.write(buffer.data(), read);
+		}
+
+		end = zip.tellp();
+		zip.seekp(entry.offset);
+		writeLocalHeader(zip, entry, false);
+		zip.seekp(end);
+		entries.push_back(entry);
+	}
+
+	uint64_t centralOffset = zip.tellp();
+	for(const ZipEntry& entry : entries)
+	{
+		bool zip64Size = entry.size >= ZIP32_MAX;
+		bool zip64Offset = entry.offset >= ZIP32_MAX;
+		uint16_t extraSize = (zip64Size || zip64Offset) ? 4 + (zip64Size ? 16 : 0) + (zip64Offset ? 8 : 0) : 0;
+
+		writeLe<uint32_t>(zip, 0x02014b50);
+		writeLe<uint16_t>(zip, ZIP_VERSION);
+		writeLe<uint16_t>(zip, ZIP_VERSION);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint16_t>(zip, ZIP_DATE);
+		writeLe<uint32_t>(zip, entry.crc);
+		writeLe<uint32_t>(zip, zip64Size ? ZIP32_MAX : entry.size);
+		writeLe<uint32_t>(zip, zip64Size ? ZIP32_MAX : entry.size);
+		writeLe<uint16_t>(zip, entry.name.size());
+		writeLe<uint16_t>(zip, extraSize);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint16_t>(zip, 0);
+		writeLe<uint32_t>(zip, 0);
+		writeLe<uint32_t>(zip, zip64Offset ? ZIP32_MAX : entry.offset);
+		zip.write(entry.name.data(), entry.name.size());
+		if(extraSize > 0)
+		{
+			writeLe<uint16_t>(zip, 0x0001);
+			writeLe<uint16_t>(zip, extraSize - 4);
+			if(zip64Size)
+			{
+				writeLe<uint64_t>(zip, entry.size);
+				writeLe<uint64_t>(zip, entry.size);
+			}
+			if(zip64Offset)
+				writeLe<uint64_t>(zip, entry.offset);
+		}
+	}
+	uint64_t centralEnd = zip.tellp();
+	uint64_t centralSize = centralEnd - centralOffset;
+
+	bool zip64 = centralOffset >= ZIP32_MAX || centralSize >= ZIP32_MAX;
+	if(zip64)
+	{
+		writeLe<uint32_t>(zip, 0x06064b50);
+		writeLe<uint64_t>(zip, 44);
+		writeLe<uint16_t>(zip, ZIP_VERSION);
+		writeLe<uint16_t>(zip, ZIP_VERSION);
+		writeLe<uint32_t>(zip, 0);
+		writeLe<uint32_t>(zip, 0);
+		writeLe<uint64_t>(zip, entries.size());
+		writeLe<uint64_t>(zip, entries.size());
+		writeLe<uint64_t>(zip, centralSize);
+		writeLe<uint64_t>(zip, centralOffset);
+
+		writeLe<uint32_t>(zip, 0x07064b50);
+		writeLe<uint32_t>(zip, 0);
+		writeLe<uint64_t>(zip, centralEnd);
+		writeLe<uint32_t>(zip, 1);
+	}
+
+	writeLe<uint32_t>(zip, 0x06054b50);
+	writeLe<uint16_t>(zip, 0);
+	writeLe<uint16_t>(zip, 0);
+	writeLe<uint16_t>(zip, entries.size());
+	writeLe<uint16_t>(zip, entries.size());
+	writeLe<uint32_t>(zip, zip64 ? ZIP32_MAX : centralSize);
+	writeLe<uint32_t>(zip, zip64 ? ZIP32_MAX : centralOffset);
+	writeLe<uint16_t>(zip, 0);
+
+	bool good = zip.good();
+	zip.close();
+	if(!good)
+		throw file_error("Unable to write " + _path.string());
+}
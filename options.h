@@ -40,6 +40,7 @@ static struct argp_option options[] =
   {"omega",      'o', "[START~END]", 0,  "set omega range" },
   {"extrapolate",  'a', "[START~END]", 0,  "extrapolate a spectra simulated on the omega range to the one given here" },
   {"omegasteps", 'c', "[COUNT]",     0,  "set omega range steps" },
+  {"adaptive",   'A', "[TOLERANCE]",     0,  "sample omega adaptively up to the given relative interpolation error, using at most omegasteps points" },
   {"linear",       'l', 0,      0,  "use linear instead of logarithmic steps" },
   {"normalize", 'n', 0,      0,  "normalize values" },
   {"reduce",    'r', 0,      0,  "reduce values to \"interesting\" range" },
@@ -47,13 +48,20 @@ static struct argp_option options[] =
   {"invert",        'i', 0,      0,  "inverts the imaginary axis"},
   {"noise",        'x', "[AMPLITUDE]",      0,  "add noise to output"},
   {"input-type",   't', "[STRING]",      0,  "set input string type, possible values: eis, boukamp, relaxis, madap"},
-  {"mode",         'f', "[STRING]",      0,  "mode, possible values: export, code, script, find-range, export-ranges"},
+  {"mode",         'f', "[STRING]",      0,  "mode, possible values: export, code, script, find-range, export-ranges, fit"},
   {"range-distance",   'd', "[DISTANCE]",      0,  "distance from a previous point where a range is considered \"new\""},
+  {"range-budget",   'B', "[COUNT]",      0,  "maximum number of steps to evaluate when finding ranges, 0 to evaluate every step"},
   {"parallel",   'p', 0,      0,  "run on multiple threads"},
   {"skip-linear",   'e', 0,      0,  "dont output param sweeps that create linear nyquist plots"},
   {"default-to-range",   'b', 0,      0,  "if a element has no paramters, default to assigning it a range instead of a single value"},
   {"no-compile",   'z', 0,      0,  "dont compile the model into a shared object"},
+  {"specialize",   'u', 0,      0,  "compile the parameters that are not swept into the model as constants"},
   {"save",   'y', "[FILENAME]",      0,  "place to save sweeps"},
+  {"format",   'g', "[STRING]",      0,  "format to save sweeps in, possible values: csv, dataset, npy, npz"},
+  {"writers",   'w', "[COUNT]",      0,  "number of threads writeing sweeps to disk"},
+  {"shards",   'k', "[COUNT]",      0,  "number of files to split a sweep saved in a binary format into"},
+  {"real-spectra",   'j', 0,      0,  "save npy and npz spectra as float32 pairs instead of complex64"},
+  {"fit-input",   'I', "[PATH]",      0,  "csv spectrum or directory of csv spectra to fit the model to in fit mode"},
   { 0 }
 };
 
@@ -73,7 +81,17 @@ enum
 	MODE_OUTPUT_RANGE_DATAPOINTS,
 	MODE_INVALID,
 	MODE_CODE,
-	MODE_TORCH_SCRIPT
+	MODE_TORCH_SCRIPT,
+	MODE_FIT
+};
+
+enum
+{
+	FORMAT_CSV,
+	FORMAT_DATASET,
+	FORMAT_NPY,
+	FORMAT_NPZ,
+	FORMAT_INVALID
 };
 
 struct Config
@@ -81,6 +99,7 @@ struct Config
 	std::string modelStr = "c{1e-6}r{1e3}-r{1e3}";
 	int inputType = INPUT_TYPE_EIS;
 	int mode = MODE_NORMAL;
+	int format = FORMAT_CSV;
 	size_t paramSteps = 10;
 	eis::Range omegaRange;
 	bool extrapolate = false;
@@ -93,9 +112,16 @@ struct Config
 	bool skipLinear = false;
 	bool defaultToRange = false;
 	bool noCompile = false;
+	bool specialize = false;
+	size_t writers = 1;
+	size_t shards = 1;
+	bool realSpectra = false;
 	double noise = 0;
+	double adaptiveTolerance = 0;
 	double rangeDistance = 0.35;
+	size_t rangeBudget = 20000;
 	std::string saveFileName;
+	std::string fitInput;
 
 	Config(): omegaRange(1, 1e6, 50, true)
 	{}
@@ -126,9 +152,24 @@ static int parseMode(const std::string& str)
 		return MODE_CODE;
 	else if(str == "script")
 		return MODE_TORCH_SCRIPT;
+	else if(str == "fit")
+		return MODE_FIT;
 	return MODE_INVALID;
 }
 
+static int parseFormat(const std::string& str)
+{
+	if(str == "csv")
+		return FORMAT_CSV;
+	else if(str == "dataset")
+		return FORMAT_DATASET;
+	else if(str == "npy")
+		return FORMAT_NPY;
+	else if(str == "npz")
+		return FORMAT_NPZ;
+	return FORMAT_INVALID;
+}
+
 static error_t
 parse_opt (int key, char *arg, struct argp_state *state)
 {
@@ -202,6 +243,9 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	case 'x':
 		config->noise = std::stod(std::string(arg));
 		break;
+	case 'A':
+		config->adaptiveTolerance = std::stod(std::string(arg));
+		break;
 	case 't':
 		config->inputType = parseInputType(std::string(arg));
 		break;
@@ -217,6 +261,9 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	case 'd':
 		config->rangeDistance = std::stod(std::string(arg));
 		break;
+	case 'B':
+		config->rangeBudget = std::stoul(std::string(arg));
+		break;
 	case 'b':
 		config->defaultToRange = true;
 		break;
@@ -226,6 +273,24 @@ parse_opt (int key, char *arg, struct argp_state *state)
 	case 'z':
 		config->noCompile = true;
 		break;
+	case 'u':
+		config->specialize = true;
+		break;
+	case 'g':
+		config->format = parseFormat(std::string(arg));
+		break;
+	case 'w':
+		config->writers = std::stoul(std::string(arg));
+		break;
+	case 'k':
+		config->shards = std::stoul(std::string(arg));
+		break;
+	case 'j':
+		config->realSpectra = true;
+		break;
+	case 'I':
+		config->fitInput = std::string(arg);
+		break;
 	default:
 		return ARGP_ERR_UNKNOWN;
 	}
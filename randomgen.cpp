@@ -20,27 +20,202 @@
 //
 
 #include "randomgen.h"
-#include <assert.h>
-#include <cstddef>
-#include <cstdint>
+#include <atomic>
+#include <mutex>
+#include <cmath>
 #include <random>
 
-static std::default_random_engine randomEngine;
-static std::uniform_real_distribution<double> dist(0, 1);
-static std::uniform_int_distribution<size_t> distSt(0, SIZE_MAX);
+static std::atomic<uint64_t> globalSeed = 0;
+static std::atomic<bool> seeded = false;
+static std::atomic<uint64_t> seedGeneration = 0;
+static std::atomic<uint64_t> threadCounter = 0;
+
+// keeps the stream ids of index streams and thread streams apart
+static constexpr uint64_t INDEX_STREAM_BIT = 1ull << 63;
+
+static constexpr uint32_t PHILOX_M0 = 0xD2511F53;
+static constexpr uint32_t PHILOX_M1 = 0xCD9E8D57;
+static constexpr uint32_t PHILOX_W0 = 0x9E3779B9;
+static constexpr uint32_t PHILOX_W1 = 0xBB67AE85;
+static constexpr double TWO_PI = 6.283185307179586476925286766559;
+
+static inline void mulhilo(uint32_t a, uint32_t b, uint32_t& hi, uint32_t& lo)
+{
+	uint64_t product = static_cast<uint64_t>(a)*b;
+	hi = product >> 32;
+	lo = static_cast<uint32_t>(product);
+}
+
+std::array<uint32_t, 4> rd::philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key)
+{
+	for(int round = 0; round < 10; ++round)
+	{
+		uint32_t hi0, lo0, hi1, lo1;
+		mulhilo(PHILOX_M0, counter[0], hi0, lo0);
+		mulhilo(PHILOX_M1, counter[2], hi1, lo1);
+		counter = {hi1 ^ counter[1] ^ key[0], lo1, hi0 ^ counter[3] ^ key[1], lo0};
+		key[0] += PHILOX_W0;
+		key[1] += PHILOX_W1;
+	}
+	return counter;
+}
+
+static inline float toUnitFloat(uint32_t value)
+{
+	return (value >> 8)*0x1.0p-24f;
+}
+
+static inline double toUnitDouble(uint32_t high, uint32_t low)
+{
+	return ((static_cast<uint64_t>(high) << 21) ^ (low >> 11))*0x1.0p-53;
+}
+
+rd::Stream::Stream(uint64_t seed, uint64_t stream):
+_key({static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)}), _stream(stream)
+{
+}
+
+std::array<uint32_t, 4> rd::Stream::block(uint64_t counter) const
+{
+	return philox({static_cast<uint32_t>(counter), static_cast<uint32_t>(counter >> 32),
+		static_cast<uint32_t>(_stream), static_cast<uint32_t>(_stream >> 32)}, _key);
+}
+
+void rd::Stream::seek(uint64_t position)
+{
+	_counter = position/4;
+	_used = position % 4;
+	if(_used != 0)
+		_block = block(_counter++);
+	else
+		_used = 4;
+}
+
+uint32_t rd::Stream::next32()
+{
+	if(_used == 4)
+	{
+		_block = block(_counter++);
+		_used = 0;
+	}
+	return _block[_used++];
+}
+
+uint64_t rd::Stream::next64()
+{
+	uint64_t high = next32();
+	return (high << 32) | next32();
+}
+
+double rd::Stream::uniform(double max)
+{
+	uint32_t high = next32();
+	return toUnitDouble(high, next32())*max;
+}
+
+double rd::Stream::normal(double mean, double sigma)
+{
+	double u = 1.0 - uniform();
+	double v = uniform();
+	return mean + sigma*std::sqrt(-2.0*std::log(u))*std::cos(TWO_PI*v);
+}
+
+void rd::Stream::uniform(float* out, size_t count, float min, float max)
+{
+	size_t i = 0;
+	for(; i < count && _used != 4; ++i)
+		out[i] = min + toUnitFloat(next32())*(max-min);
+
+	// whole blocks are independent of each other which allows the compiler to vectorize this loop
+	size_t blocks = (count - i)/4;
+	uint64_t counter = _counter;
+	for(size_t j = 0; j < blocks; ++j)
+	{
+		std::array<uint32_t, 4> values = block(counter+j);
+		for(size_t k = 0; k < 4; ++k)
+			out[i+j*4+k] = min + toUnitFloat(values[k])*(max-min);
+	}
+	_counter += blocks;
+	i += blocks*4;
+
+	for(; i < count; ++i)
+		out[i] = min + toUnitFloat(next32())*(max-min);
+}
+
+void rd::Stream::normal(float* out, size_t count, float mean, float sigma)
+{
+	uniform(out, count);
+	for(size_t i = 0; i+1 < count; i += 2)
+	{
+		float radius = sigma*std::sqrt(-2.0f*std::log(1.0f - out[i]));
+		float angle = static_cast<float>(TWO_PI)*out[i+1];
+		out[i] = mean + radius*std::cos(angle);
+		out[i+1] = mean + radius*std::sin(angle);
+	}
+	if(count % 2)
+	{
+		float last = out[count-1];
+		out[count-1] = mean + sigma*std::sqrt(-2.0f*std::log(1.0f - last))*std::cos(static_cast<float>(TWO_PI)*next32()*0x1.0p-32f);
+	}
+}
+
+static uint64_t getGlobalSeed()
+{
+	// without an explicit seed every run must differ, as it did with the random_device seeded engine
+	static std::once_flag seedFlag;
+	if(!seeded)
+	{
+		std::call_once(seedFlag, []()
+		{
+			if(!seeded)
+				rd::init();
+		});
+	}
+	return globalSeed.load();
+}
+
+rd::Stream& rd::threadStream()
+{
+	thread_local const uint64_t streamId = threadCounter.fetch_add(1);
+	thread_local uint64_t generation = 0;
+	thread_local Stream stream;
+
+	// the stream is rekeyed when seed was called since it was last used, so that a new seed applies to every thread,
+	// seed updates the generation after the seed, thus a new generation is never paired with an old seed
+	getGlobalSeed();
+	uint64_t current = seedGeneration.load();
+	if(generation != current)
+	{
+		stream = Stream(globalSeed.load(), streamId);
+		generation = current;
+	}
+	return stream;
+}
+
+rd::Stream rd::indexStream(uint64_t index)
+{
+	return Stream(getGlobalSeed(), index | INDEX_STREAM_BIT);
+}
 
 double rd::rand(double max)
 {
-	return dist(randomEngine)*max;
+	return threadStream().uniform(max);
 }
 
 size_t rd::uid()
 {
-	return distSt(randomEngine);
+	return threadStream().next64();
+}
+
+void rd::seed(uint64_t seed)
+{
+	globalSeed = seed;
+	seeded = true;
+	++seedGeneration;
 }
 
 void rd::init()
 {
 	std::random_device randomDevice;
-	randomEngine.seed(randomDevice());
+	seed((static_cast<uint64_t>(randomDevice()) << 32) | randomDevice());
 }
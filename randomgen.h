@@ -20,13 +20,73 @@
 
 #pragma once
 
+#include <array>
 #include <cstddef>
+#include <cstdint>
 
 namespace rd
 {
 
+/**
+* The Philox4x32-10 counter based generator of Salmon et al. "Parallel random numbers: as easy as 1, 2, 3".
+* Every output block is a pure function of counter and key, thus any number of streams can be generated in parallel
+* without shared state and any position in a stream can be computed directly.
+*/
+std::array<uint32_t, 4> philox(std::array<uint32_t, 4> counter, std::array<uint32_t, 2> key);
+
+/**
+* A stream of random numbers backed by philox, the stream is identified by seed and stream id,
+* numbers are generated from a 64 bit position counter within the stream.
+*/
+class Stream
+{
+private:
+	std::array<uint32_t, 2> _key;
+	uint64_t _stream;
+	uint64_t _counter = 0;
+	std::array<uint32_t, 4> _block;
+	size_t _used = 4;
+
+	std::array<uint32_t, 4> block(uint64_t counter) const;
+
+public:
+	Stream(uint64_t seed = 0, uint64_t stream = 0);
+
+	void seek(uint64_t position);
+	uint32_t next32();
+	uint64_t next64();
+	double uniform(double max = 1);
+	double normal(double mean = 0, double sigma = 1);
+
+	/**
+	* Fills out with count values uniformly distributed in [min, max), the blocks used are a function of the
+	* current position only so that the result is identical to count calls of uniform(out, 1).
+	* Every value consumes one 32 bit word of the stream, unlike uniform(double) which consumes two.
+	*/
+	void uniform(float* out, size_t count, float min = 0, float max = 1);
+	void normal(float* out, size_t count, float mean = 0, float sigma = 1);
+};
+
+/**
+* Gets the stream of the calling thread, every thread is given its own stream id so that no locking is required.
+* If neither init nor seed was called before, the seed is drawn from std::random_device.
+*
+* Stream ids are assigned in the order in which threads first use this function, thus which numbers a thread draws
+* depends on scheduling once several threads are involved. Calling seed restarts the stream of every thread on its
+* next use, which makes single threaded use reproducible. Work that must be reproducible when run in parallel
+* should use indexStream with the index of the work item instead.
+*/
+Stream& threadStream();
+
+/**
+* Gets the stream of a work item, ie. a step of a parameter sweep, under the seed set by seed or init.
+* The stream depends only on the seed and index, not on the thread or order in which the work items are processed.
+*/
+Stream indexStream(uint64_t index);
+
 double rand(double max = 1);
 void init();
+void seed(uint64_t seed);
 size_t uid();
 
 }
@@ -0,0 +1,197 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "rational.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "componant/paralellseriel.h"
+#include "componant/resistor.h"
+#include "componant/cap.h"
+#include "componant/inductor.h"
+
+using namespace eis;
+
+static std::vector<double> multiply(const std::vector<double>& a, const std::vector<double>& b)
+{
+	std::vector<double> out(a.size()+b.size()-1, 0);
+	for(size_t i = 0; i < a.size(); ++i)
+	{
+		for(size_t j = 0; j < b.size(); ++j)
+			out[i+j] += a[i]*b[j];
+	}
+	return out;
+}
+
+static std::vector<double> add(const std::vector<double>& a, const std::vector<double>& b)
+{
+	std::vector<double> out(std::max(a.size(), b.size()), 0);
+	for(size_t i = 0; i < a.size(); ++i)
+		out[i] += a[i];
+	for(size_t i = 0; i < b.size(); ++i)
+		out[i] += b[i];
+	return out;
+}
+
+// cancels common factors of s and rescales, so that the coefficients stay in range for deep circuits
+static void normalize(std::vector<double>& numerator, std::vector<double>& denominator)
+{
+	while(numerator.size() > 1 && denominator.size() > 1 && numerator[0] == 0 && denominator[0] == 0)
+	{
+		numerator.erase(numerator.begin());
+		denominator.erase(denominator.begin());
+	}
+	while(numerator.size() > 1 && numerator.back() == 0)
+		numerator.pop_back();
+	while(denominator.size() > 1 && denominator.back() == 0)
+		denominator.pop_back();
+
+	double scale = 0;
+	for(double coefficient : denominator)
+		scale = std::max(scale, std::abs(coefficient));
+	if(scale == 0 || !std::isfinite(scale))
+		return;
+	for(double& coefficient : numerator)
+		coefficient /= scale;
+	for(double& coefficient : denominator)
+		coefficient /= scale;
+}
+
+static void split(const std::vector<double>& polynomial, std::vector<double>& even, std::vector<double>& odd)
+{
+	even.clear();
+	odd.clear();
+	for(size_t i = 0; i < polynomial.size(); ++i)
+		(i % 2 == 0 ? even : odd).push_back(polynomial[i]);
+}
+
+static double horner(const std::vector<double>& coefficients, double x)
+{
+	double accum = 0;
+	for(size_t i = coefficients.size(); i > 0; --i)
+		accum = accum*x + coefficients[i-1];
+	return accum;
+}
+
+void RationalImpedance::reduce(Componant* componant, const std::vector<fvalue>& parameters, size_t& index,
+                               std::vector<double>& numerator, std::vector<double>& denominator)
+{
+	Parallel* parallel = dynamic_cast<Parallel*>(componant);
+	Serial* serial = dynamic_cast<Serial*>(componant);
+	if(parallel || serial)
+	{
+		const std::vector<Componant*>& componants = parallel ? parallel->componants : serial->componants;
+		// a parallel node sums the admittances of its children, which are the swapped rationals of their impedances
+		numerator = {0};
+		denominator = {1};
+		for(Componant* element : componants)
+		{
+			std::vector<double> elementNumerator;
+			std::vector<double> elementDenominator;
+			reduce(element, parameters, index, elementNumerator, elementDenominator);
+			if(parallel)
+				std::swap(elementNumerator, elementDenominator);
+
+			numerator = add(multiply(numerator, elementDenominator), multiply(elementNumerator, denominator));
+			denominator = multiply(denominator, elementDenominator);
+			normalize(numerator, denominator);
+		}
+		if(parallel)
+			std::swap(numerator, denominator);
+		return;
+	}
+
+	double value = parameters[index++];
+	switch(componant->getComponantChar())
+	{
+		case Resistor::staticGetComponantChar():
+			numerator = {value};
+			denominator = {1};
+			break;
+		case Cap::staticGetComponantChar():
+			numerator = {1};
+			denominator = {0, value};
+			break;
+		case Inductor::staticGetComponantChar():
+			numerator = {0, value};
+			denominator = {1};
+			break;
+		default:
+			numerator = {1};
+			denominator = {1};
+			break;
+	}
+}
+
+RationalImpedance::RationalImpedance(Componant* model, const std::vector<fvalue>& parameters)
+{
+	size_t index = 0;
+	reduce(model, parameters, index, _numerator, _denominator);
+	split(_numerator, _numeratorEven, _numeratorOdd);
+	split(_denominator, _denominatorEven, _denominatorOdd);
+}
+
+bool RationalImpedance::isRational(Componant* model)
+{
+	Parallel* parallel = dynamic_cast<Parallel*>(model);
+	Serial* serial = dynamic_cast<Serial*>(model);
+	if(parallel || serial)
+	{
+		const std::vector<Componant*>& componants = parallel ? parallel->componants : serial->componants;
+		for(Componant* element : componants)
+		{
+			if(!isRational(element))
+				return false;
+		}
+		return !componants.empty();
+	}
+
+	char type = model->getComponantChar();
+	return type == Resistor::staticGetComponantChar() || type == Cap::staticGetComponantChar() ||
+		type == Inductor::staticGetComponantChar();
+}
+
+std::complex<fvalue> RationalImpedance::evaluate(fvalue omega) const
+{
+	double x = -static_cast<double>(omega)*omega;
+	std::complex<double> numerator(horner(_numeratorEven, x), omega*horner(_numeratorOdd, x));
+	std::complex<double> denominator(horner(_denominatorEven, x), omega*horner(_denominatorOdd, x));
+	std::complex<double> out = numerator/denominator;
+	return std::complex<fvalue>(out.real(), out.imag());
+}
+
+void RationalImpedance::evaluate(const std::vector<fvalue>& omega, std::complex<fvalue>* out) const
+{
+	for(size_t i = 0; i < omega.size(); ++i)
+		out[i] = evaluate(omega[i]);
+}
+
+const std::vector<double>& RationalImpedance::getNumerator() const
+{
+	return _numerator;
+}
+
+const std::vector<double>& RationalImpedance::getDenominator() const
+{
+	return _denominator;
+}
@@ -0,0 +1,77 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <complex>
+#include <vector>
+#include <kisstype/type.h>
+
+#include "componant/componant.h"
+
+namespace eis
+{
+
+/**
+* The impedance of a circuit consisting only of resistors, capacitors and inductors as a ratio of two polynomials in s = j*omega.
+*
+* The polynomials have real coefficients and are split into their even and odd parts, so that with x = -omega^2
+* P(j*omega) = E(x) + j*omega*O(x), which allows evaluation with two real Horner recurrences per polynomial.
+*/
+class RationalImpedance
+{
+private:
+	std::vector<double> _numerator;
+	std::vector<double> _denominator;
+	std::vector<double> _numeratorEven;
+	std::vector<double> _numeratorOdd;
+	std::vector<double> _denominatorEven;
+	std::vector<double> _denominatorOdd;
+
+	static void reduce(Componant* componant, const std::vector<fvalue>& parameters, size_t& index,
+	                   std::vector<double>& numerator, std::vector<double>& denominator);
+
+public:
+	/**
+	* Reduces the circuit to a rational function with the given parameters in the order of Model::getFlatParameters.
+	* The circuit must satisfy isRational.
+	*/
+	RationalImpedance(Componant* model, const std::vector<fvalue>& parameters);
+
+	/**
+	* Returns true if the circuit consists only of resistors, capacitors and inductors.
+	*/
+	static bool isRational(Componant* model);
+
+	std::complex<fvalue> evaluate(fvalue omega) const;
+	void evaluate(const std::vector<fvalue>& omega, std::complex<fvalue>* out) const;
+
+	/**
+	* Gets the coefficients of the numerator in ascending powers of s.
+	*/
+	const std::vector<double>& getNumerator() const;
+
+	/**
+	* Gets the coefficients of the denominator in ascending powers of s.
+	*/
+	const std::vector<double>& getDenominator() const;
+};
+
+}
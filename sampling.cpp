@@ -0,0 +1,185 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared libary and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "sampling.h"
+#include "randomgen.h"
+
+#include <array>
+#include <vector>
+
+using namespace eis;
+
+static constexpr size_t SOBOL_BITS = 32;
+
+struct SobolPolynomial
+{
+	uint32_t degree;
+	uint32_t coefficients;
+	std::array<uint32_t, 8> initial;
+};
+
+// primitive polynomials and initial direction numbers for dimensions 2-21 from Joe and Kuo, new-joe-kuo-6.21201
+static const SobolPolynomial sobolPolynomials[] =
+{
+	{1, 0, {1}},
+	{2, 1, {1, 3}},
+	{3, 1, {1, 3, 1}},
+	{3, 2, {1, 1, 1}},
+	{4, 1, {1, 1, 3, 3}},
+	{4, 4, {1, 3, 5, 13}},
+	{5, 2, {1, 1, 5, 5, 17}},
+	{5, 4, {1, 1, 5, 5, 5}},
+	{5, 7, {1, 1, 7, 11, 19}},
+	{5, 11, {1, 1, 5, 1, 1}},
+	{5, 13, {1, 1, 1, 3, 11}},
+	{5, 14, {1, 3, 5, 5, 31}},
+	{6, 1, {1, 3, 3, 9, 7, 49}},
+	{6, 13, {1, 1, 1, 15, 21, 21}},
+	{6, 16, {1, 3, 1, 13, 27, 49}},
+	{6, 19, {1, 1, 1, 15, 7, 5}},
+	{6, 22, {1, 3, 1, 15, 13, 25}},
+	{6, 25, {1, 1, 5, 5, 19, 61}},
+	{7, 1, {1, 3, 7, 11, 23, 15, 103}},
+	{7, 4, {1, 3, 7, 13, 13, 15, 69}}
+};
+
+static constexpr size_t SOBOL_DIMENSIONS = sizeof(sobolPolynomials)/sizeof(*sobolPolynomials)+1;
+
+static std::vector<std::array<uint32_t, SOBOL_BITS>> createSobolDirections()
+{
+	std::vector<std::array<uint32_t, SOBOL_BITS>> directions(SOBOL_DIMENSIONS);
+
+	for(size_t i = 0; i < SOBOL_BITS; ++i)
+		directions[0][i] = 1u << (SOBOL_BITS-1-i);
+
+	for(size_t dimension = 1; dimension < SOBOL_DIMENSIONS; ++dimension)
+	{
+		const SobolPolynomial& polynomial = sobolPolynomials[dimension-1];
+		std::array<uint32_t, SOBOL_BITS>& v = directions[dimension];
+		uint32_t s = polynomial.degree;
+
+		for(size_t i = 0; i < s; ++i)
+			v[i] = polynomial.initial[i] << (SOBOL_BITS-1-i);
+
+		for(size_t i = s; i < SOBOL_BITS; ++i)
+		{
+			v[i] = v[i-s] ^ (v[i-s] >> s);
+			for(size_t k = 1; k < s; ++k)
+				v[i] ^= ((polynomial.coefficients >> (s-1-k)) & 1) * v[i-k];
+		}
+	}
+	return directions;
+}
+
+static uint64_t splitmix(uint64_t x)
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+	x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+	return x ^ (x >> 31);
+}
+
+static double toUnit(uint64_t x)
+{
+	return static_cast<double>(x >> 11) * 0x1.0p-53;
+}
+
+// Kensler's hash based permutation of [0, length), see "Correlated Multi-Jittered Sampling"
+static uint32_t permute(uint32_t i, uint32_t length, uint32_t key)
+{
+	uint32_t w = length - 1;
+	w |= w >> 1;
+	w |= w >> 2;
+	w |= w >> 4;
+	w |= w >> 8;
+	w |= w >> 16;
+	do
+	{
+		i ^= key;
+		i *= 0xe170893d;
+		i ^= key >> 16;
+		i ^= (i & w) >> 4;
+		i ^= key >> 8;
+		i *= 0x0929eb3f;
+		i ^= key >> 23;
+		i ^= (i & w) >> 1;
+		i *= 1 | key >> 27;
+		i *= 0x6935fa69;
+		i ^= (i & w) >> 11;
+		i *= 0x74dcb303;
+		i ^= (i & w) >> 2;
+		i *= 0x9e501cc3;
+		i ^= (i & w) >> 2;
+		i *= 0xc860a3df;
+		i &= w;
+		i ^= i >> 5;
+	} while(i >= length);
+	return (i + key) % length;
+}
+
+uint64_t eis::sampleHash(uint64_t seed, uint64_t counter, uint64_t stream)
+{
+	return splitmix(splitmix(splitmix(seed) ^ counter) ^ (stream * 0xd1342543de82ef95ull));
+}
+
+double eis::uniformUnit(uint64_t seed, uint64_t sample, uint64_t dimension)
+{
+	std::array<uint32_t, 4> block = rd::philox({static_cast<uint32_t>(sample), static_cast<uint32_t>(sample >> 32),
+		static_cast<uint32_t>(dimension), static_cast<uint32_t>(dimension >> 32)},
+		{static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)});
+	return toUnit((static_cast<uint64_t>(block[0]) << 32) | block[1]);
+}
+
+double eis::latinHypercubeUnit(uint64_t seed, uint64_t sample, uint64_t dimension, uint64_t count)
+{
+	if(count < 2)
+		return uniformUnit(seed, sample, dimension);
+
+	uint32_t key = static_cast<uint32_t>(sampleHash(seed, dimension, ~0ull));
+	uint32_t stratum = permute(static_cast<uint32_t>(sample % count), static_cast<uint32_t>(count), key);
+	return (stratum + uniformUnit(seed, sample, dimension))/static_cast<double>(count);
+}
+
+double eis::sobolUnit(uint64_t seed, uint64_t sample, uint64_t dimension)
+{
+	static const std::vector<std::array<uint32_t, SOBOL_BITS>> directions = createSobolDirections();
+
+	if(dimension >= SOBOL_DIMENSIONS)
+		return uniformUnit(seed, sample, dimension);
+
+	uint64_t gray = sample ^ (sample >> 1);
+	uint32_t x = 0;
+	for(size_t i = 0; i < SOBOL_BITS && gray != 0; ++i, gray >>= 1)
+	{
+		if(gray & 1)
+			x ^= directions[dimension][i];
+	}
+
+	// a random digital shift keeps the net properties of the sequence while decorrelating different seeds
+	x ^= static_cast<uint32_t>(sampleHash(seed, dimension, ~1ull));
+	return (x + uniformUnit(seed, sample, dimension))*0x1.0p-32;
+}
+
+size_t eis::sobolMaxDimensions()
+{
+	return SOBOL_DIMENSIONS;
+}
@@ -0,0 +1,44 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+/* * eisgenerator - a shared libary and application to generate EIS spectra
+ * Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+ *
+ * This file is part of eisgenerator.
+ *
+ * eisgenerator is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * eisgenerator is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace eis
+{
+
+/**
+* Counter based sampling of the unit interval, every function here is a pure function of its arguments
+* so that any sample can be computed independently of all others.
+*/
+
+uint64_t sampleHash(uint64_t seed, uint64_t counter, uint64_t stream);
+
+double uniformUnit(uint64_t seed, uint64_t sample, uint64_t dimension);
+
+double latinHypercubeUnit(uint64_t seed, uint64_t sample, uint64_t dimension, uint64_t count);
+
+double sobolUnit(uint64_t seed, uint64_t sample, uint64_t dimension);
+
+size_t sobolMaxDimensions();
+
+}
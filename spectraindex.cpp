@@ -0,0 +1,380 @@
+//SPDX-License-Identifier:         LGPL-3.0-or-later
+//
+// eisgenerator - a shared library and application to generate EIS spectra
+// Copyright (C) 2022-2024 Carl Philipp Klemm <carl@uvos.xyz>
+//
+// This file is part of eisgenerator.
+//
+// eisgenerator is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// eisgenerator is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public License
+// along with eisgenerator.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+
+#include "spectraindex.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <thread>
+#include <type_traits>
+
+#include "basicmath.h"
+#include "normalize.h"
+#include "log.h"
+#include "mapping.h"
+
+using namespace eis;
+
+static_assert(std::is_same<fvalue, float>::value, "the index format requires fvalue to be float");
+
+static constexpr char INDEX_MAGIC[8] = {'E', 'I', 'S', 'I', 'N', 'D', 'E', 'X'};
+static constexpr uint32_t INDEX_VERSION = 1;
+static constexpr uint64_t SPECTRA_ALIGNMENT = 64;
+
+struct IndexHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t headerSize;
+	uint64_t stepCount;
+	uint64_t omegaCount;
+	uint64_t parameterCount;
+	uint64_t modelLength;
+	uint64_t namesLength;
+	uint64_t omegaOffset;
+	uint64_t namesOffset;
+	uint64_t spectraOffset;
+	uint64_t thresholdOffset;
+	uint64_t indexOffset;
+	uint64_t parameterOffset;
+};
+
+static uint64_t alignOffset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1)/alignment*alignment;
+}
+
+static float spectrumDistance(const float* a, const float* b, size_t length)
+{
+	float accum = 0;
+	for(size_t i = 0; i < length; ++i)
+	{
+		float diff = a[i] - b[i];
+		accum += diff*diff;
+	}
+	return std::sqrt(accum);
+}
+
+static void flattenNormalized(std::vector<eis::DataPoint> data, float* out)
+{
+	eis::normalize(data);
+	for(size_t i = 0; i < data.size(); ++i)
+	{
+		out[i*2] = data[i].im.real();
+		out[i*2+1] = data[i].im.imag();
+	}
+}
+
+static void indexThreadFn(Model model, const std::vector<fvalue>* omega, size_t start, size_t stop,
+                          std::vector<float>* spectra, std::vector<float>* parameters)
+{
+	const size_t parameterCount = model.getParameterCount();
+	for(size_t i = start; i < stop; ++i)
+	{
+		flattenNormalized(model.executeSweep(*omega, i), spectra->data() + i*omega->size()*2);
+		std::vector<fvalue> stepParameters = model.getFlatParameters();
+		std::copy(stepParameters.begin(), stepParameters.end(), parameters->begin() + i*parameterCount);
+	}
+}
+
+// Arranges order[begin, end) as a vantage point tree: the vantage point is placed at begin, the points closer to it
+// than the median distance, which is saved as its threshold, follow it and the remaining points make up the second half.
+static void buildTree(std::vector<size_t>& order, std::vector<float>& thresholds, size_t begin, size_t end,
+                      const std::vector<float>& spectra, size_t length, std::mt19937& generator)
+{
+	if(end - begin < 2)
+	{
+		if(end > begin)
+			thresholds[begin] = 0;
+		return;
+	}
+
+	std::uniform_int_distribution<size_t> distribution(begin, end-1);
+	std::swap(order[begin], order[distribution(generator)]);
+	const float* vantage = spectra.data() + order[begin]*length;
+
+	std::vector<std::pair<float, size_t>> distances;
+	distances.reserve(end - begin - 1);
+	for(size_t i = begin+1; i < end; ++i)
+		distances.push_back({spectrumDistance(vantage, spectra.data() + order[i]*length, length), order[i]});
+
+	size_t median = (end - begin - 1)/2;
+	std::nth_element(distances.begin(), distances.begin() + median, distances.end());
+	thresholds[begin] = distances[median].first;
+	for(size_t i = 0; i < distances.size(); ++i)
+		order[begin+1+i] = distances[i].second;
+
+	size_t mid = begin + 1 + median;
+	buildTree(order, thresholds, begin+1, mid, spectra, length, generator);
+	buildTree(order, thresholds, mid, end, spectra, length, generator);
+}
+
+void SpectraIndex::build(const std::filesystem::path& path, Model& model, const std::vector<fvalue>& omega, bool threaded)
+{
+	const size_t stepCount = model.getRequiredStepsForSweeps();
+	const size_t parameterCount = model.getParameterCount();
+	const size_t length = omega.size()*2;
+
+	std::vector<float> spectra(stepCount*length);
+	std::vector<float> parameters(stepCount*parameterCount);
+
+	size_t threadsCount = threaded ? std::max(std::thread::hardware_concurrency(), 1u) : 1;
+	threadsCount = std::max<size_t>(std::min(threadsCount, stepCount), 1);
+	size_t perThread = stepCount/threadsCount;
+	std::vector<std::thread> threads;
+	threads.reserve(threadsCount);
+	for(size_t i = 0; i < threadsCount; ++i)
+	{
+		size_t start = i*perThread;
+		size_t stop = i == threadsCount-1 ? stepCount : start+perThread;
+		threads.push_back(std::thread(indexThreadFn, model, &omega, start, stop, &spectra, &parameters));
+	}
+	for(std::thread& thread : threads)
+		thread.join();
+
+	std::vector<size_t> order(stepCount);
+	for(size_t i = 0; i < stepCount; ++i)
+		order[i] = i;
+	std::vector<float> thresholds(stepCount);
+	std::mt19937 generator(0);
+	buildTree(order, thresholds, 0, stepCount, spectra, length, generator);
+
+	std::string modelStr = model.getModelStr();
+	std::string names;
+	for(const std::string& name : model.getParameterNames())
+	{
+		names.append(name);
+		names.push_back('\0');
+	}
+
+	IndexHeader header = {};
+	std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.headerSize = sizeof(IndexHeader);
+	header.stepCount = stepCount;
+	header.omegaCount = omega.size();
+	header.parameterCount = parameterCount;
+	header.modelLength = modelStr.size();
+	header.namesLength = names.size();
+	header.omegaOffset = alignOffset(sizeof(IndexHeader) + modelStr.size(), sizeof(float));
+	header.namesOffset = header.omegaOffset + omega.size()*sizeof(float);
+	header.spectraOffset = alignOffset(header.namesOffset + names.size(), SPECTRA_ALIGNMENT);
+	header.thresholdOffset = header.spectraOffset + stepCount*length*sizeof(float);
+	header.indexOffset = alignOffset(header.thresholdOffset + stepCount*sizeof(float), sizeof(uint64_t));
+	header.parameterOffset = header.indexOffset + stepCount*sizeof(uint64_t);
+
+	std::ofstream file(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+	if(!file.is_open())
+		throw file_error("Unable to open " + path.string() + " for writing");
+
+	auto pad = [&file](uint64_t offset)
+	{
+		while(static_cast<uint64_t>(file.tellp()) < offset)
+			file.put(0);
+	};
+
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(modelStr.data(), modelStr.size());
+	pad(header.omegaOffset);
+	file.write(reinterpret_cast<const char*>(omega.data()), omega.size()*sizeof(float));
+	file.write(names.data(), names.size());
+	pad(header.spectraOffset);
+	// the spectra are saved in tree order so that the spectra of a subtree are contiguous on disk
+	for(size_t step : order)
+		file.write(reinterpret_cast<const char*>(spectra.data() + step*length), length*sizeof(float));
+	file.write(reinterpret_cast<const char*>(thresholds.data()), thresholds.size()*sizeof(float));
+	pad(header.indexOffset);
+	for(size_t step : order)
+	{
+		uint64_t index = step;
+		file.write(reinterpret_cast<const char*>(&index), sizeof(index));
+	}
+	for(size_t step : order)
+		file.write(reinterpret_cast<const char*>(parameters.data() + step*parameterCount), parameterCount*sizeof(float));
+
+	if(!file.good())
+		throw file_error("Unable to write index to " + path.string());
+}
+
+SpectraIndex::SpectraIndex(const std::filesystem::path& path)
+{
+	if(!mapFile(path, &_data, &_size, &_mapping))
+		throw file_error("Unable to map " + path.string());
+
+	const IndexHeader* header = reinterpret_cast<const IndexHeader*>(_data);
+	if(_size < sizeof(IndexHeader) || std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0)
+	{
+		unmap();
+		throw file_error(path.string() + " is not a eisgenerator spectra index");
+	}
+
+	// the row sizes are bounded by the file size first so that computing them can not overflow
+	if(header->version != INDEX_VERSION ||
+		header->headerSize < sizeof(IndexHeader) ||
+		header->omegaCount > _size || header->parameterCount > _size ||
+		header->omegaOffset % alignof(float) != 0 || header->spectraOffset % alignof(float) != 0 ||
+		header->thresholdOffset % alignof(float) != 0 || header->indexOffset % alignof(uint64_t) != 0 ||
+		header->parameterOffset % alignof(float) != 0 ||
+		!regionInMapping(header->headerSize, header->modelLength, 1, _size) ||
+		!regionInMapping(header->omegaOffset, header->omegaCount, sizeof(float), _size) ||
+		!regionInMapping(header->namesOffset, header->namesLength, 1, _size) ||
+		!regionInMapping(header->spectraOffset, header->stepCount, header->omegaCount*2*sizeof(float), header->thresholdOffset) ||
+		!regionInMapping(header->thresholdOffset, header->stepCount, sizeof(float), header->indexOffset) ||
+		!regionInMapping(header->indexOffset, header->stepCount, sizeof(uint64_t), header->parameterOffset) ||
+		!regionInMapping(header->parameterOffset, header->stepCount, header->parameterCount*sizeof(float), _size))
+	{
+		unmap();
+		throw file_error(path.string() + " is an incompleat or unsupported spectra index");
+	}
+
+	_stepCount = header->stepCount;
+	_omegaCount = header->omegaCount;
+	_parameterCount = header->parameterCount;
+	_model.assign(reinterpret_cast<const char*>(_data + header->headerSize), header->modelLength);
+	_omega = reinterpret_cast<const float*>(_data + header->omegaOffset);
+	_spectra = reinterpret_cast<const float*>(_data + header->spectraOffset);
+	_thresholds = reinterpret_cast<const float*>(_data + header->thresholdOffset);
+	_indices = reinterpret_cast<const uint64_t*>(_data + header->indexOffset);
+	_parameters = reinterpret_cast<const float*>(_data + header->parameterOffset);
+
+	_parameterNames = splitStrings(reinterpret_cast<const char*>(_data + header->namesOffset), header->namesLength);
+}
+
+SpectraIndex::~SpectraIndex()
+{
+	unmap();
+}
+
+void SpectraIndex::unmap()
+{
+	unmapFile(_data, _size, _mapping);
+	_mapping = nullptr;
+	_data = nullptr;
+}
+
+void SpectraIndex::search(const float* query, size_t begin, size_t end, size_t k, std::vector<std::pair<float, size_t>>& heap) const
+{
+	const size_t length = _omegaCount*2;
+	float distance = spectrumDistance(query, _spectra + begin*length, length);
+	if(heap.size() < k || distance < heap.front().first)
+	{
+		if(heap.size() == k)
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			heap.pop_back();
+		}
+		heap.push_back({distance, begin});
+		std::push_heap(heap.begin(), heap.end());
+	}
+
+	if(end - begin < 2)
+		return;
+
+	size_t mid = begin + 1 + (end - begin - 1)/2;
+	float threshold = _thresholds[begin];
+	auto tau = [&heap, k]() -> float
+	{
+		return heap.size() < k ? std::numeric_limits<float>::infinity() : heap.front().first;
+	};
+
+	// by the triangle inequality a subtree can only contain a closer spectrum if the query is within tau of its shell
+	if(distance < threshold)
+	{
+		if(mid > begin+1)
+			search(query, begin+1, mid, k, heap);
+		if(distance + tau() >= threshold)
+			search(query, mid, end, k, heap);
+	}
+	else
+	{
+		search(query, mid, end, k, heap);
+		if(mid > begin+1 && distance - tau() <= threshold)
+			search(query, begin+1, mid, k, heap);
+	}
+}
+
+std::vector<SpectraIndex::Match> SpectraIndex::query(const std::vector<eis::DataPoint>& spectrum, size_t k) const
+{
+	std::vector<Match> out;
+	if(_stepCount == 0 || k == 0 || spectrum.empty())
+		return out;
+
+	std::vector<float> query(_omegaCount*2);
+	flattenNormalized(fitToFrequencies(getOmega(), spectrum), query.data());
+
+	std::vector<std::pair<float, size_t>> heap;
+	heap.reserve(k+1);
+	search(query.data(), 0, _stepCount, std::min(k, _stepCount), heap);
+	std::sort_heap(heap.begin(), heap.end());
+
+	out.reserve(heap.size());
+	const float scale = 1/std::sqrt(static_cast<float>(_omegaCount));
+	for(const std::pair<float, size_t>& entry : heap)
+		out.push_back({entry.second, static_cast<size_t>(_indices[entry.second]), entry.first*scale});
+	return out;
+}
+
+size_t SpectraIndex::size() const
+{
+	return _stepCount;
+}
+
+const std::string& SpectraIndex::getModelStr() const
+{
+	return _model;
+}
+
+const std::vector<std::string>& SpectraIndex::getParameterNames() const
+{
+	return _parameterNames;
+}
+
+size_t SpectraIndex::getParameterCount() const
+{
+	return _parameterCount;
+}
+
+std::vector<fvalue> SpectraIndex::getOmega() const
+{
+	return std::vector<fvalue>(_omega, _omega + _omegaCount);
+}
+
+std::vector<fvalue> SpectraIndex::getParameters(size_t step) const
+{
+	return std::vector<fvalue>(_parameters + step*_parameterCount, _parameters + (step+1)*_parameterCount);
+}
+
+std::vector<eis::DataPoint> SpectraIndex::getDataPoints(size_t step) const
+{
+	const float* spectrum = _spectra + step*_omegaCount*2;
+	std::vector<eis::DataPoint> out(_omegaCount);
+	for(size_t i = 0; i < _omegaCount; ++i)
+	{
+		out[i].omega = _omega[i];
+		out[i].im = std::complex<fvalue>(spectrum[i*2], spectrum[i*2+1]);
+	}
+	return out;
+}
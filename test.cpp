@@ -24,7 +24,14 @@
 #include <complex>
 #include <chrono>
 #include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <cstring>
+#include <filesystem>
+#include <map>
+#include <fstream>
+#include <tuple>
+#include <thread>
 #include <kisstype/type.h>
 #include <kisstype/spectra.h>
 
@@ -33,7 +40,22 @@
 #include "normalize.h"
 #include "basicmath.h"
 #include "strops.h"
+#include "randomgen.h"
 #include "translators.h"
+#include "dataset.h"
+#include "npy.h"
+#include "frequencyplan.h"
+#include "rational.h"
+#include "fit.h"
+#include "spectraindex.h"
+#include "typed.h"
+#include "compcache.h"
+#include "compile.h"
+#include "kernelcatalog.h"
+#include "componant/paralellseriel.h"
+#include "componant/resistor.h"
+#include "componant/cap.h"
+#include "componant/constantphase.h"
 
 const char testEisSpectraFile10[] =
 	"EISF, 1.0.0\n"
@@ -606,8 +628,1513 @@ bool testSeriesContribution()
 	return true;
 }
 
+// the dataset and index headers share the layout of their first fields: the model length at byte 40, the length of
+// the names at 48 and the offset of the frequencies at 56
+template<typename Reader>
+static bool rejectsCorruptFile(const std::filesystem::path& path)
+{
+	std::ifstream original(path, std::ios_base::binary);
+	std::string content((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+	std::vector<std::string> corrupted(4, content);
+	corrupted[0].resize(content.size()/2);
+	const uint64_t huge = static_cast<uint64_t>(1) << 62;
+	for(size_t field = 0; field < 3; ++field)
+		std::memcpy(corrupted[field+1].data() + 40 + field*8, &huge, sizeof(huge));
+
+	std::filesystem::path corruptPath = path;
+	corruptPath += ".corrupt";
+	for(size_t i = 0; i < corrupted.size(); ++i)
+	{
+		{
+			std::ofstream file(corruptPath, std::ios_base::binary | std::ios_base::trunc);
+			file.write(corrupted[i].data(), corrupted[i].size());
+		}
+		try
+		{
+			Reader reader(corruptPath);
+			eis::Log(eis::Log::ERROR)<<__func__<<" corrupted file "<<i<<" was accepted";
+			return false;
+		}
+		catch(const eis::file_error& err)
+		{
+		}
+	}
+	std::filesystem::remove(corruptPath);
+	return true;
+}
+
+bool testDataset()
+{
+	eis::Range omega(1, 1e6, 25, true);
+	eis::Model model("r{10~100}c{1e-6}-p{1e-5, 0.5~0.9}", 4);
+	std::filesystem::path path = std::filesystem::temp_directory_path()/"eisgenerator_test.eisd";
+	size_t count = model.getRequiredStepsForSweeps();
+
+	{
+		eis::SweepDatasetWriter writer(path, model.getModelStr(), omega.getRangeVector(), model.getParameterNames());
+		for(size_t i = 0; i < count; ++i)
+		{
+			std::vector<eis::DataPoint> data = model.executeSweep(omega, i);
+			writer.append(data, model.getFlatParameters(), i);
+		}
+		writer.finish();
+	}
+
+	{
+		std::filesystem::path abortedPath = std::filesystem::temp_directory_path()/"eisgenerator_test_aborted.eisd";
+		eis::SweepDatasetWriter writer(abortedPath, model.getModelStr(), omega.getRangeVector(), model.getParameterNames());
+		writer.append(model.executeSweep(omega, 0), model.getFlatParameters(), 0);
+		writer.abort();
+		if(std::filesystem::exists(abortedPath))
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" an aborted dataset was left at "<<abortedPath;
+			return false;
+		}
+	}
+
+	if(!rejectsCorruptFile<eis::SweepDataset>(path))
+		return false;
+
+	eis::SweepDataset dataset(path);
+	if(dataset.size() != count || dataset.getOmegaCount() != omega.count || dataset.getModelStr() != model.getModelStr() ||
+		dataset.getParameterNames() != model.getParameterNames())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" dataset header dosent match the sweep written";
+		return false;
+	}
+
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::vector<eis::DataPoint> expected = model.executeSweep(omega, i);
+		std::vector<eis::DataPoint> data = dataset.getDataPoints(i);
+		std::vector<fvalue> parameters = model.getFlatParameters();
+		for(size_t j = 0; j < expected.size(); ++j)
+		{
+			if(data[j].im != expected[j].im || data[j].omega != expected[j].omega)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" step "<<i<<" point "<<j<<" expected "<<expected[j].im<<" got "<<data[j].im;
+				return false;
+			}
+		}
+		for(size_t j = 0; j < parameters.size(); ++j)
+		{
+			if(dataset.getParameters(i)[j] != parameters[j] || dataset.getIndex(i) != i)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" parameters of step "<<i<<" dont match";
+				return false;
+			}
+		}
+	}
+	std::filesystem::remove(path);
+	return true;
+}
+
+static bool checkNpySpectra(const std::string& buffer, eis::Model& model, const eis::Range& omega, size_t count)
+{
+	if(buffer.size() < 10 || std::memcmp(buffer.data(), "\x93NUMPY", 6) != 0)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" spectra.npy is not a npy file";
+		return false;
+	}
+
+	size_t headerSize = 10 + static_cast<uint8_t>(buffer[8]) + (static_cast<uint8_t>(buffer[9]) << 8);
+	std::string header(buffer.data()+10, headerSize-10);
+	std::string expectedShape = "'shape': (" + std::to_string(count) + ", " + std::to_string(omega.count) + ")";
+	if(headerSize % 64 != 0 || header.find(expectedShape) == std::string::npos || header.find("'descr': '<c8'") == std::string::npos ||
+		buffer.size() != headerSize + count*omega.count*sizeof(std::complex<float>))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" spectra.npy has an invalid header: "<<header;
+		return false;
+	}
+
+	const std::complex<float>* spectra = reinterpret_cast<const std::complex<float>*>(buffer.data()+headerSize);
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::vector<eis::DataPoint> expected = model.executeSweep(omega, i);
+		for(size_t j = 0; j < expected.size(); ++j)
+		{
+			if(spectra[i*omega.count+j] != expected[j].im)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" step "<<i<<" point "<<j<<" expected "<<expected[j].im<<" got "<<spectra[i*omega.count+j];
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+static std::string readFile(const std::filesystem::path& path)
+{
+	std::ifstream file(path, std::ios_base::in | std::ios_base::binary);
+	return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+// reads the members of an uncompressed zip archive without zip64 sizes via its central directory and verifies their crc
+static bool readStoredZip(const std::string& archive, std::map<std::string, std::string>& members)
+{
+	auto le = [&archive](size_t offset, size_t bytes) -> uint64_t
+	{
+		uint64_t value = 0;
+		for(size_t i = 0; i < bytes && offset+i < archive.size(); ++i)
+			value |= static_cast<uint64_t>(static_cast<uint8_t>(archive[offset+i])) << (i*8);
+		return value;
+	};
+	auto crc32 = [](const std::string& data)
+	{
+		uint32_t crc = 0xFFFFFFFF;
+		for(char ch : data)
+		{
+			crc ^= static_cast<uint8_t>(ch);
+			for(int i = 0; i < 8; ++i)
+				crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+		}
+		return ~crc;
+	};
+
+	size_t end = archive.rfind(std::string("PK\x05\x06", 4));
+	if(end == std::string::npos || end + 22 > archive.size())
+		return false;
+	size_t count = le(end+10, 2);
+	size_t central = le(end+16, 4);
+	for(size_t i = 0; i < count; ++i)
+	{
+		if(central + 46 > archive.size() || le(central, 4) != 0x02014b50 || le(central+10, 2) != 0)
+			return false;
+		uint32_t crc = le(central+16, 4);
+		uint64_t size = le(central+24, 4);
+		size_t nameLength = le(central+28, 2);
+		size_t extraLength = le(central+30, 2);
+		size_t commentLength = le(central+32, 2);
+		uint64_t offset = le(central+42, 4);
+		std::string name = archive.substr(central+46, nameLength);
+		if(le(offset, 4) != 0x04034b50 || archive.substr(offset+30, le(offset+26, 2)) != name)
+			return false;
+		size_t data = offset + 30 + le(offset+26, 2) + le(offset+28, 2);
+		if(data + size > archive.size())
+			return false;
+		members[name] = archive.substr(data, size);
+		if(crc32(members[name]) != crc)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" crc of "<<name<<" dosent match";
+			return false;
+		}
+		central += 46 + nameLength + extraLength + commentLength;
+	}
+	return true;
+}
+
+bool testNpy()
+{
+	eis::Range omega(1, 1e6, 25, true);
+	eis::Model model("r{10~100}c{1e-6}-p{1e-5, 0.5~0.9}", 4);
+	std::filesystem::path path = std::filesystem::temp_directory_path()/"eisgenerator_test_npy";
+	std::filesystem::path npzPath = std::filesystem::temp_directory_path()/"eisgenerator_test.npz";
+	size_t count = model.getRequiredStepsForSweeps();
+
+	{
+		eis::NpySweepWriter writer(path, model.getModelStr(), omega.getRangeVector(), model.getParameterNames());
+		eis::NpySweepWriter npzWriter(npzPath, model.getModelStr(), omega.getRangeVector(), model.getParameterNames(), true, true);
+		for(size_t i = 0; i < count; ++i)
+		{
+			std::vector<eis::DataPoint> data = model.executeSweep(omega, i);
+			writer.append(data, model.getFlatParameters(), i);
+			npzWriter.append(data, model.getFlatParameters(), i);
+		}
+		writer.finish();
+		npzWriter.finish();
+	}
+
+	{
+		// a writer that is destroyed without finish discards its output
+		std::filesystem::path abortedPath = std::filesystem::temp_directory_path()/"eisgenerator_test_aborted.npz";
+		eis::NpySweepWriter writer(abortedPath, model.getModelStr(), omega.getRangeVector(), model.getParameterNames(), true, true);
+		writer.append(model.executeSweep(omega, 0), model.getFlatParameters(), 0);
+	}
+	if(std::filesystem::exists(std::filesystem::temp_directory_path()/"eisgenerator_test_aborted.npz") ||
+		std::filesystem::exists(std::filesystem::temp_directory_path()/"eisgenerator_test_aborted.npz.tmp"))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" an unfinished npz was left behind";
+		return false;
+	}
+
+	if(!checkNpySpectra(readFile(path/"spectra.npy"), model, omega, count))
+		return false;
+
+	std::map<std::string, std::string> members;
+	if(!readStoredZip(readFile(npzPath), members))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" "<<npzPath<<" is not a valid archive";
+		return false;
+	}
+	for(const char* member : {"spectra.npy", "omega.npy", "parameters.npy", "indices.npy", "model.json"})
+	{
+		if(members.count(member) == 0 || (std::string(member) != "spectra.npy" && members[member] != readFile(path/member)))
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" "<<member<<" in "<<npzPath<<" dosent match the npy file";
+			return false;
+		}
+	}
+	if(members["spectra.npy"] != readFile(path/"spectra.npy") || !checkNpySpectra(members["spectra.npy"], model, omega, count))
+		return false;
+
+	std::filesystem::remove_all(path);
+	std::filesystem::remove(npzPath);
+	return true;
+}
+
+bool testSampling()
+{
+	eis::Model model("r{10~1000L}c{1e-6~1e-4L}-r{0~100}", 10);
+	std::vector<eis::Range> ranges = model.getFlatParameterRanges();
+	const size_t count = 64;
+	const eis::Model::SamplingMode modes[] = {eis::Model::SAMPLE_UNIFORM, eis::Model::SAMPLE_LOG_UNIFORM,
+		eis::Model::SAMPLE_LATIN_HYPERCUBE, eis::Model::SAMPLE_SOBOL};
+
+	for(eis::Model::SamplingMode mode : modes)
+	{
+		std::vector<std::vector<bool>> strata(ranges.size(), std::vector<bool>(count, false));
+		for(size_t i = 0; i < count; ++i)
+		{
+			std::vector<fvalue> parameters = model.getSampleParameters(i, count, mode, 42);
+			if(parameters != model.getSampleParameters(i, count, mode, 42) || parameters == model.getSampleParameters(i, count, mode, 43))
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" mode "<<mode<<" sample "<<i<<" is not determined by its seed";
+				return false;
+			}
+
+			for(size_t j = 0; j < ranges.size(); ++j)
+			{
+				if(parameters[j] < ranges[j].start || parameters[j] > ranges[j].end)
+				{
+					eis::Log(eis::Log::ERROR)<<__func__<<" mode "<<mode<<" sample "<<i<<" parameter "<<j<<" is out of range "<<parameters[j];
+					return false;
+				}
+				double unit = ranges[j].log ? std::log10(parameters[j]/ranges[j].start)/std::log10(ranges[j].end/ranges[j].start) :
+					(parameters[j] - ranges[j].start)/(ranges[j].end - ranges[j].start);
+				strata[j][std::min<size_t>(unit*count, count-1)] = true;
+			}
+		}
+
+		// latin hypercube and sobol sets of 2^n samples hit every stratum exactly once
+		if(mode != eis::Model::SAMPLE_LATIN_HYPERCUBE && mode != eis::Model::SAMPLE_SOBOL)
+			continue;
+		for(size_t j = 0; j < ranges.size(); ++j)
+		{
+			if(std::find(strata[j].begin(), strata[j].end(), false) != strata[j].end())
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" mode "<<mode<<" parameter "<<j<<" is not stratified";
+				return false;
+			}
+		}
+	}
+
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 25, true).getRangeVector();
+	std::vector<std::vector<eis::DataPoint>> sweeps = model.executeSamples(omega, count, eis::Model::SAMPLE_SOBOL, 7, true);
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::vector<fvalue> parameters = model.getSampleParameters(i, count, eis::Model::SAMPLE_SOBOL, 7);
+		std::stringstream ss;
+		ss<<std::setprecision(9)<<"r{"<<parameters[0]<<"}c{"<<parameters[1]<<"}-r{"<<parameters[2]<<"}";
+		eis::Model fixed(ss.str());
+		std::vector<eis::DataPoint> expected = fixed.executeSweep(omega);
+		if(eis::eisDistance(expected, sweeps[i]) > 1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" sample "<<i<<" dosent match a model with its parameters";
+			return false;
+		}
+	}
+
+	return model.getFlatParameterRanges()[0].count == 10;
+}
+
+bool testRandom()
+{
+	// known answer vectors of the Random123 reference implementation
+	const std::array<uint32_t, 4> counters[] = {{0, 0, 0, 0}, {0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff},
+		{0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}};
+	const std::array<uint32_t, 2> keys[] = {{0, 0}, {0xffffffff, 0xffffffff}, {0xa4093822, 0x299f31d0}};
+	const std::array<uint32_t, 4> expected[] = {{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8},
+		{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd}, {0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1}};
+	for(size_t i = 0; i < 3; ++i)
+	{
+		if(rd::philox(counters[i], keys[i]) != expected[i])
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" philox known answer test "<<i<<" failed";
+			return false;
+		}
+	}
+
+	std::vector<float> batch(1001);
+	rd::Stream batchStream(5, 3);
+	batchStream.next32();
+	batchStream.uniform(batch.data(), batch.size());
+	rd::Stream serialStream(5, 3);
+	serialStream.seek(1);
+	for(size_t i = 0; i < batch.size(); ++i)
+	{
+		float serial;
+		serialStream.uniform(&serial, 1);
+		if(serial != batch[i] || batch[i] < 0 || batch[i] >= 1)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" batched uniform values differ from serial ones at "<<i;
+			return false;
+		}
+	}
+
+	std::vector<float> normal(100001);
+	rd::Stream(1).normal(normal.data(), normal.size(), 2, 3);
+	double mean = 0;
+	double variance = 0;
+	for(float value : normal)
+		mean += value;
+	mean /= normal.size();
+	for(float value : normal)
+		variance += (value-mean)*(value-mean);
+	variance /= normal.size();
+	if(std::abs(mean-2) > 0.05 || std::abs(std::sqrt(variance)-3) > 0.05)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" normal distribution has mean "<<mean<<" and sigma "<<std::sqrt(variance);
+		return false;
+	}
+
+	eis::Model model("r{100}c{1e-6}");
+	std::vector<eis::DataPoint> a = model.executeSweep(eis::Range(1, 1e6, 50, true));
+	std::vector<eis::DataPoint> b = a;
+	std::vector<eis::DataPoint> c = a;
+	eis::noise(a, 1, false, 10, 4);
+	eis::noise(b, 1, false, 10, 4);
+	eis::noise(c, 1, false, 10, 5);
+	for(size_t i = 0; i < a.size(); ++i)
+	{
+		if(a[i].im != b[i].im || a[i].im == c[i].im)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" seeded noise is not reproducible";
+			return false;
+		}
+	}
+
+	// seeding again after the stream of this thread was used must restart it
+	rd::seed(7);
+	uint64_t first = rd::uid();
+	rd::seed(7);
+	if(rd::uid() != first)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" seeding again did not restart the thread stream";
+		return false;
+	}
+
+	// index streams must not depend on the thread they are used from
+	uint64_t local = rd::indexStream(3).next64();
+	uint64_t remote = 0;
+	std::thread thread([&remote](){remote = rd::indexStream(3).next64();});
+	thread.join();
+	if(local != remote || local == rd::indexStream(4).next64())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" index streams depend on the thread";
+		return false;
+	}
+	return true;
+}
+
+bool testParser()
+{
+	std::string wide;
+	for(size_t i = 0; i < 15; ++i)
+		wide.append("(r{" + std::to_string(i+1) + "}r{" + std::to_string(i+1) + "})-");
+	wide.pop_back();
+	eis::Model wideModel(wide);
+	eis::DataPoint widePoint = wideModel.execute(1);
+	if(wideModel.getParameterCount() != 30 || std::abs(widePoint.im.real() - 60) > 1e-3)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" wide model "<<wide<<" was parsed incorrectly: "<<widePoint.im;
+		return false;
+	}
+
+	std::string deep = "r{1}";
+	for(size_t i = 0; i < 40; ++i)
+		deep = "(" + deep + "r{1})";
+	eis::Model deepModel(deep);
+	if(deepModel.getParameterCount() != 41 || std::abs(deepModel.execute(1).im.real() - 1.0/41) > 1e-5)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" deep model was parsed incorrectly";
+		return false;
+	}
+
+	const std::pair<std::string, std::string> invalid[] = {{"r{1}-x", "position 5"}, {"r{1}(c{1e-6}", "position 4"},
+		{"r{1})", "position 4"}, {"r{1}c{1e-6", "position 5"}, {"", "empty"}};
+	for(const std::pair<std::string, std::string>& str : invalid)
+	{
+		try
+		{
+			eis::Model model(str.first);
+			eis::Log(eis::Log::ERROR)<<__func__<<" invalid model string "<<str.first<<" was accepted";
+			return false;
+		}
+		catch(const eis::parse_errror& err)
+		{
+			if(std::string(err.what()).find(str.second) == std::string::npos)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" unexpected error for "<<str.first<<": "<<err.what();
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool testBindParameters()
+{
+	eis::Model sweep("r{10~100}c{1e-6~1e-5}-(r{5}l{1e-6~1e-5})", 4);
+	eis::Model bound("rc-(rl)");
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 25, true).getRangeVector();
+	size_t count = sweep.getRequiredStepsForSweeps();
+
+	std::vector<std::vector<fvalue>> rows;
+	for(size_t i = 0; i < count; ++i)
+	{
+		std::vector<eis::DataPoint> expected = sweep.executeSweep(omega, i);
+		bound.bindParameters(sweep.getModelStrWithParam(i));
+		if(eis::eisDistance(expected, bound.executeSweep(omega)) > 1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" binding "<<sweep.getModelStrWithParam(i)<<" gives a different spectrum";
+			return false;
+		}
+		rows.push_back(sweep.getFlatParameters());
+	}
+
+	std::vector<std::vector<eis::DataPoint>> batch = bound.executeParameterSweeps(omega, rows, true);
+	for(size_t i = 0; i < count; ++i)
+	{
+		bound.setFlatParameters(rows[i]);
+		if(eis::eisDistance(batch[i], sweep.executeSweep(omega, i)) > 1e-3 || bound.getFlatParameters() != rows[i])
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" row "<<i<<" of batched execution dosent match the sweep";
+			return false;
+		}
+	}
+
+	// the elements of these match, but not how they are connected
+	const std::pair<std::string, std::string> mismatched[] = {{"rc-(rl)", "r{1}c{1e-6}-r{1}"}, {"rc", "r{100}-c{1e-6}"},
+		{"r-c", "r{100}c{1e-6}"}, {"rc-(rl)", "r{1}-c{1e-6}-r{1}l{1e-6}"}};
+	for(const std::pair<std::string, std::string>& pair : mismatched)
+	{
+		try
+		{
+			eis::Model model(pair.first);
+			model.bindParameters(pair.second);
+			eis::Log(eis::Log::ERROR)<<__func__<<" "<<pair.second<<" was bound to "<<pair.first;
+			return false;
+		}
+		catch(const eis::parse_errror& err)
+		{
+		}
+	}
+	return true;
+}
+
+bool testCanonical()
+{
+	const std::pair<std::string, std::string> equivalent[] = {{"rc", "cr"}, {"r-c", "c-r"}, {"(rc)l", "r(cl)"},
+		{"r-(c-r)", "r-r-c"}, {"r-cp-w", "w-pc-r"}, {"(r-c)l", "l(c-r)"}};
+	for(const std::pair<std::string, std::string>& pair : equivalent)
+	{
+		eis::Model a(pair.first);
+		eis::Model b(pair.second);
+		if(a.getCanonicalModelStr() != b.getCanonicalModelStr() || a.getUuid() != b.getUuid())
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<' '<<pair.first<<" and "<<pair.second<<" have different canonical forms "
+				<<a.getCanonicalModelStr()<<" and "<<b.getCanonicalModelStr();
+			return false;
+		}
+	}
+
+	if(eis::Model("r").getUuid() == eis::Model("c").getUuid() || eis::Model("rc").getUuid() == eis::Model("r-c").getUuid())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" different circuits share a uuid";
+		return false;
+	}
+
+	eis::Model merged("r{10}-c{1e-6}-r{20~40}-(l{1e-6}r{5})", 3);
+	std::vector<std::vector<size_t>> expectedMap = {{1}, {3}, {4}, {0, 2}};
+	if(merged.getCanonicalModelStr() != "c-lr-r" || merged.getCanonicalParameterMap() != expectedMap)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" unexpected canonical form "<<merged.getCanonicalModelStr();
+		return false;
+	}
+
+	eis::Range omega(1, 1e6, 25, true);
+	eis::Model reordered("r{5}l{1e-6}-r{20~40}-c{1e-6}-r{10}", 3);
+	std::vector<std::vector<eis::DataPoint>> expected;
+	for(size_t i = 0; i < merged.getRequiredStepsForSweeps(); ++i)
+	{
+		expected.push_back(std::vector<eis::DataPoint>());
+		for(fvalue omegaStep : omega.getRangeVector())
+			expected.back().push_back(merged.execute(omegaStep, i));
+	}
+	if(!merged.compile() || !reordered.compile())
+		return true;
+	for(size_t i = 0; i < merged.getRequiredStepsForSweeps(); ++i)
+	{
+		if(eis::eisDistance(expected[i], merged.executeSweep(omega, i)) > 1e-3 ||
+			eis::eisDistance(expected[i], reordered.executeSweep(omega, i)) > 1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" the shared canonical kernel gives a different result at step "<<i;
+			return false;
+		}
+	}
+	return true;
+}
+
+static size_t countOccurrences(const std::string& str, const std::string& pattern)
+{
+	size_t count = 0;
+	for(size_t pos = str.find(pattern); pos != std::string::npos; pos = str.find(pattern, pos+1))
+		++count;
+	return count;
+}
+
+bool testExpressionGraph()
+{
+	eis::Model model("r{100}-p{1e-5, 0.8}c{1e-6}-t{50, 1e-6, 0.5, 0.5}");
+	std::string code = model.getCode();
+	size_t loop = code.find("for(");
+
+	if(countOccurrences(code, "std::pow(omega") != 1 || countOccurrences(code, "std::pow(std::complex<fvalue>") != 0 ||
+		countOccurrences(code, "std::complex<fvalue>(0.0f, omega)") != 1)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" common subexpressions where not eliminated:\n"<<code;
+		return false;
+	}
+
+	if(loop == std::string::npos || code.find("std::cos") > loop || code.find("std::sin") > loop)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" parameter only expressions where not hoisted out of the omega loop:\n"<<code;
+		return false;
+	}
+
+	eis::Model parallel("r{100}c{1e-6}");
+	if(countOccurrences(parallel.getCode(), "/") > 2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" reciprocals where not simplified:\n"<<parallel.getCode();
+		return false;
+	}
+	return true;
+}
+
+bool testSpecialization()
+{
+	const std::string modelStr = "r{100}-r{10~1e3L}c{1e-6}-p{1e-5, 0.8}-r{20}";
+	eis::Model reference(modelStr, 5);
+	eis::Model model(modelStr, 5);
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 25, true).getRangeVector();
+
+	if(!model.compile(true) || model.getSpecializedUuid() == 0 || model.getSpecializedUuid() == model.getUuid())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" no specialized kernel was compiled for "<<modelStr;
+		return false;
+	}
+
+	for(size_t i = 0; i < model.getRequiredStepsForSweeps(); ++i)
+	{
+		if(eis::eisDistance(model.executeSweep(omega, i), reference.executeSweep(omega, i)) > 1e-2)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" specialized kernel gives a different spectrum at step "<<i;
+			return false;
+		}
+	}
+
+	// changing a baked in parameter must fall back to the generic kernel
+	std::vector<fvalue> parameters = reference.getFlatParameters();
+	parameters[0] = 500;
+	if(eis::eisDistance(model.executeParameters(omega, parameters), reference.executeParameters(omega, parameters)) > 1e-2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" changed fixed parameters are ignored by the compiled model";
+		return false;
+	}
+
+	eis::Model other("r{100}-r{10~1e3L}c{1e-6}-p{1e-5, 0.8}-r{30}", 5);
+	other.compile(true);
+	if(other.getUuid() != model.getUuid() || other.getSpecializedUuid() == model.getSpecializedUuid())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" specialized kernels are not keyed on the specialized values";
+		return false;
+	}
+	return true;
+}
+
+bool testFrequencyPlan()
+{
+	const std::string modelStr = "r{100}-r{10~1e3L}c{1e-6}-p{1e-5~1e-4L, 0.8}-w{50}-t{50, 1e-6, 0.7, 0.5}-o{50, 1e-6, 0.7, 0.5}-l{1e-6}";
+	eis::Model model(modelStr, 3);
+	eis::FrequencyPlan plan(eis::Range(1, 1e6, 25, true));
+
+	for(size_t i = 0; i < plan.size(); ++i)
+	{
+		fvalue omega = plan.getOmega()[i];
+		if(!eis::fvalueEq(plan.getInverseOmega()[i]*omega, 1) || !eis::fvalueEq(plan.getSqrtOmega()[i], std::sqrt(omega)) ||
+			std::abs(plan.powAt(0.7, i) - std::pow(omega, fvalue(0.7))) > std::pow(omega, fvalue(0.7))*1e-5)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" frequency tables are wrong at omega "<<omega;
+			return false;
+		}
+	}
+
+	std::vector<size_t> indices;
+	for(size_t i = 0; i < model.getRequiredStepsForSweeps(); ++i)
+		indices.push_back(i);
+	std::vector<std::vector<eis::DataPoint>> sweeps = model.executeSweeps(plan, indices);
+
+	for(size_t i = 0; i < indices.size(); ++i)
+	{
+		std::vector<eis::DataPoint> expected;
+		for(fvalue omega : plan.getOmega())
+			expected.push_back(model.execute(omega, i));
+
+		std::vector<eis::DataPoint> planned = model.executeSweep(plan, i);
+		for(size_t j = 0; j < expected.size(); ++j)
+		{
+			fvalue error = std::abs(planned[j].im - expected[j].im) + std::abs(sweeps[i][j].im - expected[j].im);
+			if(error > std::abs(expected[j].im)*1e-4)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" planned execution of "<<modelStr<<" differs from pointwise execution at step "
+					<<i<<": "<<planned[j].im<<" vs "<<expected[j].im;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool testResolvedParameters()
+{
+	eis::Model model("r{1~1e4L}-p{1e-6~1e-4L, 0.5~0.9}-w{10~100L}", 4);
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 25, true).getRangeVector();
+
+	for(size_t i = 0; i < model.getRequiredStepsForSweeps(); i += 7)
+	{
+		std::vector<eis::DataPoint> resolved = model.executeSweep(omega, i);
+		if(eis::eisDistance(resolved, model.executeParameters(omega, model.getFlatParameters())) > 1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" resolved parameters at step "<<i<<" dont match "<<model.getModelStrWithParam();
+			return false;
+		}
+	}
+
+	// changing a range after it was resolved must not use the stale value
+	eis::Componant* resistor = model.getFlatComponants()[0];
+	model.resolveSteps(0);
+	resistor->getParamRanges()[0] = eis::Range(42, 42, 1);
+	if(!eis::fvalueEq(resistor->execute(1).real(), 42))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" stale resolved parameter used after the range was changed";
+		return false;
+	}
+	return true;
+}
+
+bool testRational()
+{
+	eis::Parallel rc({new eis::Resistor(100), new eis::Cap(1e-6)});
+	eis::RationalImpedance rational(&rc, {100, 1e-6});
+	if(rational.getNumerator().size() != 1 || rational.getDenominator().size() != 2 ||
+		!eis::fvalueEq(rational.getDenominator()[1]/rational.getDenominator()[0], 1e-4) ||
+		!eis::fvalueEq(rational.getNumerator()[0]/rational.getDenominator()[0], 100))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" unexpected rational function for "<<rc.getComponantString();
+		return false;
+	}
+
+	eis::Parallel cpe({new eis::Resistor(100), new eis::Cpe(1e-6, 0.8)});
+	if(eis::RationalImpedance::isRational(&cpe))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" "<<cpe.getComponantString()<<" was considered rational";
+		return false;
+	}
+
+	const std::string ladder = "r{10}-l{1e-6}-(c{1e-6~1e-5L}(r{100}-(c{1e-6}(r{100~1e3}-(c{1e-6}(r{100}-c{1e-4}))))))";
+	eis::Model model(ladder, 3);
+	eis::FrequencyPlan plan(eis::Range(1, 1e6, 50, true));
+	for(size_t i = 0; i < model.getRequiredStepsForSweeps(); ++i)
+	{
+		std::vector<eis::DataPoint> data = model.executeSweep(plan, i);
+		for(size_t j = 0; j < data.size(); ++j)
+		{
+			std::complex<fvalue> expected = model.execute(data[j].omega, i).im;
+			if(std::abs(data[j].im - expected) > std::abs(expected)*1e-4)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" rational evaluation of "<<ladder<<" at step "<<i<<" omega "
+					<<data[j].omega<<" gives "<<data[j].im<<" expected "<<expected;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool testAdmittance()
+{
+	eis::Model model("r{100}-r{1e3}c{1e-6}p{1e-5, 0.8}w{50}l{1e-3}-t{50, 1e-6, 0.7, 0.5}");
+	for(eis::Componant* componant : model.getFlatComponants())
+	{
+		for(fvalue omega : {1.0f, 1e3f, 1e6f})
+		{
+			std::complex<fvalue> expected = std::complex<fvalue>(1, 0)/componant->execute(omega);
+			if(std::abs(componant->executeAdmittance(omega) - expected) > std::abs(expected)*1e-5)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" admittance of "<<componant->getComponantString()<<" at "<<omega
+					<<" is "<<componant->executeAdmittance(omega)<<" expected "<<expected;
+				return false;
+			}
+		}
+	}
+
+	eis::Model parallel("r{100}p{1e-5, 0.8}");
+	std::string code = parallel.getCode();
+	if(countOccurrences(code, "/") > 2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" parallel elements are not combined in the admittance domain:\n"<<code;
+		return false;
+	}
+
+	eis::Model shorted("r{0}c{1e-6}");
+	if(std::abs(shorted.execute(1e3).im) != 0)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" a shorted parallel has an impedance of "<<shorted.execute(1e3).im;
+		return false;
+	}
+	return true;
+}
+
+bool testLadder()
+{
+	const std::vector<std::pair<std::string, std::string>> equivalents = {
+		{"k{300, 3e-6, 3}", "r{100}-(c{1e-6}(r{100}-(c{1e-6}(r{100}-c{1e-6}))))"},
+		{"k{700, 7e-6, 3, 2}", "r{100}-(c{1e-6}(r{200}-(c{2e-6}(r{400}-c{4e-6}))))"}
+	};
+	for(const std::pair<std::string, std::string>& pair : equivalents)
+	{
+		eis::Model ladder(pair.first);
+		eis::Model reference(pair.second);
+		for(fvalue omega : {1.0f, 1e2f, 1e4f, 1e6f})
+		{
+			std::complex<fvalue> expected = reference.execute(omega).im;
+			std::complex<fvalue> actual = ladder.execute(omega).im;
+			if(std::abs(actual - expected) > std::abs(expected)*1e-4)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" "<<pair.first<<" at "<<omega<<" gives "<<actual
+					<<" while "<<pair.second<<" gives "<<expected;
+				return false;
+			}
+		}
+	}
+
+	if(!testCompiledConsistancy("r{50}-k{1e3, 1e-5, 20, 1.2}"))
+		return false;
+
+	for(const char* modelStr : {"k{1e3, 1e-5, 5, 0}", "k{1e3, 1e-5, 5, -2}", "k{1e3, 1e-5, 5, -1~2}"})
+	{
+		try
+		{
+			eis::Model invalid(modelStr);
+			eis::Log(eis::Log::ERROR)<<__func__<<" the non positive grading of "<<modelStr<<" was accepted";
+			return false;
+		}
+		catch(const eis::parse_errror& err)
+		{
+		}
+	}
+
+	// a grading that is set after construction is clamped instead
+	eis::Model graded("k{1e3, 1e-5, 5, 2}");
+	graded.setFlatParameters({1e3, 1e-5, 5, 0});
+	for(const eis::DataPoint& point : graded.executeSweep(eis::Range(1, 1e6, 10, true)))
+	{
+		if(!std::isfinite(point.im.real()) || !std::isfinite(point.im.imag()))
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" a ladder with a grading of 0 is not finite at "<<point.omega;
+			return false;
+		}
+	}
+
+	eis::Model large("k{1e3, 1e-5, 5000}");
+	std::vector<eis::DataPoint> data = large.executeSweep(eis::Range(1e-2, 1e6, 25, true));
+	for(const eis::DataPoint& point : data)
+	{
+		if(!std::isfinite(point.im.real()) || !std::isfinite(point.im.imag()))
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" a ladder of 5000 stages is not finite at "<<point.omega;
+			return false;
+		}
+	}
+
+	// at low frequencies the ladder approaches its total capacitance in series with a third of its resistance
+	std::complex<fvalue> low = data.front().im;
+	if(std::abs(low.real() - 1e3f/3)/(1e3f/3) > 1e-2 || std::abs(low.imag()*data.front().omega*1e-5f + 1) > 1e-2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" a ladder of 5000 stages gives "<<low
+			<<" at "<<data.front().omega;
+		return false;
+	}
+
+	// strongly graded ladders with many stages are compared to the naive continued fraction in long double,
+	// whose exponent range is large enough to hold every stage value
+	const std::vector<std::tuple<long double, long double, size_t, long double>> gradedLadders = {{100, 1e-6, 1000, 0.9}, {100, 1e-6, 2000, 1.5}};
+	for(const auto& [r, c, stages, g] : gradedLadders)
+	{
+		std::string modelStr = "k{" + std::to_string(r) + ", " + std::to_string(c) + ", " + std::to_string(stages) +
+			", " + std::to_string(g) + "}";
+		eis::Model model(modelStr);
+		long double scale = (1-std::pow(g, stages))/(1-g);
+		std::vector<eis::DataPoint> sweep = model.executeSweep(eis::Range(1e-2, 1e6, 25, true));
+		for(const eis::DataPoint& point : sweep)
+		{
+			long double stage = std::pow(g, stages-1)/scale;
+			std::complex<long double> expected(r*stage, -1/(point.omega*c*stage));
+			for(size_t k = 1; k < stages; ++k)
+			{
+				stage /= g;
+				expected = r*stage + expected/(1.0L + std::complex<long double>(0, point.omega*c*stage)*expected);
+			}
+
+			std::complex<fvalue> single = model.execute(point.omega).im;
+			if(std::abs(std::complex<long double>(point.im) - expected) > std::abs(expected)*1e-4 ||
+				std::abs(std::complex<long double>(single) - expected) > std::abs(expected)*1e-4)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" "<<modelStr<<" gives "<<point.im<<" and "<<single<<" at "<<point.omega
+					<<" expected "<<std::complex<double>(expected);
+				return false;
+			}
+		}
+
+		if(!testCompiledConsistancy(modelStr))
+			return false;
+	}
+	return true;
+}
+
+bool testNetwork()
+{
+	eis::FrequencyPlan plan(eis::Range(1, 1e6, 25, true));
+	eis::Model network("n[1,2:r{100};2,0:c{1e-6};2,0:r{1e3}]");
+	eis::Model reference("r{100}-r{1e3}c{1e-6}");
+	std::vector<eis::DataPoint> data = network.executeSweep(plan);
+	for(const eis::DataPoint& point : data)
+	{
+		std::complex<fvalue> expected = reference.execute(point.omega).im;
+		if(std::abs(point.im - expected) > std::abs(expected)*1e-4 ||
+			std::abs(network.execute(point.omega).im - expected) > std::abs(expected)*1e-4)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" "<<network.getModelStr()<<" gives "<<point.im<<" at "<<point.omega
+				<<" expected "<<expected;
+			return false;
+		}
+	}
+
+	// a bridge can not be expressed as a series parallel circuit
+	const double r1 = 100, r2 = 200, r3 = 300, r4 = 400, r5 = 500;
+	const double bridgeResistance = (r1*r2*(r3+r4) + r3*r4*(r1+r2) + r5*(r1+r3)*(r2+r4))/((r1+r2)*(r3+r4) + r5*(r1+r2+r3+r4));
+	eis::Model bridge("n[1,2:r{100};1,3:r{200};2,0:r{300};3,0:r{400};2,3:r{500}]");
+	std::complex<fvalue> bridgeImpedance = bridge.execute(1e3).im;
+	if(std::abs(bridgeImpedance.real() - bridgeResistance) > bridgeResistance*1e-5 || std::abs(bridgeImpedance.imag()) > 1e-3)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" "<<bridge.getModelStr()<<" gives "<<bridgeImpedance<<" expected "<<bridgeResistance;
+		return false;
+	}
+
+	const std::string sweptStr = "n[1,2:r{100};1,3:c{1e-6};2,0:r{300}-w{100};3,0:r{10~1e3L};2,3:c{1e-7}]";
+	eis::Model swept(sweptStr, 3);
+	for(size_t i = 0; i < swept.getRequiredStepsForSweeps(); ++i)
+	{
+		data = swept.executeSweep(plan, i);
+		eis::Model roundTrip(swept.getModelStrWithParam(i));
+		for(const eis::DataPoint& point : data)
+		{
+			std::complex<fvalue> expected = swept.execute(point.omega, i).im;
+			std::complex<fvalue> parsed = roundTrip.execute(point.omega).im;
+			if(std::abs(point.im - expected) > std::abs(expected)*1e-4 || std::abs(parsed - expected) > std::abs(expected)*1e-3)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" "<<sweptStr<<" gives "<<point.im<<" at step "<<i<<" omega "<<point.omega
+					<<" expected "<<expected<<" and "<<roundTrip.getModelStr()<<" gives "<<parsed;
+				return false;
+			}
+		}
+	}
+
+	if(!testCompiledConsistancy(sweptStr) || !testCompiledConsistancy("n[1,2:r{100};1,3:k{1e3, 1e-6, 5};2,0:r{300};3,0:c{1e-6};2,3:r{500}]"))
+		return false;
+
+	try
+	{
+		eis::Model disconnected("n[1,0:r{100};2,3:r{10}]");
+		eis::Log(eis::Log::ERROR)<<__func__<<" a network with disconnected nodes was accepted";
+		return false;
+	}
+	catch(const eis::parse_errror& err)
+	{
+	}
+
+	for(const char* modelStr : {"n[1,0:r{1};0,99999999999:r{1}]", "n[1,0:r{1};0,99999999999999999999999:r{1}]"})
+	{
+		try
+		{
+			eis::Model huge(modelStr);
+			eis::Log(eis::Log::ERROR)<<__func__<<" a network with the node numbers of "<<modelStr<<" was accepted";
+			return false;
+		}
+		catch(const eis::parse_errror& err)
+		{
+		}
+	}
+	return true;
+}
+
+static bool checkJacobian(eis::Model& model, const std::vector<fvalue>& omega, fvalue tolerance)
+{
+	std::vector<fvalue> parameters = model.getFlatParameters();
+	std::vector<std::complex<fvalue>> jacobian;
+	std::vector<eis::DataPoint> data = model.executeJacobian(omega, parameters, jacobian);
+	for(size_t j = 0; j < parameters.size(); ++j)
+	{
+		std::vector<fvalue> upper = parameters;
+		std::vector<fvalue> lower = parameters;
+		upper[j] *= 1.001;
+		lower[j] *= 0.999;
+		std::vector<eis::DataPoint> upperData = model.executeParameters(omega, upper);
+		std::vector<eis::DataPoint> lowerData = model.executeParameters(omega, lower);
+		for(size_t i = 0; i < omega.size(); ++i)
+		{
+			std::complex<fvalue> expected = (upperData[i].im - lowerData[i].im)/(upper[j] - lower[j]);
+			std::complex<fvalue> actual = jacobian[i*parameters.size()+j];
+			// the derivatives are compared scaled by their parameter, relative to the impedance
+			if(std::abs(actual - expected)*std::abs(parameters[j]) > std::abs(data[i].im)*tolerance)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" derivative of "<<model.getModelStr()<<" with respect to "
+					<<model.getParameterNames()[j]<<" at "<<omega[i]<<" is "<<actual<<" expected "<<expected;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool testJacobian()
+{
+	const std::vector<fvalue> omega = {1, 1e2, 1e4, 1e5};
+	const std::vector<std::string> models = {
+		"r{100}-r{1e3}c{1e-6}-p{1e-5, 0.8}w{50}-l{1e-4}-t{50, 1e-6, 0.7, 0.5}-o{50, 1e-6, 0.7, 0.5}-r{10}",
+		"n[1,2:r{100};1,3:c{1e-6};2,0:r{300}-w{100};3,0:p{1e-5, 0.8};2,3:c{1e-7}]",
+		"r{10}-k{1e3, 1e-5, 10, 1.2}",
+		"k{100, 1e-6, 400, 0.98}"
+	};
+	for(const std::string& modelStr : models)
+	{
+		eis::Model model(modelStr, 100, false);
+		if(!checkJacobian(model, omega, 1e-2))
+			return false;
+	}
+
+	eis::Model model(models[0], 100, false);
+	if(model.getJacobianCode().empty())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" no jacobian code for "<<models[0];
+		return false;
+	}
+
+	std::vector<fvalue> parameters = model.getFlatParameters();
+	std::vector<std::complex<fvalue>> interpreted;
+	std::vector<eis::DataPoint> data = model.executeJacobian(omega, parameters, interpreted);
+	model.compile(false, true);
+	std::vector<std::complex<fvalue>> compiled;
+	model.executeJacobian(omega, parameters, compiled);
+	for(size_t i = 0; i < compiled.size(); ++i)
+	{
+		size_t parameter = i % parameters.size();
+		if(std::abs(compiled[i] - interpreted[i])*parameters[parameter] > std::abs(data[i/parameters.size()].im)*1e-4)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" compiled jacobian of "<<models[0]<<" gives "<<compiled[i]
+				<<" at "<<i<<" expected "<<interpreted[i];
+			return false;
+		}
+	}
+	return checkJacobian(model, omega, 1e-2);
+}
+
+bool testFit()
+{
+	const std::vector<fvalue> truth = {100, 1e3, 1e-6, 1e-5, 0.8};
+	eis::Model model("r{10~1e3L}-r{100~1e4L}c{1e-7~1e-5L}-p{1e-6~1e-4L, 0.5~0.95}", 10, false);
+	eis::Range omega(1, 1e6, 40, true);
+	std::vector<eis::DataPoint> spectrum = model.executeParameters(omega.getRangeVector(), truth);
+
+	eis::FitResult result = eis::fit(model, spectrum);
+	if(!result.converged || result.parameters.size() != truth.size())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" fit did not converge after "<<result.iterations<<" iterations";
+		return false;
+	}
+	for(size_t i = 0; i < truth.size(); ++i)
+	{
+		if(std::abs(result.parameters[i] - truth[i]) > std::abs(truth[i])*1e-2)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" parameter "<<i<<" fitted to "<<result.parameters[i]<<" expected "<<truth[i];
+			return false;
+		}
+	}
+	for(size_t i = 0; i < spectrum.size(); ++i)
+	{
+		if(std::abs(result.residuals[i]) > std::abs(spectrum[i].im)*1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" residual "<<result.residuals[i]<<" at "<<spectrum[i].omega;
+			return false;
+		}
+	}
+
+	std::vector<fvalue> shifted = truth;
+	shifted[1] = 2e3;
+	std::vector<std::vector<eis::DataPoint>> spectra = {spectrum, model.executeParameters(omega.getRangeVector(), shifted)};
+	model.compile(false, true);
+	std::vector<eis::FitResult> results = eis::fit(model, spectra);
+	if(results.size() != 2 || std::abs(results[0].parameters[1] - truth[1]) > truth[1]*1e-2 ||
+		std::abs(results[1].parameters[1] - shifted[1]) > shifted[1]*1e-2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" batched fit gives a wrong resistance";
+		return false;
+	}
+	return true;
+}
+
+bool testSpectraIndex()
+{
+	eis::Model model("r{10~1e3L}-r{100~1e4L}c{1e-7~1e-5L}", 12, false);
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 30, true).getRangeVector();
+	std::filesystem::path path = std::filesystem::temp_directory_path()/"eisgenerator_test.eisi";
+	eis::SpectraIndex::build(path, model, omega);
+
+	if(!rejectsCorruptFile<eis::SpectraIndex>(path))
+		return false;
+
+	eis::SpectraIndex index(path);
+	if(index.size() != model.getRequiredStepsForSweeps() || index.getParameterCount() != model.getParameterCount())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" index has "<<index.size()<<" spectra expected "<<model.getRequiredStepsForSweeps();
+		return false;
+	}
+
+	std::vector<std::vector<eis::DataPoint>> references(index.size());
+	for(size_t i = 0; i < index.size(); ++i)
+		references[i] = index.getDataPoints(i);
+
+	// query at different frequencies than the index was built on, so that the spectrum needs to be resampled
+	std::vector<fvalue> queryOmega = eis::Range(0.5, 2e6, 47, true).getRangeVector();
+	const size_t k = 5;
+	for(size_t step : {size_t(0), size_t(37), size_t(1000), index.size()-1})
+	{
+		std::vector<fvalue> parameters = {55, 3e3, 4e-7};
+		parameters[0] *= 1 + step/1000.0;
+		std::vector<eis::DataPoint> spectrum = model.executeParameters(queryOmega, parameters);
+		std::vector<eis::SpectraIndex::Match> matches = index.query(spectrum, k);
+
+		std::vector<eis::DataPoint> resampled = eis::fitToFrequencies(omega, spectrum);
+		eis::normalize(resampled);
+		std::vector<fvalue> distances;
+		for(const std::vector<eis::DataPoint>& reference : references)
+			distances.push_back(eis::eisDistance(resampled, reference));
+		std::sort(distances.begin(), distances.end());
+
+		if(matches.size() != k)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" got "<<matches.size()<<" matches expected "<<k;
+			return false;
+		}
+		for(size_t i = 0; i < k; ++i)
+		{
+			if(std::abs(matches[i].distance - distances[i]) > distances[i]*1e-3 + 1e-6)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" match "<<i<<" has distance "<<matches[i].distance
+					<<" while brute force search gives "<<distances[i];
+				return false;
+			}
+		}
+	}
+
+	std::vector<fvalue> truth = {200, 2e3, 1e-6};
+	std::vector<eis::DataPoint> spectrum = model.executeParameters(omega, truth);
+	std::vector<eis::SpectraIndex::Match> matches = index.query(spectrum, 1);
+	eis::FitOptions options;
+	options.initialParameters = index.getParameters(matches[0].step);
+	eis::FitResult result = eis::fit(model, spectrum, options);
+	std::filesystem::remove(path);
+	for(size_t i = 0; i < truth.size(); ++i)
+	{
+		if(std::abs(result.parameters[i] - truth[i]) > truth[i]*1e-2)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" fit from index match gives "<<result.parameters[i]<<" expected "<<truth[i];
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testAdaptiveRanges()
+{
+	eis::Model model("r{10~1e4L}-r{10~1e4L}c{1e-8~1e-4L}", 20, false);
+	eis::Range omega(1, 1e6, 30, true);
+	const double distance = 0.35;
+	std::vector<size_t> exhaustive = model.getRecommendedParamIndices(omega, distance, false, 0);
+	std::vector<size_t> adaptive = model.getRecommendedParamIndices(omega, distance, true, 1000);
+	if(adaptive.empty() || exhaustive.empty())
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" got "<<adaptive.size()<<" adaptive and "<<exhaustive.size()<<" exhaustive ranges";
+		return false;
+	}
+
+	// without the element filters every step found with them must be found as well
+	std::vector<size_t> unfiltered = model.getRecommendedParamIndices(omega, distance, false, 0, false);
+	for(size_t index : exhaustive)
+	{
+		if(std::find(unfiltered.begin(), unfiltered.end(), index) == unfiltered.end())
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" step "<<index<<" is missing without the element filters";
+			return false;
+		}
+	}
+
+	auto getSpectra = [&model, &omega](const std::vector<size_t>& indices)
+	{
+		std::vector<std::vector<eis::DataPoint>> out;
+		for(size_t index : indices)
+		{
+			out.push_back(model.executeSweep(omega, index));
+			eis::normalize(out.back());
+		}
+		return out;
+	};
+	std::vector<std::vector<eis::DataPoint>> adaptiveSpectra = getSpectra(adaptive);
+	std::vector<std::vector<eis::DataPoint>> exhaustiveSpectra = getSpectra(exhaustive);
+
+	for(size_t i = 0; i < adaptiveSpectra.size(); ++i)
+	{
+		for(size_t j = 0; j < i; ++j)
+		{
+			if(eis::eisDistance(adaptiveSpectra[i], adaptiveSpectra[j]) < distance)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" adaptive steps "<<adaptive[i]<<" and "<<adaptive[j]<<" are too similar";
+				return false;
+			}
+		}
+	}
+
+	// the adaptive search should cover most of the spectra found by the exhaustive one
+	size_t covered = 0;
+	for(const std::vector<eis::DataPoint>& spectrum : exhaustiveSpectra)
+	{
+		for(const std::vector<eis::DataPoint>& candidate : adaptiveSpectra)
+		{
+			if(eis::eisDistance(spectrum, candidate) < distance*2)
+			{
+				++covered;
+				break;
+			}
+		}
+	}
+	eis::Log(eis::Log::INFO)<<__func__<<" adaptive search found "<<adaptive.size()<<" exhaustive "<<exhaustive.size()
+		<<" covering "<<covered;
+	if(covered < exhaustiveSpectra.size()*0.8)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" adaptive ranges cover only "<<covered<<" of "<<exhaustiveSpectra.size()<<" spectra";
+		return false;
+	}
+	return true;
+}
+
+bool testAdaptiveSweep()
+{
+	eis::Model model("r{100}-r{1e3}c{1e-6}-r{2e3}c{1e-2}-w{300}", 1, false);
+	eis::Range omega(1e-2, 1e6, 2000, true);
+	const fvalue tolerance = 1e-3;
+	std::vector<eis::DataPoint> dense = model.executeSweep(omega);
+	std::vector<eis::DataPoint> adaptive = model.executeAdaptiveSweep(omega, 0, tolerance);
+
+	fvalue scale = 0;
+	for(const eis::DataPoint& point : dense)
+		scale = std::max(scale, std::abs(point.im));
+
+	auto maxError = [&dense, &omega, scale](const std::vector<eis::DataPoint>& sparse)
+	{
+		std::vector<eis::DataPoint> resampled = eis::fitToFrequencies(omega.getRangeVector(), sparse);
+		fvalue error = 0;
+		for(size_t i = 0; i < dense.size(); ++i)
+			error = std::max(error, std::abs(resampled[i].im - dense[i].im)/scale);
+		return error;
+	};
+
+	fvalue adaptiveError = maxError(adaptive);
+	fvalue uniformError = maxError(model.executeSweep(eis::Range(omega.start, omega.end, adaptive.size(), true)));
+	eis::Log(eis::Log::INFO)<<__func__<<" adaptive sampling used "<<adaptive.size()<<" points with an error of "
+		<<adaptiveError<<" uniform sampling with the same number of points has "<<uniformError;
+
+	if(adaptive.size()*4 > dense.size() || adaptiveError > tolerance*4 || adaptiveError > uniformError)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" adaptive sampling is not effective";
+		return false;
+	}
+	for(size_t i = 1; i < adaptive.size(); ++i)
+	{
+		if(adaptive[i].omega <= adaptive[i-1].omega)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" adaptive spectrum is not ordered by frequency at "<<i;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testExecutionPlanner()
+{
+	size_t before = eis::Model::getExecutionDecisions().size();
+	eis::Model small("r{100}-r{1e3}c{1e-6}", 1, false);
+	eis::Model::ExecutionPlan plan = small.planExecution(10, 1);
+	if(plan.backend != eis::Model::BACKEND_GRAPH || plan.evaluations != 10 || plan.cached)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" planner chose to compile "<<small.getModelStr()<<" for "<<plan.evaluations
+			<<" evaluations as "<<plan.reason;
+		return false;
+	}
+
+	const std::string largeStr = "r{10~1e3L}-r{100~1e4L}c{1e-7~1e-5L}-r{10~1e3L}p{1e-6~1e-4L, 0.5~0.9}-w{10~100L}";
+	eis::Model large(largeStr, 20, false);
+	eis::Range omega(1, 1e6, 100, true);
+	std::vector<eis::DataPoint> reference = large.executeSweep(omega, 1234);
+	plan = large.planExecution(omega.count);
+	eis::Log(eis::Log::INFO)<<__func__<<" planned "<<plan.evaluations<<" evaluations on the "
+		<<(plan.backend == eis::Model::BACKEND_COMPILED ? "compiled" : "graph")<<" backend as "<<plan.reason;
+	if(plan.evaluations != large.getRequiredStepsForSweeps()*omega.count || plan.graphThroughput <= 0 ||
+		large.getExecutionPlan().reason != plan.reason)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" planner did not measure the graph backend";
+		return false;
+	}
+
+	if(plan.backend == eis::Model::BACKEND_COMPILED)
+	{
+		if(plan.compiledThroughput < plan.graphThroughput)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" planner kept a compiled kernel that is slower than the graph";
+			return false;
+		}
+		std::vector<eis::DataPoint> compiled = large.executeSweep(omega, 1234);
+		for(size_t i = 0; i < compiled.size(); ++i)
+		{
+			if(std::abs(compiled[i].im - reference[i].im) > std::abs(reference[i].im)*1e-3)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" planned backend gives "<<compiled[i].im<<" expected "<<reference[i].im;
+				return false;
+			}
+		}
+
+		eis::Model copy(largeStr, 20, false);
+		if(!copy.planExecution(omega.count, 1).cached || copy.getExecutionPlan().backend != eis::Model::BACKEND_COMPILED)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" planner did not reuse the cached kernel";
+			return false;
+		}
+	}
+
+	std::vector<eis::Model::ExecutionPlan> decisions = eis::Model::getExecutionDecisions();
+	if(decisions.size() < before + 2 || std::none_of(decisions.begin(), decisions.end(),
+		[&large](const eis::Model::ExecutionPlan& decision){return decision.model == large.getModelStr();}))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" planner decisions where not recorded";
+		return false;
+	}
+	return true;
+}
+
+bool testKernelCatalog()
+{
+	const std::vector<std::string> models = {"r{5}-l{1e-5}-p{1e-5, 0.7}w{20}-c{1e-3}r{7}", "c{1e-3}r{9}-r{3}-w{25}p{2e-5, 0.6}-l{2e-5}"};
+	std::string code = eis::getKernelCatalogCode(models);
+	std::filesystem::path path = std::filesystem::temp_directory_path()/"eisgenerator_test_kernels.so";
+	if(eis::compile_code(code, path.string()) != 0)
+	{
+		eis::Log(eis::Log::INFO)<<__func__<<" no compiler available skipping test";
+		return true;
+	}
+
+	// both models share a canonical form, thus the catalog holds one kernel and its jacobian
+	if(eis::CompCache::getInstance()->loadCatalog(path.string()) != 2)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" catalog dosent contain the expected kernels";
+		return false;
+	}
+
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 20, true).getRangeVector();
+	for(const std::string& modelStr : models)
+	{
+		eis::Model model(modelStr, 1, false);
+		if(!eis::CompCache::getInstance()->getObject(model.getUuid()) ||
+			!eis::CompCache::getInstance()->getObject(model.getJacobianUuid()))
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" kernel of "<<modelStr<<" is not in the cache";
+			return false;
+		}
+
+		std::vector<eis::DataPoint> reference = model.executeSweep(omega);
+		if(!model.compile(false, true))
+			return false;
+		std::vector<eis::DataPoint> compiled = model.executeSweep(omega);
+		for(size_t i = 0; i < omega.size(); ++i)
+		{
+			if(std::abs(compiled[i].im - reference[i].im) > std::abs(reference[i].im)*1e-3)
+			{
+				eis::Log(eis::Log::ERROR)<<__func__<<" catalog kernel of "<<modelStr<<" gives "<<compiled[i].im
+					<<" expected "<<reference[i].im;
+				return false;
+			}
+		}
+		if(!checkJacobian(model, omega, 1e-2))
+			return false;
+	}
+	return true;
+}
+
+bool testMultiversionedKernel()
+{
+	eis::Model model("r{50}-r{1000}p{1e-5, 0.9}-l{1e-6}", 1, false);
+	std::string code = model.getKernelCode();
+#if defined(__x86_64__) && defined(__linux__)
+	if(code.find("target_clones") == std::string::npos)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" kernel is not built for several instruction sets";
+		return false;
+	}
+#endif
+
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 20, true).getRangeVector();
+	std::vector<eis::DataPoint> reference = model.executeSweep(omega);
+	if(!model.compile())
+	{
+		eis::Log(eis::Log::INFO)<<__func__<<" no compiler available skipping test";
+		return true;
+	}
+
+	std::filesystem::path path = std::filesystem::path(eis::getTempdir())/
+		(std::to_string(model.getUuid()) + "_" + std::to_string(std::hash<std::string>{}(code)) + ".so");
+	if(!std::filesystem::is_regular_file(path))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" compiled object "<<path<<" is missing";
+		return false;
+	}
+
+	// a second load must reuse the object on disk instead of compiling it again
+	std::filesystem::file_time_type written = std::filesystem::last_write_time(path);
+	eis::CompCache::getInstance()->dropAllObjects();
+	eis::Model reload("r{50}-r{1000}p{1e-5, 0.9}-l{1e-6}", 1, false);
+	if(!reload.compile())
+		return false;
+	if(std::filesystem::last_write_time(path) != written)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" compiled object was rebuilt";
+		return false;
+	}
+
+	std::vector<eis::DataPoint> compiled = reload.executeSweep(omega);
+	for(size_t i = 0; i < omega.size(); ++i)
+	{
+		if(std::abs(compiled[i].im - reference[i].im) > std::abs(reference[i].im)*1e-3)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" compiled kernel gives "<<compiled[i].im<<" expected "<<reference[i].im;
+			return false;
+		}
+	}
+	return true;
+}
+
+bool testTypedModel()
+{
+	using Typed = eis::typed::Series<eis::typed::R, eis::typed::Parallel<eis::typed::R, eis::typed::Cpe>, eis::typed::W,
+		eis::typed::Parallel<eis::typed::Series<eis::typed::R, eis::typed::C>, eis::typed::L>, eis::typed::Trc, eis::typed::Tro>;
+	static_assert(Typed::paramCount == 16);
+	static_assert(Typed::getTopologyStr() == "(r-(rp)-w-((r-c)l)-t-o)");
+
+	Typed typed(50, 1000, 1e-5, 0.9, 20, 10, 1e-6, 1e-4, 50, 1e-6, 0.5, 0.5, 30, 1e-5, 0.7, 0.8);
+	eis::Model model(typed.getModelStr());
+	if(model.getParameterCount() != Typed::paramCount)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" "<<typed.getModelStr()<<" has "<<model.getParameterCount()
+			<<" parameters expected "<<Typed::paramCount;
+		return false;
+	}
+
+	std::vector<fvalue> flatParameters = model.getFlatParameters();
+	if(!std::equal(flatParameters.begin(), flatParameters.end(), typed.parameters.begin()))
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" parameters of "<<typed.getModelStr()<<" are not in the order of the model";
+		return false;
+	}
+
+	std::vector<fvalue> omega = eis::Range(1, 1e6, 50, true).getRangeVector();
+	std::vector<eis::DataPoint> reference = model.executeSweep(omega);
+	std::vector<eis::DataPoint> spectrum = typed.executeSweep(omega);
+	std::array<std::complex<fvalue>, 3> points = typed.execute(std::array<fvalue, 3>{omega[0], omega[20], omega[49]});
+	for(size_t i = 0; i < omega.size(); ++i)
+	{
+		if(std::abs(spectrum[i].im - reference[i].im) > std::abs(reference[i].im)*1e-4)
+		{
+			eis::Log(eis::Log::ERROR)<<__func__<<" typed model gives "<<spectrum[i].im<<" expected "<<reference[i].im;
+			return false;
+		}
+	}
+	if(points[0] != spectrum[0].im || points[1] != spectrum[20].im || points[2] != spectrum[49].im)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" typed model gives different results for arrays";
+		return false;
+	}
+	return true;
+}
+
+static std::string getUnseededNoise(const char* executable)
+{
+	std::string command = std::string(executable) + " --unseeded-noise";
+	FILE* pipe = popen(command.c_str(), "r");
+	if(!pipe)
+		return std::string();
+	std::string out;
+	char buffer[256];
+	while(fgets(buffer, sizeof(buffer), pipe))
+		out.append(buffer);
+	pclose(pipe);
+	return out;
+}
+
+bool testUnseededRandom(const char* executable)
+{
+	std::string first = getUnseededNoise(executable);
+	std::string second = getUnseededNoise(executable);
+	if(first.empty() || second.empty())
+	{
+		eis::Log(eis::Log::INFO)<<__func__<<" unable to run "<<executable<<" skipping test";
+		return true;
+	}
+	if(first == second)
+	{
+		eis::Log(eis::Log::ERROR)<<__func__<<" unseeded noise is the same in every run";
+		return false;
+	}
+	return true;
+}
+
 int main(int argc, char** argv)
 {
+	if(argc > 1 && std::string(argv[1]) == "--unseeded-noise")
+	{
+		std::vector<eis::DataPoint> data(8, eis::DataPoint({1, 1}, 1));
+		eis::noise(data, 0.1, false);
+		for(const eis::DataPoint& point : data)
+			std::cout<<point.im<<'\n';
+		return 0;
+	}
+
 	eis::Log::headers = true;
 	eis::Log::level = eis::Log::INFO;
 
@@ -683,5 +2210,80 @@ int main(int argc, char** argv)
 	if(!testSeriesContribution())
 		return 24;
 
+	if(!testDataset())
+		return 25;
+
+	if(!testNpy())
+		return 26;
+
+	if(!testSampling())
+		return 27;
+
+	if(!testRandom())
+		return 28;
+
+	if(!testParser())
+		return 29;
+
+	if(!testBindParameters())
+		return 30;
+
+	if(!testCanonical())
+		return 31;
+
+	if(!testExpressionGraph())
+		return 32;
+
+	if(!testSpecialization())
+		return 33;
+
+	if(!testFrequencyPlan())
+		return 34;
+
+	if(!testResolvedParameters())
+		return 35;
+
+	if(!testRational())
+		return 36;
+
+	if(!testAdmittance())
+		return 37;
+
+	if(!testLadder())
+		return 38;
+
+	if(!testNetwork())
+		return 39;
+
+	if(!testJacobian())
+		return 40;
+
+	if(!testFit())
+		return 41;
+
+	if(!testSpectraIndex())
+		return 42;
+
+	if(!testAdaptiveRanges())
+		return 43;
+
+	if(!testAdaptiveSweep())
+		return 44;
+
+	if(!testExecutionPlanner())
+		return 45;
+
+	if(!testKernelCatalog())
+		return 46;
+
+	if(!testMultiversionedKernel())
+		return 47;
+
+	if(!testTypedModel())
+		return 48;
+
+	if(!testUnseededRandom(argv[0]))
+		return 49;
+
 	return 0;
 }